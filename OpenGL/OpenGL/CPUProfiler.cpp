@@ -0,0 +1,250 @@
+#include "CPUProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace aie {
+
+std::mutex CPUProfiler::sm_bufferMutex;
+std::vector<std::unique_ptr<CPUProfiler::ThreadBuffer>> CPUProfiler::sm_buffers;
+
+CPUProfiler::Frame CPUProfiler::sm_frames[FRAME_HISTORY];
+unsigned int CPUProfiler::sm_frameCount = 0;
+uint64_t CPUProfiler::sm_frameStart = 0;
+
+uint64_t CPUProfiler::sm_calibrationTicks = 0;
+double CPUProfiler::sm_calibrationTime = 0;
+double CPUProfiler::sm_ticksPerMillisecond = 0;
+
+std::vector<CPUProfiler::ZoneStats> CPUProfiler::sm_zones;
+
+static double steadyMilliseconds() {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// hands the thread's buffer back when the thread exits
+struct ThreadBufferHandle {
+	CPUProfiler::ThreadBuffer* buffer = nullptr;
+
+	~ThreadBufferHandle() {
+		if (buffer != nullptr)
+			CPUProfiler::releaseBuffer(buffer);
+	}
+};
+
+static thread_local ThreadBufferHandle t_threadBuffer;
+
+CPUProfiler::ThreadBuffer* CPUProfiler::getThreadBuffer() {
+	if (t_threadBuffer.buffer == nullptr)
+		t_threadBuffer.buffer = acquireBuffer();
+	return t_threadBuffer.buffer;
+}
+
+CPUProfiler::ThreadBuffer* CPUProfiler::acquireBuffer() {
+	std::lock_guard<std::mutex> lock(sm_bufferMutex);
+	for (auto& buffer : sm_buffers) {
+		if (buffer->inUse == false) {
+			buffer->inUse = true;
+			return buffer.get();
+		}
+	}
+
+	std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+	buffer->written = 0;
+	buffer->read = 0;
+	buffer->id = (unsigned int)sm_buffers.size();
+	snprintf(buffer->name, sizeof(buffer->name), "Thread %u", buffer->id);
+	buffer->inUse = true;
+	sm_buffers.push_back(std::move(buffer));
+	return sm_buffers.back().get();
+}
+
+void CPUProfiler::releaseBuffer(ThreadBuffer* buffer) {
+	std::lock_guard<std::mutex> lock(sm_bufferMutex);
+	buffer->inUse = false;
+}
+
+void CPUProfiler::record(const char* name, uint64_t start, uint64_t end) {
+	ThreadBuffer* buffer = getThreadBuffer();
+
+	// only this thread writes to the buffer, the release publishes the event to the reader
+	uint64_t written = buffer->written.load(std::memory_order_relaxed);
+	EventSlot& slot = buffer->events[written % EVENT_CAPACITY];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	buffer->written.store(written + 1, std::memory_order_release);
+}
+
+void CPUProfiler::setThreadName(const char* name) {
+	ThreadBuffer* buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(sm_bufferMutex);
+	snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+template <typename Function>
+uint64_t CPUProfiler::readEvents(ThreadBuffer& buffer, uint64_t from, const Function& function) {
+	uint64_t written = buffer.written.load(std::memory_order_acquire);
+	if (written - from > EVENT_CAPACITY)
+		from = written - EVENT_CAPACITY;
+
+	for (uint64_t i = from; i < written; ++i) {
+		const EventSlot& slot = buffer.events[i % EVENT_CAPACITY];
+		Event event;
+		event.name = slot.name.load(std::memory_order_relaxed);
+		event.start = slot.start.load(std::memory_order_relaxed);
+		event.end = slot.end.load(std::memory_order_relaxed);
+
+		// the writer may have lapped the reader while it was copying, anything it has since
+		// reached is a mix of two events. The fence keeps the copy ahead of the check
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t latest = buffer.written.load(std::memory_order_relaxed);
+		if (latest - i > EVENT_CAPACITY - 1)
+			continue;
+
+		function(event);
+	}
+	return written;
+}
+
+void CPUProfiler::beginFrame() {
+	sm_frameStart = now();
+	if (sm_calibrationTicks == 0) {
+		sm_calibrationTicks = sm_frameStart;
+		sm_calibrationTime = steadyMilliseconds();
+	}
+}
+
+void CPUProfiler::endFrame() {
+	uint64_t frameEnd = now();
+	record("Frame", sm_frameStart, frameEnd);
+	sm_frames[sm_frameCount % FRAME_HISTORY] = { sm_frameStart, frameEnd };
+	++sm_frameCount;
+
+	// the longer it's measured over the less the clocks' resolution matters
+	double elapsed = steadyMilliseconds() - sm_calibrationTime;
+	if (elapsed > 0)
+		sm_ticksPerMillisecond = (frameEnd - sm_calibrationTicks) / elapsed;
+	if (sm_ticksPerMillisecond <= 0)
+		return;
+
+	for (auto& zone : sm_zones) {
+		zone.time = 0;
+		zone.calls = 0;
+	}
+
+	// threads started since the snapshot have nothing from this frame worth reading yet
+	std::vector<ThreadBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(sm_bufferMutex);
+		for (auto& buffer : sm_buffers)
+			buffers.push_back(buffer.get());
+	}
+
+	for (auto buffer : buffers) {
+		buffer->read = readEvents(*buffer, buffer->read, [](const Event& event) {
+			addZone(event.name, (float)((event.end - event.start) / sm_ticksPerMillisecond));
+		});
+	}
+
+	for (auto& zone : sm_zones)
+		zone.average += (zone.time - zone.average) * 0.05f;
+
+	// only a few zones, and they rarely change places
+	std::stable_sort(sm_zones.begin(), sm_zones.end(), [](const ZoneStats& a, const ZoneStats& b) {
+		return a.average > b.average;
+	});
+}
+
+void CPUProfiler::addZone(const char* name, float time) {
+	// the same literal can have a different address in each translation unit
+	auto iter = std::find_if(sm_zones.begin(), sm_zones.end(), [name](const ZoneStats& zone) {
+		return zone.name == name || strcmp(zone.name, name) == 0;
+	});
+	if (iter == sm_zones.end()) {
+		ZoneStats zone;
+		zone.name = name;
+		iter = sm_zones.insert(sm_zones.end(), zone);
+	}
+
+	iter->time += time;
+	++iter->calls;
+}
+
+// names are literals in code, so only quotes and backslashes could need escaping
+static void writeJSONString(FILE* file, const char* string) {
+	fputc('"', file);
+	for (const char* c = string; *c != 0; ++c) {
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+		fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool CPUProfiler::writeTrace(const char* filename, unsigned int firstFrame, unsigned int frameCount) {
+	unsigned int oldestFrame = sm_frameCount > FRAME_HISTORY ? sm_frameCount - FRAME_HISTORY : 0;
+	unsigned int lastFrame = std::min(firstFrame + frameCount, sm_frameCount);
+	firstFrame = std::max(firstFrame, oldestFrame);
+	if (firstFrame >= lastFrame ||
+		sm_ticksPerMillisecond <= 0) {
+		printf("No frames to write to [%s]\n", filename);
+		return false;
+	}
+
+	FILE* file = nullptr;
+	fopen_s(&file, filename, "w");
+	if (file == nullptr) {
+		printf("Failed to open [%s] for writing\n", filename);
+		return false;
+	}
+
+	uint64_t rangeStart = sm_frames[firstFrame % FRAME_HISTORY].start;
+	uint64_t rangeEnd = sm_frames[(lastFrame - 1) % FRAME_HISTORY].end;
+	double ticksPerMicrosecond = sm_ticksPerMillisecond / 1000.0;
+
+	// names can be set from other threads, so they're copied under the mutex
+	std::vector<ThreadBuffer*> buffers;
+	std::vector<std::string> names;
+	{
+		std::lock_guard<std::mutex> lock(sm_bufferMutex);
+		for (auto& buffer : sm_buffers) {
+			buffers.push_back(buffer.get());
+			names.push_back(buffer->name);
+		}
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		ThreadBuffer* buffer = buffers[i];
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", i == 0 ? "" : ",\n", buffer->id);
+		writeJSONString(file, names[i].c_str());
+		fprintf(file, "}}");
+
+		// zones still open when the range ended are left out, they'd cover frames not written
+		readEvents(*buffer, 0, [&](const Event& event) {
+			if (event.start < rangeStart ||
+				event.end > rangeEnd)
+				return;
+
+			fprintf(file, ",\n{\"name\":");
+			writeJSONString(file, event.name);
+			fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+					(event.start - rangeStart) / ticksPerMicrosecond, (event.end - event.start) / ticksPerMicrosecond, buffer->id);
+		});
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	fclose(file);
+	printf("Wrote frames %u to %u to [%s]\n", firstFrame, lastFrame - 1, filename);
+	return true;
+}
+
+bool CPUProfiler::writeTrace(const char* filename, unsigned int frameCount) {
+	unsigned int firstFrame = sm_frameCount > frameCount ? sm_frameCount - frameCount : 0;
+	return writeTrace(filename, firstFrame, frameCount);
+}
+
+} // namespace aie
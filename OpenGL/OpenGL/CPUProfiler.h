@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// zones cost nothing once AIE_CPU_PROFILER is defined as 0 in the project's preprocessor definitions
+#ifndef AIE_CPU_PROFILER
+#define AIE_CPU_PROFILER 1
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// times the rest of the enclosing block as a zone. The name must outlive the profiler, a
+// string literal in practice
+#if AIE_CPU_PROFILER
+#define PROFILE_ZONE(name) aie::CPUProfiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+namespace aie {
+
+// records zones of CPU time on any thread. Each thread writes to its own ring of events with
+// nothing but relaxed atomic stores, so zones can sit in code running on worker threads. Buffers
+// outlive their threads and are handed to the next thread started, so the short lived threads
+// parallelFor() starts reuse a few buffers. The render thread reads the rings at the end of
+// each frame for per zone totals, and on request writes a range of frames as a Chrome trace
+class CPUProfiler {
+public:
+
+	static const unsigned int EVENT_CAPACITY = 1 << 16;	// events kept per thread
+	static const unsigned int FRAME_HISTORY = 300;		// frames a trace can be written from
+
+	// a zone's time in milliseconds on every thread, nested zones included in their parents
+	struct ZoneStats {
+		const char*		name = nullptr;
+		float			time = 0;		// last frame
+		float			average = 0;	// smoothed over recent frames
+		unsigned int	calls = 0;		// last frame
+	};
+
+	class Zone {
+	public:
+		explicit Zone(const char* name) : m_name(name), m_start(now()) {}
+		~Zone() { record(m_name, m_start, now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator = (const Zone&) = delete;
+
+	private:
+		const char*	m_name;
+		uint64_t	m_start;
+	};
+
+	// the time stamp counter, which runs at a fixed rate on any CPU recent enough to run this
+	static uint64_t now() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	static void record(const char* name, uint64_t start, uint64_t end);
+
+	// names the calling thread in traces, threads are "Thread n" otherwise
+	static void setThreadName(const char* name);
+
+	// the frame is recorded as a "Frame" zone on the thread that began it. Ending a frame adds
+	// up the zones every thread recorded since the last. Threads still recording may be read
+	// mid write, their events are only left out if the ring laps the reader
+	static void beginFrame();
+	static void endFrame();
+
+	// frames ended so far, frames from getFrameCount() - FRAME_HISTORY on can be traced
+	static unsigned int getFrameCount() { return sm_frameCount; }
+
+	// zones recorded so far, slowest on average first
+	static const std::vector<ZoneStats>& getZones() { return sm_zones; }
+
+	static double getTicksPerMillisecond() { return sm_ticksPerMillisecond; }
+
+	// writes frameCount frames from firstFrame in Chrome's trace event format, for
+	// chrome://tracing or Perfetto. Frames no longer in the history are skipped, as are events
+	// that have since been overwritten, including any overwritten by threads still recording
+	// while it's written
+	static bool writeTrace(const char* filename, unsigned int firstFrame, unsigned int frameCount);
+
+	// writes the last frameCount frames
+	static bool writeTrace(const char* filename, unsigned int frameCount);
+
+private:
+
+	struct Event {
+		const char*	name;
+		uint64_t	start;
+		uint64_t	end;
+	};
+
+	// an event in a ring. The render thread can read a slot while its thread is writing it, so
+	// each field is atomic. Relaxed accesses are plain moves on x86, recording costs no more
+	struct EventSlot {
+		std::atomic<const char*>	name;
+		std::atomic<uint64_t>		start;
+		std::atomic<uint64_t>		end;
+	};
+
+	// written by one thread at a time, read by the render thread
+	struct ThreadBuffer {
+		EventSlot				events[EVENT_CAPACITY];
+		std::atomic<uint64_t>	written;
+		uint64_t				read;		// events already added to the zone stats
+		unsigned int			id;
+		char					name[32];
+		bool					inUse;
+	};
+
+	struct Frame {
+		uint64_t	start;
+		uint64_t	end;
+	};
+
+	friend struct ThreadBufferHandle;
+
+	static ThreadBuffer*	acquireBuffer();
+	static void				releaseBuffer(ThreadBuffer* buffer);
+	static ThreadBuffer*	getThreadBuffer();
+
+	// calls function(event) for every event in [from, written) that hasn't been overwritten,
+	// returning written
+	template <typename Function>
+	static uint64_t readEvents(ThreadBuffer& buffer, uint64_t from, const Function& function);
+
+	static void addZone(const char* name, float time);
+
+	// buffers are only added to, under the mutex, and live until the program ends
+	static std::mutex									sm_bufferMutex;
+	static std::vector<std::unique_ptr<ThreadBuffer>>	sm_buffers;
+
+	static Frame			sm_frames[FRAME_HISTORY];
+	static unsigned int		sm_frameCount;
+	static uint64_t			sm_frameStart;
+
+	// measured against the steady clock since the first frame
+	static uint64_t			sm_calibrationTicks;
+	static double			sm_calibrationTime;
+	static double			sm_ticksPerMillisecond;
+
+	static std::vector<ZoneStats>	sm_zones;
+};
+
+} // namespace aie
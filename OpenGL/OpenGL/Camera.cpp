@@ -14,11 +14,11 @@ glm::mat4 Camera::GetViewMatrix()
 	float thetaR = m_theta * deg2Rad;
 	float phiR = m_phi * deg2Rad;
 	glm::vec3 forward(cos(phiR)*cos(thetaR), sin(phiR), cos(phiR)*sin(thetaR));
-	return glm::lookAt(m_position, m_position + forward, glm::vec3(0, 1, 0));
+	return glm::lookAt(m_renderPosition, m_renderPosition + forward, glm::vec3(0, 1, 0));
 }
 
-// Updates camera member variables (mouse position and camera position and rotation)
-void Camera::update()
+// Moves the camera with the keyboard over one simulation tick of deltaTime seconds
+void Camera::update(float deltaTime)
 {
 	aie::Input* input = aie::Input::getInstance();
 	float thetaR = m_theta * deg2Rad;
@@ -29,27 +29,33 @@ void Camera::update()
 	glm::vec3 right(-sin(thetaR), 0, cos(thetaR));
 	glm::vec3 up(0, 1, 0);
 
-	float deltaTime = 0.1f;
+	m_previousPosition = m_position;
+	float distance = MOVE_SPEED * deltaTime;
 
 	// Use WASD, ZX keys to move camera around
 	if (input->isKeyDown(aie::INPUT_KEY_X))
-		m_position += up * deltaTime;
+		m_position += up * distance;
 
 	if (input->isKeyDown(aie::INPUT_KEY_Z))
-		m_position += -up * deltaTime;
+		m_position += -up * distance;
 
 	if (input->isKeyDown(aie::INPUT_KEY_A))
-		m_position += -right * deltaTime;
+		m_position += -right * distance;
 
 	if (input->isKeyDown(aie::INPUT_KEY_D))
-		m_position += right * deltaTime;
+		m_position += right * distance;
 
 	if (input->isKeyDown(aie::INPUT_KEY_W))
-		m_position += forward * deltaTime;
+		m_position += forward * distance;
 
 	if (input->isKeyDown(aie::INPUT_KEY_S))
-		m_position += -forward * deltaTime;
+		m_position += -forward * distance;
+}
 
+// Turns the camera with the mouse, once per frame as mouse movement doesn't depend on time
+void Camera::updateLook()
+{
+	aie::Input* input = aie::Input::getInstance();
 
 	// Get the current mouse coordinates
 	float mx = input->getMouseX();
@@ -65,3 +71,9 @@ void Camera::update()
 	m_lastMouseX = mx;
 	m_lastMouseY = my;
 }
+
+// Places the camera alpha of the way from the previous tick's position to the last tick's, for frames drawn between ticks
+void Camera::interpolate(float alpha)
+{
+	m_renderPosition = glm::mix(m_previousPosition, m_position, alpha);
+}
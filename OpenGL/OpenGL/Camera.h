@@ -10,17 +10,24 @@ class Camera
 {
 public:
 	// Constructor that by default sets 
-	Camera() : m_theta(0), m_phi(-20), m_position(-10, 4, 0) {}			 
+	Camera() : m_theta(0), m_phi(-20), m_position(-10, 4, 0), m_previousPosition(m_position), m_renderPosition(m_position) {}			 
 
 	glm::mat4 GetProjectionMatrix(float w, float h);	// Returns a matrix 4 of the camera's projection where: float w = width of screen, float h = height of screen
-	glm::mat4 GetViewMatrix();							// Returns a matrix 4 of where the camera is directed to and displaying
+	glm::mat4 GetViewMatrix();							// Returns a matrix 4 of where the camera is directed to and displaying, from the interpolated position
 	
-	void update();										// Updates camera member variables (mouse position and camera position and rotation)
+	void update(float deltaTime);						// Moves the camera with the keyboard over one simulation tick of deltaTime seconds
+	void updateLook();									// Turns the camera with the mouse, once per frame as mouse movement doesn't depend on time
+	void interpolate(float alpha);						// Places the camera alpha of the way from the previous tick's position to the last tick's, for frames drawn between ticks
 
 private:
 	float m_theta;			// The longitude angle  Theta is zero when youre looking along the x-axis.
 	float m_phi;			// The angle of elevation. If youre looking horizontally, phi is zero. Looking down, phi becomes negative. Looking up, phi becomes positive.
 	glm::vec3 m_position;
+	glm::vec3 m_previousPosition;	// Position before the last tick
+	glm::vec3 m_renderPosition;		// Position the view is drawn from
+
+	// Movement in units per second, matching the old 0.1 a frame at 60 frames per second
+	static constexpr float MOVE_SPEED = 6.0f;
 
 	int m_lastMouseX;
 	int m_lastMouseY;
@@ -0,0 +1,73 @@
+#include "CommandList.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <algorithm>
+#include <cassert>
+
+namespace aie {
+
+void CommandList::begin(const glm::mat4& view, const glm::mat4& projectionView, float depthRange) {
+	m_view = view;
+	m_projectionView = projectionView;
+	m_depthRange = depthRange;
+	m_commands.clear();
+}
+
+uint64_t CommandList::makeKey(ProgramHandle program, MaterialHandle material, MeshHandle mesh, const glm::mat4& transform, unsigned int pass) const {
+	assert(program.isValid() && mesh.isValid() && pass < PASS_Count);
+
+	// handles past the limit share the last id, which only costs sorting, never correctness
+	uint64_t programID = std::min(program.index, (1u << PROGRAM_BITS) - 1);
+	uint64_t materialID = std::min(material.index, (1u << MATERIAL_BITS) - 1);
+	uint64_t meshID = std::min(mesh.index, (1u << MESH_BITS) - 1);
+
+	// view space distance to the object's origin, quantised over the depth range
+	float distance = -(m_view * transform[3]).z;
+	float depth = glm::clamp(distance / m_depthRange, 0.0f, 1.0f);
+	uint64_t depthBits = (uint64_t)(depth * (float)((1u << DEPTH_BITS) - 1));
+
+	uint64_t key = (uint64_t)pass << (64 - PASS_BITS);
+	if (pass == PASS_TRANSPARENT) {
+		// blending needs back to front order more than it needs fewer state changes
+		uint64_t backToFront = ((1u << DEPTH_BITS) - 1) - depthBits;
+		key |= backToFront << (64 - PASS_BITS - DEPTH_BITS);
+		key |= programID << (MATERIAL_BITS + MESH_BITS);
+		key |= materialID << MESH_BITS;
+		key |= meshID;
+	}
+	else {
+		key |= programID << (MATERIAL_BITS + MESH_BITS + DEPTH_BITS);
+		key |= materialID << (MESH_BITS + DEPTH_BITS);
+		key |= meshID << DEPTH_BITS;
+		key |= depthBits;
+	}
+	return key;
+}
+
+void CommandList::draw(ProgramHandle program, MaterialHandle material, MeshHandle mesh, const glm::mat4& transform, unsigned int pass /* = PASS_OPAQUE */) {
+	m_commands.emplace_back();
+	DrawCommand& command = m_commands.back();
+	command.key = makeKey(program, material, mesh, transform, pass);
+	command.program = program;
+	command.material = material;
+	command.mesh = mesh;
+	command.projectionViewModel = m_projectionView * transform;
+	command.modelMatrix = transform;
+	command.normalMatrix = glm::inverseTranspose(glm::mat3(transform));
+}
+
+void CommandList::drawInstanced(ProgramHandle program, MaterialHandle material, MeshHandle mesh, InstancesHandle instances,
+								const glm::mat4& transform, unsigned int pass /* = PASS_OPAQUE */) {
+	assert(instances.isValid());
+
+	// the instances hold their own transforms, so there are no per object values to work out
+	m_commands.emplace_back();
+	DrawCommand& command = m_commands.back();
+	command.key = makeKey(program, material, mesh, transform, pass);
+	command.program = program;
+	command.material = material;
+	command.mesh = mesh;
+	command.instances = instances;
+}
+
+} // namespace aie
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace aie {
+
+// references to what a draw uses, handed out by a RenderQueue on the render thread. Recording
+// threads only ever hold these, the programs, meshes and textures they name stay out of reach
+struct ProgramHandle {
+	unsigned int index = ~0u;
+	bool isValid() const { return index != ~0u; }
+};
+
+struct MaterialHandle {
+	unsigned int index = ~0u;
+	bool isValid() const { return index != ~0u; }
+};
+
+struct MeshHandle {
+	unsigned int index = ~0u;
+	bool isValid() const { return index != ~0u; }
+};
+
+// an instance buffer filled on the render thread before recording, invalid for single draws
+struct InstancesHandle {
+	unsigned int index = ~0u;
+	bool isValid() const { return index != ~0u; }
+};
+
+// a draw with everything the render thread needs already worked out: its sort key and the
+// per object uniform values
+struct DrawCommand {
+	uint64_t		key;
+	ProgramHandle	program;
+	MaterialHandle	material;
+	MeshHandle		mesh;
+	InstancesHandle	instances;
+
+	glm::mat4		projectionViewModel;
+	glm::mat4		modelMatrix;
+	glm::mat3		normalMatrix;
+};
+
+// a linear buffer of draw commands filled by one thread. It holds plain data only and nothing
+// reachable from it makes GL calls, so any thread can record while the render thread owns the
+// context. A RenderQueue merges its lists in key order and replays them
+class CommandList {
+public:
+
+	enum Pass : unsigned int {
+		PASS_OPAQUE = 0,
+		PASS_TRANSPARENT,	// drawn back to front after the opaque pass, sorted by depth first
+
+		PASS_Count,
+	};
+
+	CommandList() : m_depthRange(1000) {}
+
+	CommandList(const CommandList&) = delete;
+	CommandList& operator = (const CommandList&) = delete;
+
+	// drops every command and sets the camera the keys and matrices are computed with.
+	// Depth is quantised over depthRange
+	void begin(const glm::mat4& view, const glm::mat4& projectionView, float depthRange);
+
+	void draw(ProgramHandle program, MaterialHandle material, MeshHandle mesh, const glm::mat4& transform, unsigned int pass = PASS_OPAQUE);
+
+	// draws every instance in the buffer, which the program reads its transforms from.
+	// transform only places the group for depth sorting
+	void drawInstanced(ProgramHandle program, MaterialHandle material, MeshHandle mesh, InstancesHandle instances,
+					   const glm::mat4& transform, unsigned int pass = PASS_OPAQUE);
+
+	size_t getCommandCount() const { return m_commands.size(); }
+	const DrawCommand& getCommand(size_t index) const { return m_commands[index]; }
+
+	// key layout from the most significant bit, ids past a field's size share its last value.
+	// Keys order by pass, then program, material, mesh and finally front to back depth
+	static const unsigned int PASS_BITS = 4;
+	static const unsigned int PROGRAM_BITS = 12;
+	static const unsigned int MATERIAL_BITS = 12;
+	static const unsigned int MESH_BITS = 12;
+	static const unsigned int DEPTH_BITS = 24;
+
+private:
+
+	uint64_t makeKey(ProgramHandle program, MaterialHandle material, MeshHandle mesh, const glm::mat4& transform, unsigned int pass) const;
+
+	glm::mat4	m_view;
+	glm::mat4	m_projectionView;
+	float		m_depthRange;
+
+	std::vector<DrawCommand>	m_commands;
+};
+
+} // namespace aie
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace aie {
+
+// uniform block binding points shared by every program
+enum UniformBlockBinding : unsigned int {
+	FRAME_DATA_BINDING = 0,
+	LIGHT_DATA_BINDING,
+};
+
+// the maximum lights in LightData, must match the array sizes in the shaders
+static const unsigned int MAX_LIGHTS = 4;
+
+// matches the std140 "FrameData" uniform block, written once per frame
+struct FrameData {
+	glm::mat4	view;
+	glm::mat4	projection;
+	glm::mat4	projectionView;
+	glm::vec3	cameraPosition;
+	float		time;
+};
+
+// matches the std140 "LightData" uniform block, written once per frame.
+// std140 gives every array element 16 bytes, so vec3 and float arrays are stored as vec4
+struct LightData {
+	glm::vec3	ambient;
+	int			lightCount;
+	glm::vec4	positions[MAX_LIGHTS];
+	glm::vec4	colours[MAX_LIGHTS];
+	glm::vec4	power[MAX_LIGHTS];		// only x is used
+};
+
+static_assert(sizeof(FrameData) == 208, "FrameData must match its std140 layout");
+static_assert(sizeof(LightData) == 208, "LightData must match its std140 layout");
+
+} // namespace aie
@@ -0,0 +1,131 @@
+#include "FrameTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace aie {
+
+FrameTimer::FrameTimer()
+	: m_started(false),
+	m_tickTime(1.0 / 60),
+	m_accumulator(0),
+	m_frameTime(0),
+	m_tickCount(0),
+	m_mode(PACING_VSYNC),
+	m_targetFPS(60),
+	m_sleepEstimate(0.002),
+	m_sleepTime(0),
+	m_spinTime(0),
+	m_window(),
+	m_windowCount(0),
+	m_windowNext(0) {
+}
+
+void FrameTimer::setTickRate(float ticksPerSecond) {
+	m_tickTime = 1.0 / std::max(ticksPerSecond, 1.0f);
+
+	// keeps the leftover time a fraction of a tick
+	m_accumulator = std::fmod(m_accumulator, m_tickTime);
+}
+
+void FrameTimer::setPacing(PacingMode mode, float targetFPS) {
+	if (mode == m_mode &&
+		targetFPS == m_targetFPS)
+		return;
+
+	m_mode = mode;
+	m_targetFPS = targetFPS;
+	m_deadline = Clock::now();
+
+	m_windowCount = 0;
+	m_windowNext = 0;
+	m_stats[mode] = Stats();
+}
+
+unsigned int FrameTimer::beginFrame() {
+	Clock::time_point now = Clock::now();
+	if (m_started == false) {
+		m_started = true;
+		m_frameStart = now;
+		m_deadline = now;
+		m_tickCount = 0;
+		return 0;
+	}
+
+	m_frameTime = std::chrono::duration<double>(now - m_frameStart).count();
+	m_frameStart = now;
+	updateStats((float)(m_frameTime * 1000.0));
+
+	m_accumulator += m_frameTime < MAX_FRAME_TIME ? m_frameTime : MAX_FRAME_TIME;
+	m_tickCount = (unsigned int)(m_accumulator / m_tickTime);
+	m_accumulator -= m_tickCount * m_tickTime;
+	return m_tickCount;
+}
+
+void FrameTimer::waitForDeadline() {
+	m_sleepTime = 0;
+	m_spinTime = 0;
+	if (m_mode != PACING_TARGET ||
+		m_targetFPS <= 0)
+		return;
+
+	// a frame that runs past its deadline starts the schedule again from now, rather than
+	// rushing the frames after it to catch up
+	Clock::time_point start = Clock::now();
+	m_deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFPS));
+	if (m_deadline < start)
+		m_deadline = start;
+
+	// sleeps only wake within the OS timer's resolution, so stop while a whole sleep still fits
+	Clock::time_point now = start;
+	while (std::chrono::duration<double>(m_deadline - now).count() > m_sleepEstimate) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		Clock::time_point woken = Clock::now();
+
+		// jumps up to the longest sleep seen, then drifts back down if sleeps get shorter
+		double slept = std::chrono::duration<double>(woken - now).count();
+		m_sleepEstimate = slept > m_sleepEstimate ? slept : m_sleepEstimate + (slept - m_sleepEstimate) * 0.01;
+		now = woken;
+	}
+	Clock::time_point sleepEnd = now;
+
+	while (now < m_deadline)
+		now = Clock::now();
+
+	m_sleepTime = std::chrono::duration<float, std::milli>(sleepEnd - start).count();
+	m_spinTime = std::chrono::duration<float, std::milli>(now - sleepEnd).count();
+}
+
+void FrameTimer::updateStats(float frameTime) {
+	m_window[m_windowNext] = frameTime;
+	m_windowNext = (m_windowNext + 1) % WINDOW_SIZE;
+	if (m_windowCount < WINDOW_SIZE)
+		++m_windowCount;
+
+	// frames more than half a millisecond over the target's frame time missed their deadline
+	float missTime = m_mode == PACING_TARGET && m_targetFPS > 0 ? 1000.0f / m_targetFPS + 0.5f : 0;
+
+	Stats& stats = m_stats[m_mode];
+	stats = Stats();
+	stats.frameCount = m_windowCount;
+	stats.min = frameTime;
+	stats.max = frameTime;
+
+	double sum = 0;
+	for (unsigned int i = 0; i < m_windowCount; ++i) {
+		sum += m_window[i];
+		stats.min = std::min(stats.min, m_window[i]);
+		stats.max = std::max(stats.max, m_window[i]);
+		if (missTime > 0 &&
+			m_window[i] > missTime)
+			++stats.missedCount;
+	}
+	stats.mean = (float)(sum / m_windowCount);
+
+	double variance = 0;
+	for (unsigned int i = 0; i < m_windowCount; ++i)
+		variance += (m_window[i] - stats.mean) * (m_window[i] - stats.mean);
+	stats.deviation = (float)std::sqrt(variance / m_windowCount);
+}
+
+} // namespace aie
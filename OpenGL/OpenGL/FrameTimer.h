@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+
+namespace aie {
+
+// times frames and decouples simulation from them. Each frame's time is added to an
+// accumulator that's spent in fixed ticks, whatever is left over interpolates between the last
+// two ticks. Frames are paced by vsync, not at all, or to a target rate by sleeping to just
+// before each deadline and spinning the rest of the way
+class FrameTimer {
+public:
+
+	enum PacingMode : unsigned int {
+		PACING_VSYNC,		// presenting waits for the display, the app sets the swap interval
+		PACING_UNCAPPED,
+		PACING_TARGET,		// waitForDeadline() holds each frame to the target rate
+
+		PACING_Count,
+	};
+
+	// frame times in milliseconds over the last WINDOW_SIZE frames in a mode
+	struct Stats {
+		float			mean = 0;
+		float			deviation = 0;	// standard deviation
+		float			min = 0;
+		float			max = 0;
+		unsigned int	frameCount = 0;
+		unsigned int	missedCount = 0;	// frames over the target's frame time, PACING_TARGET only
+	};
+
+	FrameTimer();
+
+	// simulation ticks per second, every tick advances it by 1 / rate seconds
+	void setTickRate(float ticksPerSecond);
+	float getTickTime() const { return (float)m_tickTime; }
+
+	// changing mode starts its stats again
+	void setPacing(PacingMode mode, float targetFPS);
+	PacingMode getPacingMode() const { return m_mode; }
+	float getTargetFPS() const { return m_targetFPS; }
+
+	// starts a frame, returning how many simulation ticks are due. Long frames only add up to
+	// MAX_FRAME_TIME, so a stall can't leave the simulation forever catching up
+	unsigned int beginFrame();
+
+	// waits until the frame's deadline in PACING_TARGET, returning straight away otherwise.
+	// Called just before presenting
+	void waitForDeadline();
+
+	// how far through the next tick the simulation is, from 0 to 1
+	float getAlpha() const { return (float)(m_accumulator / m_tickTime); }
+
+	// seconds the last frame took, waiting included
+	float getFrameTime() const { return (float)m_frameTime; }
+	unsigned int getTickCount() const { return m_tickCount; }
+
+	// time in milliseconds the last waitForDeadline() slept and spun
+	float getSleepTime() const { return m_sleepTime; }
+	float getSpinTime() const { return m_spinTime; }
+
+	const Stats& getStats(PacingMode mode) const { return m_stats[mode]; }
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	static const unsigned int WINDOW_SIZE = 240;
+	static constexpr double MAX_FRAME_TIME = 0.25;
+
+	void updateStats(float frameTime);
+
+	Clock::time_point	m_frameStart;
+	Clock::time_point	m_deadline;
+	bool				m_started;
+
+	double			m_tickTime;
+	double			m_accumulator;
+	double			m_frameTime;
+	unsigned int	m_tickCount;
+
+	PacingMode		m_mode;
+	float			m_targetFPS;
+
+	// how long sleep_for(1ms) has taken, the last stretch before a deadline is spun instead
+	double			m_sleepEstimate;
+	float			m_sleepTime;
+	float			m_spinTime;
+
+	float			m_window[WINDOW_SIZE];
+	unsigned int	m_windowCount;
+	unsigned int	m_windowNext;
+	Stats			m_stats[PACING_Count];
+};
+
+} // namespace aie
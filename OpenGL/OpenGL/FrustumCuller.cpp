@@ -0,0 +1,220 @@
+#include "FrustumCuller.h"
+#include "CPUProfiler.h"
+#include "Parallel.h"
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE
+#endif
+
+namespace aie {
+
+void FrustumCuller::clear() {
+	m_centreX.clear();
+	m_centreY.clear();
+	m_centreZ.clear();
+	m_radius.clear();
+}
+
+void FrustumCuller::reserve(size_t count) {
+	m_centreX.reserve(count);
+	m_centreY.reserve(count);
+	m_centreZ.reserve(count);
+	m_radius.reserve(count);
+}
+
+unsigned int FrustumCuller::add(const glm::vec3& centre, float radius) {
+	m_centreX.push_back(centre.x);
+	m_centreY.push_back(centre.y);
+	m_centreZ.push_back(centre.z);
+	m_radius.push_back(radius);
+	return (unsigned int)m_radius.size() - 1;
+}
+
+unsigned int FrustumCuller::add(const glm::mat4& transform, const glm::vec3& centre, float radius) {
+	float scale = glm::max(glm::length(glm::vec3(transform[0])),
+						   glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+	return add(glm::vec3(transform * glm::vec4(centre, 1)), radius * scale);
+}
+
+void FrustumCuller::set(unsigned int index, const glm::vec3& centre, float radius) {
+	assert(index < m_radius.size());
+	m_centreX[index] = centre.x;
+	m_centreY[index] = centre.y;
+	m_centreZ[index] = centre.z;
+	m_radius[index] = radius;
+}
+
+const char* FrustumCuller::getSIMDName() {
+#if defined(FRUSTUM_CULLER_AVX)
+	return "AVX";
+#elif defined(FRUSTUM_CULLER_SSE)
+	return "SSE";
+#else
+	return "none";
+#endif
+}
+
+unsigned int FrustumCuller::getSIMDWidth() {
+#if defined(FRUSTUM_CULLER_AVX)
+	return 8;
+#elif defined(FRUSTUM_CULLER_SSE)
+	return 4;
+#else
+	return 1;
+#endif
+}
+
+void FrustumCuller::extractPlanes(const glm::mat4& projectionView, glm::vec4 planes[6]) {
+	// each plane is the last row of the matrix plus or minus one of the others, which keeps
+	// -w <= x, y, z <= w in clip space
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; ++row)
+		rows[row] = glm::vec4(projectionView[0][row], projectionView[1][row], projectionView[2][row], projectionView[3][row]);
+
+	for (int axis = 0; axis < 3; ++axis) {
+		planes[axis * 2 + 0] = rows[3] + rows[axis];
+		planes[axis * 2 + 1] = rows[3] - rows[axis];
+	}
+
+	// normalised so the plane distance can be compared with the radius
+	for (int i = 0; i < 6; ++i)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void FrustumCuller::cull(const glm::mat4& projectionView, std::vector<unsigned int>& visible, Method method /* = SIMD */) {
+	PROFILE_ZONE("Culling");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	glm::vec4 planes[6];
+	extractPlanes(projectionView, planes);
+
+	// written in place, every range starts where it would if all of it were visible
+	size_t count = m_radius.size();
+	visible.resize(count);
+
+	if (method == SIMD_THREADED && count >= MIN_THREAD_RANGE * 2) {
+		unsigned int rangeCount = std::max(1u, std::thread::hardware_concurrency());
+		rangeCount = std::min(rangeCount, (unsigned int)(count / MIN_THREAD_RANGE));
+
+		// ranges are a multiple of the SIMD width so only the last has a scalar tail
+		size_t width = getSIMDWidth();
+		size_t rangeSize = ((count + rangeCount - 1) / rangeCount + width - 1) / width * width;
+
+		std::vector<size_t> rangeVisible(rangeCount, 0);
+		parallelFor(rangeCount, [&](unsigned int range) {
+			PROFILE_ZONE("Cull Range");
+			size_t begin = std::min(count, range * rangeSize);
+			size_t end = std::min(count, begin + rangeSize);
+			rangeVisible[range] = cullSIMD(planes, begin, end, visible.data() + begin);
+		});
+
+		// each range's results move down to follow the last, never overlapping a later range
+		size_t total = rangeVisible[0];
+		for (unsigned int range = 1; range < rangeCount; ++range) {
+			size_t begin = std::min(count, range * rangeSize);
+			std::copy(visible.begin() + begin, visible.begin() + begin + rangeVisible[range], visible.begin() + total);
+			total += rangeVisible[range];
+		}
+		visible.resize(total);
+	}
+	else if (method == SCALAR)
+		visible.resize(cullScalar(planes, 0, count, visible.data()));
+	else
+		visible.resize(cullSIMD(planes, 0, count, visible.data()));
+
+	m_cullTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+size_t FrustumCuller::cullScalar(const glm::vec4 planes[6], size_t begin, size_t end, unsigned int* visible) const {
+	size_t visibleCount = 0;
+	for (size_t i = begin; i < end; ++i) {
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p)
+			inside = planes[p].x * m_centreX[i] + planes[p].y * m_centreY[i] + planes[p].z * m_centreZ[i] + planes[p].w > -m_radius[i];
+
+		// written either way, only counted when inside, so there's no branch on the result
+		visible[visibleCount] = (unsigned int)i;
+		visibleCount += inside ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+size_t FrustumCuller::cullSIMD(const glm::vec4 planes[6], size_t begin, size_t end, unsigned int* visible) const {
+	size_t visibleCount = 0;
+	size_t i = begin;
+
+#if defined(FRUSTUM_CULLER_AVX)
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p) {
+		planeX[p] = _mm256_set1_ps(planes[p].x);
+		planeY[p] = _mm256_set1_ps(planes[p].y);
+		planeZ[p] = _mm256_set1_ps(planes[p].z);
+		planeW[p] = _mm256_set1_ps(planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&m_centreX[i]);
+		__m256 y = _mm256_loadu_ps(&m_centreY[i]);
+		__m256 z = _mm256_loadu_ps(&m_centreZ[i]);
+		__m256 negativeRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&m_radius[i]));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+											_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GT_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (unsigned int lane = 0; lane < 8; ++lane) {
+			visible[visibleCount] = (unsigned int)(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#elif defined(FRUSTUM_CULLER_SSE)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p) {
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&m_centreX[i]);
+		__m128 y = _mm_loadu_ps(&m_centreY[i]);
+		__m128 z = _mm_loadu_ps(&m_centreZ[i]);
+		__m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&m_radius[i]));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+										 _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+		}
+
+		// compacted by always writing the index and only advancing past the visible ones
+		int mask = _mm_movemask_ps(inside);
+		for (unsigned int lane = 0; lane < 4; ++lane) {
+			visible[visibleCount] = (unsigned int)(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	// the spheres left over after the last full register
+	return visibleCount + cullScalar(planes, i, end, visible + visibleCount);
+}
+
+} // namespace aie
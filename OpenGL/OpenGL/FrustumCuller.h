@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+namespace aie {
+
+// bounding spheres stored as separate x, y, z and radius arrays, so the frustum test can load
+// 4 spheres per SSE register (8 with AVX) and test them against each plane at once
+class FrustumCuller {
+public:
+
+	enum Method : unsigned int {
+		SCALAR = 0,		// one sphere at a time, for reference
+		SIMD,			// SSE, or AVX when compiled with it
+		SIMD_THREADED,	// SIMD split in to contiguous ranges across threads
+	};
+
+	FrustumCuller() : m_cullTime(0) {}
+
+	FrustumCuller(const FrustumCuller&) = delete;
+	FrustumCuller& operator = (const FrustumCuller&) = delete;
+
+	void clear();
+	void reserve(size_t count);
+
+	// returns the sphere's index, which is what cull() writes to the visible list
+	unsigned int add(const glm::vec3& centre, float radius);
+
+	// adds a local space sphere moved in to world space, scaled by the largest axis scale
+	unsigned int add(const glm::mat4& transform, const glm::vec3& centre, float radius);
+
+	void set(unsigned int index, const glm::vec3& centre, float radius);
+
+	size_t getCount() const { return m_radius.size(); }
+
+	// fills visible with the indices, in increasing order, of every sphere at least partly
+	// inside the frustum of the projection * view matrix
+	void cull(const glm::mat4& projectionView, std::vector<unsigned int>& visible, Method method = SIMD);
+
+	// CPU time of the last cull(), in milliseconds
+	float getCullTime() const { return m_cullTime; }
+
+	// the instruction set the SIMD methods were compiled for and the spheres each step tests
+	static const char* getSIMDName();
+	static unsigned int getSIMDWidth();
+
+private:
+
+	// threaded culls don't split ranges smaller than this, the thread start up would cost more
+	static const size_t MIN_THREAD_RANGE = 16384;
+
+	// left, right, bottom, top, near and far planes with normalised normals pointing inwards
+	static void extractPlanes(const glm::mat4& projectionView, glm::vec4 planes[6]);
+
+	// culls [begin, end), writing the visible indices from visible[0] and returning how many
+	size_t cullScalar(const glm::vec4 planes[6], size_t begin, size_t end, unsigned int* visible) const;
+	size_t cullSIMD(const glm::vec4 planes[6], size_t begin, size_t end, unsigned int* visible) const;
+
+	std::vector<float>	m_centreX;
+	std::vector<float>	m_centreY;
+	std::vector<float>	m_centreZ;
+	std::vector<float>	m_radius;
+
+	float	m_cullTime;
+};
+
+} // namespace aie
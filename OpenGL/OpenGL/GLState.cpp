@@ -0,0 +1,162 @@
+#include "GLState.h"
+#include "gl_core_4_4.h"
+#include <cassert>
+
+namespace aie {
+
+unsigned int GLState::sm_program = GLState::UNKNOWN;
+unsigned int GLState::sm_pipeline = GLState::UNKNOWN;
+unsigned int GLState::sm_vertexArray = GLState::UNKNOWN;
+unsigned int GLState::sm_arrayBuffer = GLState::UNKNOWN;
+unsigned int GLState::sm_uniformBuffer = GLState::UNKNOWN;
+unsigned int GLState::sm_activeUnit = GLState::UNKNOWN;
+unsigned int GLState::sm_textures[GLState::MAX_TEXTURE_UNITS] = {
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+	UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+};
+
+std::thread::id GLState::sm_renderThread;
+
+unsigned int GLState::sm_issued[GLState::BINDING_Count] = {};
+unsigned int GLState::sm_elided[GLState::BINDING_Count] = {};
+unsigned int GLState::sm_lastIssued[GLState::BINDING_Count] = {};
+unsigned int GLState::sm_lastElided[GLState::BINDING_Count] = {};
+
+void GLState::useProgram(unsigned int program) {
+	assert(isRenderThread() && "GL state changed off the render thread");
+	if (sm_program == program) {
+		++sm_elided[PROGRAM];
+		return;
+	}
+	++sm_issued[PROGRAM];
+	sm_program = program;
+	glUseProgram(program);
+}
+
+void GLState::bindProgramPipeline(unsigned int pipeline) {
+	assert(isRenderThread() && "GL state changed off the render thread");
+	useProgram(0);
+	if (sm_pipeline == pipeline) {
+		++sm_elided[PROGRAM];
+		return;
+	}
+	++sm_issued[PROGRAM];
+	sm_pipeline = pipeline;
+	glBindProgramPipeline(pipeline);
+}
+
+void GLState::bindVertexArray(unsigned int vao) {
+	assert(isRenderThread() && "GL state changed off the render thread");
+	if (sm_vertexArray == vao) {
+		++sm_elided[VERTEX_ARRAY];
+		return;
+	}
+	++sm_issued[VERTEX_ARRAY];
+	sm_vertexArray = vao;
+	glBindVertexArray(vao);
+}
+
+unsigned int* GLState::findBuffer(unsigned int target) {
+	switch (target) {
+	case GL_ARRAY_BUFFER:	return &sm_arrayBuffer;
+	case GL_UNIFORM_BUFFER:	return &sm_uniformBuffer;
+	default:				return nullptr;
+	}
+}
+
+void GLState::bindBuffer(unsigned int target, unsigned int buffer) {
+	assert(isRenderThread() && "GL state changed off the render thread");
+	unsigned int* bound = findBuffer(target);
+	if (bound != nullptr) {
+		if (*bound == buffer) {
+			++sm_elided[BUFFER];
+			return;
+		}
+		*bound = buffer;
+	}
+	++sm_issued[BUFFER];
+	glBindBuffer(target, buffer);
+}
+
+void GLState::bindBufferBase(unsigned int target, unsigned int index, unsigned int buffer) {
+	assert(isRenderThread() && "GL state changed off the render thread");
+	unsigned int* bound = findBuffer(target);
+	if (bound != nullptr)
+		*bound = buffer;
+	++sm_issued[BUFFER];
+	glBindBufferBase(target, index, buffer);
+}
+
+bool GLState::bindTexture(unsigned int unit, unsigned int texture) {
+	assert(isRenderThread() && "GL state changed off the render thread");
+	assert(unit < MAX_TEXTURE_UNITS && "Texture unit out of range");
+	if (sm_textures[unit] == texture) {
+		++sm_elided[TEXTURE];
+		return false;
+	}
+	if (sm_activeUnit != unit) {
+		sm_activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	++sm_issued[TEXTURE];
+	sm_textures[unit] = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	return true;
+}
+
+void GLState::bindTexture(unsigned int texture) {
+	// the unit being bound to has to be known to shadow it
+	bindTexture(sm_activeUnit != UNKNOWN ? sm_activeUnit : 0, texture);
+}
+
+void GLState::removeProgram(unsigned int program) {
+	if (sm_program == program)
+		sm_program = UNKNOWN;
+}
+
+void GLState::removeProgramPipeline(unsigned int pipeline) {
+	if (sm_pipeline == pipeline)
+		sm_pipeline = 0;
+}
+
+void GLState::removeVertexArray(unsigned int vao) {
+	if (sm_vertexArray == vao)
+		sm_vertexArray = 0;
+}
+
+void GLState::removeBuffer(unsigned int buffer) {
+	if (sm_arrayBuffer == buffer)
+		sm_arrayBuffer = 0;
+	if (sm_uniformBuffer == buffer)
+		sm_uniformBuffer = 0;
+}
+
+void GLState::removeTexture(unsigned int texture) {
+	for (auto& t : sm_textures)
+		if (t == texture)
+			t = 0;
+}
+
+void GLState::invalidate() {
+	sm_program = UNKNOWN;
+	sm_pipeline = UNKNOWN;
+	sm_vertexArray = UNKNOWN;
+	sm_arrayBuffer = UNKNOWN;
+	sm_uniformBuffer = UNKNOWN;
+	sm_activeUnit = UNKNOWN;
+	for (auto& t : sm_textures)
+		t = UNKNOWN;
+}
+
+void GLState::endFrame() {
+	for (unsigned int i = 0; i < BINDING_Count; ++i) {
+		sm_lastIssued[i] = sm_issued[i];
+		sm_lastElided[i] = sm_elided[i];
+		sm_issued[i] = 0;
+		sm_elided[i] = 0;
+	}
+}
+
+} // namespace aie
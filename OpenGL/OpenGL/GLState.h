@@ -0,0 +1,95 @@
+#pragma once
+
+#include <thread>
+
+namespace aie {
+
+// shadows the GL bindings that change most often so calls that wouldn't change anything
+// are skipped, and counts the calls issued and skipped each frame. Code that binds these
+// through GL directly must call invalidate() afterwards, or a later call may be wrongly skipped
+class GLState {
+public:
+
+	enum Binding : unsigned int {
+		PROGRAM,
+		VERTEX_ARRAY,
+		BUFFER,
+		TEXTURE,
+		UNIFORM,
+
+		BINDING_Count,
+	};
+
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+	// the thread that owns the GL context. Every bind asserts it's made from that thread, so
+	// GL reached from a recording thread fails in debug builds instead of corrupting state
+	static void setRenderThread() { sm_renderThread = std::this_thread::get_id(); }
+	static bool isRenderThread() { return sm_renderThread == std::thread::id() || sm_renderThread == std::this_thread::get_id(); }
+
+	static void useProgram(unsigned int program);
+
+	// a bound program overrides the bound pipeline, so this unbinds any program first.
+	// Both are counted as PROGRAM
+	static void bindProgramPipeline(unsigned int pipeline);
+	static void bindVertexArray(unsigned int vao);
+
+	// only GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER are shadowed, other targets are always issued.
+	// GL_ELEMENT_ARRAY_BUFFER belongs to the bound vertex array so can't be shadowed here
+	static void bindBuffer(unsigned int target, unsigned int buffer);
+
+	// always issued, but it also binds the target's generic binding point
+	static void bindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+
+	// binds a 2D texture to a unit, only changing the active unit if the binding changes.
+	// Returns false if the texture was already bound there
+	static bool bindTexture(unsigned int unit, unsigned int texture);
+
+	// binds a 2D texture to whichever unit is active, for creating and updating textures
+	static void bindTexture(unsigned int texture);
+
+	// GL unbinds objects as they're deleted, so call these first or a recycled name
+	// could be mistaken for one that's still bound
+	static void removeProgram(unsigned int program);
+	static void removeProgramPipeline(unsigned int pipeline);
+	static void removeVertexArray(unsigned int vao);
+	static void removeBuffer(unsigned int buffer);
+	static void removeTexture(unsigned int texture);
+
+	// forgets every binding so each is issued again, after code that binds through GL directly
+	static void invalidate();
+
+	// counts a call shadowed elsewhere, such as uniform values by ShaderProgram
+	static void count(Binding binding, bool issued) { ++(issued ? sm_issued : sm_elided)[binding]; }
+
+	// calls issued and skipped during the last frame
+	static unsigned int getIssuedCount(Binding binding) { return sm_lastIssued[binding]; }
+	static unsigned int getElidedCount(Binding binding) { return sm_lastElided[binding]; }
+
+	// makes this frame's counts the last frame's and starts counting again
+	static void endFrame();
+
+private:
+
+	// a binding that isn't known, so the next call is always issued
+	static const unsigned int UNKNOWN = ~0u;
+
+	static unsigned int*	findBuffer(unsigned int target);
+
+	static std::thread::id	sm_renderThread;
+
+	static unsigned int	sm_program;
+	static unsigned int	sm_pipeline;
+	static unsigned int	sm_vertexArray;
+	static unsigned int	sm_arrayBuffer;
+	static unsigned int	sm_uniformBuffer;
+	static unsigned int	sm_activeUnit;
+	static unsigned int	sm_textures[MAX_TEXTURE_UNITS];
+
+	static unsigned int	sm_issued[BINDING_Count];
+	static unsigned int	sm_elided[BINDING_Count];
+	static unsigned int	sm_lastIssued[BINDING_Count];
+	static unsigned int	sm_lastElided[BINDING_Count];
+};
+
+} // namespace aie
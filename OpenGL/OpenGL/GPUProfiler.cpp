@@ -0,0 +1,197 @@
+#include "GPUProfiler.h"
+#include "gl_core_4_4.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace aie {
+
+GPUProfiler::GPUProfiler()
+	: m_frames(),
+	m_frame(0),
+	m_created(false),
+	m_inFrame(false),
+	m_frameScope(INVALID_SCOPE),
+	m_depth(0),
+	m_historyNext(0),
+	m_historyCount(0),
+	m_droppedCount(0) {
+}
+
+GPUProfiler::~GPUProfiler() {
+	destroy();
+}
+
+bool GPUProfiler::create() {
+
+	if (m_created) {
+		printf("GPU profiler already created!\n");
+		return false;
+	}
+
+	for (auto& frame : m_frames) {
+		glGenQueries(MAX_SCOPES * 2, frame.queries);
+		frame.scopes.reserve(MAX_SCOPES);
+	}
+	m_created = true;
+	return true;
+}
+
+void GPUProfiler::destroy() {
+	if (m_created == false)
+		return;
+
+	for (auto& frame : m_frames) {
+		glDeleteQueries(MAX_SCOPES * 2, frame.queries);
+		frame.scopes.clear();
+	}
+	m_created = false;
+	m_inFrame = false;
+}
+
+void GPUProfiler::beginFrame() {
+	if (m_created == false)
+		return;
+
+	// the oldest frame's queries are the ones reused next
+	m_frame = (m_frame + 1) % FRAME_LATENCY;
+	FrameQueries& frame = m_frames[m_frame];
+	if (frame.scopes.empty() == false)
+		resolve(frame);
+	frame.scopes.clear();
+
+	m_inFrame = true;
+	m_depth = 0;
+	m_frameScope = begin("Frame");
+}
+
+void GPUProfiler::endFrame() {
+	if (m_inFrame == false)
+		return;
+
+	end(m_frameScope);
+	m_inFrame = false;
+}
+
+unsigned int GPUProfiler::begin(const char* name) {
+	FrameQueries& frame = m_frames[m_frame];
+	if (m_inFrame == false ||
+		frame.scopes.size() == MAX_SCOPES)
+		return INVALID_SCOPE;
+
+	unsigned int scope = (unsigned int)frame.scopes.size();
+	frame.scopes.push_back({ findOrAddPass(name, m_depth), m_depth });
+	glQueryCounter(frame.queries[scope * 2], GL_TIMESTAMP);
+	++m_depth;
+	return scope;
+}
+
+void GPUProfiler::end(unsigned int scope) {
+	if (m_inFrame == false ||
+		scope == INVALID_SCOPE)
+		return;
+
+	glQueryCounter(m_frames[m_frame].queries[scope * 2 + 1], GL_TIMESTAMP);
+	--m_depth;
+}
+
+const GPUProfiler::Pass* GPUProfiler::findPass(const char* name) const {
+	for (auto& pass : m_passes)
+		if (pass.name == name)
+			return &pass;
+	return nullptr;
+}
+
+unsigned int GPUProfiler::findOrAddPass(const char* name, unsigned int depth) {
+	// only a handful of passes, a search is cheaper than hashing the name
+	for (unsigned int i = 0; i < m_passes.size(); ++i)
+		if (m_passes[i].name == name)
+			return i;
+
+	// earlier frames didn't run it
+	Pass pass;
+	pass.name = name;
+	pass.depth = depth;
+	std::fill(pass.history, pass.history + HISTORY_SIZE, -1.0f);
+	m_passes.push_back(pass);
+	return (unsigned int)m_passes.size() - 1;
+}
+
+void GPUProfiler::resolve(FrameQueries& frame) {
+	// the frame scope ends last, so once it's ready every query in the frame is
+	int available = GL_FALSE;
+	glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == GL_FALSE) {
+		++m_droppedCount;
+		return;
+	}
+
+	// a pass run more than once in a frame adds up
+	m_frameTimes.assign(m_passes.size(), -1.0f);
+	for (unsigned int scope = 0; scope < frame.scopes.size(); ++scope) {
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[scope * 2], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(frame.queries[scope * 2 + 1], GL_QUERY_RESULT, &end);
+
+		float& time = m_frameTimes[frame.scopes[scope].pass];
+		time = std::max(time, 0.0f) + (float)((end - start) / 1000000.0);
+	}
+
+	for (unsigned int i = 0; i < m_passes.size(); ++i) {
+		Pass& pass = m_passes[i];
+		pass.history[m_historyNext] = m_frameTimes[i];
+		if (m_frameTimes[i] >= 0)
+			pass.last = m_frameTimes[i];
+	}
+	m_historyNext = (m_historyNext + 1) % HISTORY_SIZE;
+	if (m_historyCount < HISTORY_SIZE)
+		++m_historyCount;
+
+	for (auto& pass : m_passes) {
+		float sum = 0;
+		unsigned int count = 0;
+		pass.min = 0;
+		pass.max = 0;
+		for (unsigned int i = 0; i < m_historyCount; ++i) {
+			float time = pass.history[i];
+			if (time < 0)
+				continue;
+			pass.min = count == 0 ? time : std::min(pass.min, time);
+			pass.max = count == 0 ? time : std::max(pass.max, time);
+			sum += time;
+			++count;
+		}
+		pass.average = count > 0 ? sum / count : 0;
+	}
+}
+
+bool GPUProfiler::writeCSV(const char* filename) const {
+	FILE* file = nullptr;
+	fopen_s(&file, filename, "w");
+	if (file == nullptr) {
+		printf("Failed to open [%s] for writing\n", filename);
+		return false;
+	}
+
+	fprintf(file, "frame");
+	for (auto& pass : m_passes)
+		fprintf(file, ",%s (ms)", pass.name.c_str());
+	fprintf(file, "\n");
+
+	unsigned int start = getHistoryStart();
+	for (unsigned int row = 0; row < m_historyCount; ++row) {
+		unsigned int entry = (start + row) % HISTORY_SIZE;
+		fprintf(file, "%u", row);
+		for (auto& pass : m_passes) {
+			if (pass.history[entry] >= 0)
+				fprintf(file, ",%.4f", pass.history[entry]);
+			else
+				fprintf(file, ",");
+		}
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	return true;
+}
+
+} // namespace aie
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace aie {
+
+// times render passes on the GPU with timestamp queries around each scope. Queries are kept
+// for FRAME_LATENCY frames before they're read, by which time the GPU has finished them, so
+// reading never waits. A frame whose results still aren't ready is dropped instead. Scopes can
+// nest, and every frame is also timed as a whole as the "Frame" pass
+class GPUProfiler {
+public:
+
+	static const unsigned int FRAME_LATENCY = 3;
+	static const unsigned int HISTORY_SIZE = 120;
+	static const unsigned int MAX_SCOPES = 32;		// scopes per frame, later ones aren't timed
+	static const unsigned int INVALID_SCOPE = ~0u;
+
+	// a named pass's GPU time in milliseconds over the last HISTORY_SIZE resolved frames.
+	// Frames the pass didn't run in are -1 in the history and left out of the stats
+	struct Pass {
+		std::string		name;
+		unsigned int	depth = 0;		// scopes it was nested in when first seen
+		float			history[HISTORY_SIZE];
+		float			last = 0;
+		float			average = 0;
+		float			min = 0;
+		float			max = 0;
+	};
+
+	// times the lifetime of a block as a pass
+	class Scope {
+	public:
+		Scope(GPUProfiler& profiler, const char* name) : m_profiler(profiler), m_scope(profiler.begin(name)) {}
+		~Scope() { m_profiler.end(m_scope); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator = (const Scope&) = delete;
+
+	private:
+		GPUProfiler&	m_profiler;
+		unsigned int	m_scope;
+	};
+
+	GPUProfiler();
+	~GPUProfiler();
+
+	GPUProfiler(const GPUProfiler&) = delete;
+	GPUProfiler& operator = (const GPUProfiler&) = delete;
+
+	// creates the queries, will fail if already created
+	bool create();
+	void destroy();
+
+	// reads the results of the frame FRAME_LATENCY frames ago, then starts timing a new one
+	void beginFrame();
+	void endFrame();
+
+	// scopes must end in the reverse order they began, within the same frame
+	unsigned int begin(const char* name);
+	void end(unsigned int scope);
+
+	size_t getPassCount() const { return m_passes.size(); }
+	const Pass& getPass(size_t index) const { return m_passes[index]; }
+
+	// nullptr if no pass of that name has been timed
+	const Pass* findPass(const char* name) const;
+
+	// index of the oldest entry in each pass's history, which wraps around
+	unsigned int getHistoryStart() const { return m_historyCount < HISTORY_SIZE ? 0 : m_historyNext; }
+	unsigned int getHistoryCount() const { return m_historyCount; }
+
+	// frames dropped because their results weren't ready in time
+	unsigned int getDroppedCount() const { return m_droppedCount; }
+
+	// writes the history as a row per frame, oldest first, with a column of milliseconds per
+	// pass. Passes that didn't run in a frame are left empty
+	bool writeCSV(const char* filename) const;
+
+private:
+
+	struct ScopeRecord {
+		unsigned int	pass;
+		unsigned int	depth;
+	};
+
+	// a frame's queries, two per scope for its start and end
+	struct FrameQueries {
+		unsigned int				queries[MAX_SCOPES * 2];
+		std::vector<ScopeRecord>	scopes;
+	};
+
+	unsigned int findOrAddPass(const char* name, unsigned int depth);
+	void resolve(FrameQueries& frame);
+
+	FrameQueries	m_frames[FRAME_LATENCY];
+	unsigned int	m_frame;
+	bool			m_created;
+	bool			m_inFrame;
+	unsigned int	m_frameScope;
+	unsigned int	m_depth;
+
+	std::vector<Pass>	m_passes;
+	std::vector<float>	m_frameTimes;	// this frame's time per pass while resolving
+
+	unsigned int	m_historyNext;
+	unsigned int	m_historyCount;
+	unsigned int	m_droppedCount;
+};
+
+} // namespace aie
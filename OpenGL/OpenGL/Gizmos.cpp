@@ -3,6 +3,7 @@
 #include <glm/ext.hpp>
 #include <iostream>
 #include "../../OpenGL/gl_core_4_4.h"
+#include "StreamBuffer.h"
 
 namespace aie {
 
@@ -23,7 +24,9 @@ Gizmos::Gizmos(unsigned int maxLines, unsigned int maxTris,
 	m_2Dlines(new GizmoLine[max2DLines]),
 	m_max2DTris(max2DTris),
 	m_2DtriCount(0),
-	m_2Dtris(new GizmoTri[max2DTris]) {
+	m_2Dtris(new GizmoTri[max2DTris]),
+	m_streamBuffer(nullptr),
+	m_streamVAO(0) {
 
 	// create shaders
 	const char* vsSource = "#version 150\n \
@@ -151,6 +154,8 @@ Gizmos::~Gizmos() {
 	glDeleteBuffers( 1, &m_2DtriVBO );
 	glDeleteVertexArrays( 1, &m_2DlineVAO );
 	glDeleteVertexArrays( 1, &m_2DtriVAO );
+	if (m_streamVAO != 0)
+		glDeleteVertexArrays( 1, &m_streamVAO );
 	glDeleteProgram(m_shader);
 }
 
@@ -165,6 +170,47 @@ void Gizmos::destroy() {
 	sm_singleton = nullptr;
 }
 
+void Gizmos::setStreamBuffer(StreamBuffer* buffer) {
+	if (sm_singleton == nullptr)
+		return;
+
+	sm_singleton->m_streamBuffer = buffer != nullptr && buffer->isCreated() ? buffer : nullptr;
+	if (sm_singleton->m_streamBuffer == nullptr)
+		return;
+
+	// same layout as the other arrays, the first vertex of a draw picks where it was written
+	if (sm_singleton->m_streamVAO == 0)
+		glGenVertexArrays(1, &sm_singleton->m_streamVAO);
+	glBindVertexArray(sm_singleton->m_streamVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer->getHandle());
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), (void*)16);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Gizmos::drawVertices(unsigned int mode, const GizmoVertex* vertices, unsigned int count,
+						  unsigned int vao, unsigned int vbo) {
+	size_t size = count * sizeof(GizmoVertex);
+
+	// aligned to whole vertices, so the offset is the first vertex to draw
+	size_t offset = m_streamBuffer != nullptr ? m_streamBuffer->write(vertices, size, sizeof(GizmoVertex)) : StreamBuffer::INVALID_OFFSET;
+	if (offset != StreamBuffer::INVALID_OFFSET) {
+		glBindVertexArray(m_streamVAO);
+		glDrawArrays(mode, (GLint)(offset / sizeof(GizmoVertex)), count);
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices);
+
+	glBindVertexArray(vao);
+	glDrawArrays(mode, 0, count);
+}
+
 void Gizmos::clear() {
 	sm_singleton->m_lineCount = 0;
 	sm_singleton->m_triCount = 0;
@@ -946,19 +992,13 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projectionView));
 
 		if (sm_singleton->m_lineCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_lineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_lineCount * sizeof(GizmoLine), sm_singleton->m_lines);
-
-			glBindVertexArray(sm_singleton->m_lineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_lineCount * 2);
+			sm_singleton->drawVertices(GL_LINES, &sm_singleton->m_lines->v0, sm_singleton->m_lineCount * 2,
+									   sm_singleton->m_lineVAO, sm_singleton->m_lineVBO);
 		}
 
 		if (sm_singleton->m_triCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_triVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_triCount * sizeof(GizmoTri), sm_singleton->m_tris);
-
-			glBindVertexArray(sm_singleton->m_triVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_triCount * 3);
+			sm_singleton->drawVertices(GL_TRIANGLES, &sm_singleton->m_tris->v0, sm_singleton->m_triCount * 3,
+									   sm_singleton->m_triVAO, sm_singleton->m_triVBO);
 		}
 		
 		if (sm_singleton->m_transparentTriCount > 0) {
@@ -977,11 +1017,8 @@ void Gizmos::draw(const glm::mat4& projectionView) {
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			glDepthMask(GL_FALSE);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
-
-			glBindVertexArray(sm_singleton->m_transparentTriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
+			sm_singleton->drawVertices(GL_TRIANGLES, &sm_singleton->m_transparentTris->v0, sm_singleton->m_transparentTriCount * 3,
+									   sm_singleton->m_transparentTriVAO, sm_singleton->m_transparentTriVBO);
 
 			// reset state
 			glDepthMask(depthMask);
@@ -1011,11 +1048,8 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(projection));
 
 		if (sm_singleton->m_2DlineCount > 0) {
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DlineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DlineCount * sizeof(GizmoLine), sm_singleton->m_2Dlines);
-
-			glBindVertexArray(sm_singleton->m_2DlineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_2DlineCount * 2);
+			sm_singleton->drawVertices(GL_LINES, &sm_singleton->m_2Dlines->v0, sm_singleton->m_2DlineCount * 2,
+									   sm_singleton->m_2DlineVAO, sm_singleton->m_2DlineVBO);
 		}
 
 		if (sm_singleton->m_2DtriCount > 0) {
@@ -1035,11 +1069,8 @@ void Gizmos::draw2D(const glm::mat4& projection) {
 
 			glDepthMask(GL_FALSE);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
-
-			glBindVertexArray(sm_singleton->m_2DtriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
+			sm_singleton->drawVertices(GL_TRIANGLES, &sm_singleton->m_2Dtris->v0, sm_singleton->m_2DtriCount * 3,
+									   sm_singleton->m_2DtriVAO, sm_singleton->m_2DtriVBO);
 
 			glDepthMask(depthMask);
 
@@ -4,6 +4,8 @@
 
 namespace aie {
 
+class StreamBuffer;
+
 // a singleton class for rendering immediate-mode 3-D primitives
 class Gizmos {
 public:
@@ -12,6 +14,10 @@ public:
 						   unsigned int max2DLines, unsigned int max2DTris);
 	static void		destroy();
 
+	// draws write their vertices in to the stream buffer instead of updating Gizmos' own
+	// buffers, which are still used for any that don't fit. nullptr stops streaming
+	static void		setStreamBuffer(StreamBuffer* buffer);
+
 	// removes all Gizmos
 	static void		clear();
 
@@ -112,6 +118,10 @@ private:
 		GizmoVertex v2;
 	};
 
+	// streams the vertices if it can, otherwise updates vbo and draws with vao
+	void			drawVertices(unsigned int mode, const GizmoVertex* vertices, unsigned int count,
+								 unsigned int vao, unsigned int vbo);
+
 	unsigned int	m_shader;
 
 	// line data
@@ -152,6 +162,10 @@ private:
 	unsigned int	m_2DtriVAO;
 	unsigned int 	m_2DtriVBO;
 
+	// streamed data
+	StreamBuffer*	m_streamBuffer;
+	unsigned int	m_streamVAO;
+
 	static Gizmos*	sm_singleton;
 };
 
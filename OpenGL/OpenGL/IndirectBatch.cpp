@@ -0,0 +1,87 @@
+#include "IndirectBatch.h"
+#include "gl_core_4_4.h"
+#include "GLState.h"
+#include "OBJMesh.h"
+#include <chrono>
+
+namespace aie {
+
+IndirectBatch::IndirectBatch(MeshPool& pool)
+	: m_pool(pool),
+	m_materialMesh(nullptr),
+	m_materialID(-1),
+	m_indirectBuffer(0),
+	m_capacity(0),
+	m_uploadTime(0) {
+}
+
+IndirectBatch::~IndirectBatch() {
+	if (m_indirectBuffer != 0) {
+		GLState::removeBuffer(m_indirectBuffer);
+		glDeleteBuffers(1, &m_indirectBuffer);
+	}
+}
+
+void IndirectBatch::add(const MeshPool::Range& range, const glm::mat4& transform) {
+	m_draws.push_back({ range, transform });
+}
+
+void IndirectBatch::upload() {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_commands.clear();
+	m_transforms.clear();
+	for (auto& draw : m_draws)
+		append(draw);
+	send();
+
+	m_uploadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void IndirectBatch::upload(const unsigned int* draws, size_t count) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_commands.clear();
+	m_transforms.clear();
+	for (size_t i = 0; i < count; ++i)
+		append(m_draws[draws[i]]);
+	send();
+
+	m_uploadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void IndirectBatch::append(const Draw& draw) {
+	// one instance each, starting at the draw's own transform
+	unsigned int instance = (unsigned int)m_transforms.size();
+	m_commands.push_back({ draw.range.indexCount, 1, draw.range.firstIndex, draw.range.baseVertex, instance });
+	m_transforms.push_back(draw.transform);
+}
+
+void IndirectBatch::send() {
+	m_instances.update(m_transforms.data(), m_transforms.size());
+
+	if (m_indirectBuffer == 0)
+		glGenBuffers(1, &m_indirectBuffer);
+	GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+
+	// orphaned like the instance buffer, the last frame's draws may still be reading it
+	if (m_commands.size() > m_capacity)
+		m_capacity = m_commands.size();
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, m_capacity * sizeof(Command), nullptr, GL_STREAM_DRAW);
+	if (m_commands.empty() == false)
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(Command), m_commands.data());
+}
+
+void IndirectBatch::draw() {
+	if (m_commands.empty())
+		return;
+
+	if (m_materialMesh != nullptr)
+		m_materialMesh->bindMaterial(m_materialID);
+
+	m_pool.bind(m_instances);
+	GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)m_commands.size(), 0);
+}
+
+} // namespace aie
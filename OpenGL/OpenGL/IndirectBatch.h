@@ -0,0 +1,82 @@
+#pragma once
+
+#include "InstanceBuffer.h"
+#include "MeshPool.h"
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+namespace aie {
+
+class OBJMesh;
+
+// draws of pooled chunks sharing a program and material, issued with one
+// glMultiDrawElementsIndirect. Each draw's transform is an instance picked out by its command's
+// base instance, so the INSTANCED shader variants draw batches unchanged. Materials differ in
+// their bound textures, which a per draw material index couldn't select without bindless
+// textures or texture arrays, so each material is its own batch
+class IndirectBatch {
+public:
+
+	IndirectBatch(MeshPool& pool);
+	~IndirectBatch();
+
+	IndirectBatch(const IndirectBatch&) = delete;
+	IndirectBatch& operator = (const IndirectBatch&) = delete;
+
+	// the OBJMesh material bound before drawing, every chunk in the batch must use it
+	void setMaterial(OBJMesh* mesh, int materialID) { m_materialMesh = mesh; m_materialID = materialID; }
+
+	// adds a draw of a chunk from the pool, which upload() sends to the GPU
+	void add(const MeshPool::Range& range, const glm::mat4& transform);
+
+	size_t getDrawCount() const { return m_draws.size(); }
+
+	// fills the indirect and instance buffers with every draw, or only the listed ones
+	void upload();
+	void upload(const unsigned int* draws, size_t count);
+
+	// draws everything uploaded with the bound program, which must be an INSTANCED variant
+	void draw();
+
+	size_t getUploadedCount() const { return m_commands.size(); }
+
+	// CPU time spent in the last upload(), in milliseconds
+	float getUploadTime() const { return m_uploadTime; }
+
+protected:
+
+	struct Draw {
+		MeshPool::Range	range;
+		glm::mat4		transform;
+	};
+
+	// GL's DrawElementsIndirectCommand
+	struct Command {
+		unsigned int	count;
+		unsigned int	instanceCount;
+		unsigned int	firstIndex;
+		int				baseVertex;
+		unsigned int	baseInstance;
+	};
+
+	// adds a draw's command and transform to the ones being uploaded
+	void append(const Draw& draw);
+
+	// sends the commands and transforms to their buffers
+	void send();
+
+	MeshPool&		m_pool;
+	OBJMesh*		m_materialMesh;
+	int				m_materialID;
+
+	std::vector<Draw>		m_draws;
+	std::vector<Command>	m_commands;
+	std::vector<glm::mat4>	m_transforms;
+
+	InstanceBuffer	m_instances;
+	unsigned int	m_indirectBuffer;
+	size_t			m_capacity;
+	float			m_uploadTime;
+};
+
+} // namespace aie
@@ -0,0 +1,77 @@
+#include "InstanceBuffer.h"
+#include "gl_core_4_4.h"
+#include "GLState.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <cassert>
+#include <chrono>
+
+namespace aie {
+
+unsigned int InstanceBuffer::sm_nextID = 1;
+
+InstanceBuffer::InstanceBuffer()
+	: m_handle(0),
+	m_id(sm_nextID++),
+	m_count(0),
+	m_capacity(0),
+	m_updateTime(0) {
+}
+
+InstanceBuffer::~InstanceBuffer() {
+	if (m_handle != 0) {
+		GLState::removeBuffer(m_handle);
+		glDeleteBuffers(1, &m_handle);
+	}
+}
+
+void InstanceBuffer::update(const glm::mat4* transforms, size_t count) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_instances.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		Instance& instance = m_instances[i];
+		instance.modelMatrix = transforms[i];
+		glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(transforms[i]));
+		for (int column = 0; column < 3; ++column)
+			instance.normalMatrix[column] = glm::vec4(normalMatrix[column], 0);
+	}
+	m_count = count;
+
+	if (m_handle == 0)
+		glGenBuffers(1, &m_handle);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, m_handle);
+
+	// the old storage is orphaned rather than overwritten while draws may still read it
+	if (count > m_capacity)
+		m_capacity = count;
+	glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+	if (count > 0)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Instance), m_instances.data());
+
+	m_updateTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void InstanceBuffer::attach() const {
+	assert(m_handle > 0 && "Instance buffer has never been updated");
+
+	GLState::bindBuffer(GL_ARRAY_BUFFER, m_handle);
+
+	for (unsigned int column = 0; column < 4; ++column) {
+		unsigned int attribute = FIRST_ATTRIBUTE + column;
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			(void*)(offsetof(Instance, modelMatrix) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	// a mat3 attribute reads three components per column, the padding is skipped by the offsets
+	for (unsigned int column = 0; column < 3; ++column) {
+		unsigned int attribute = FIRST_ATTRIBUTE + 4 + column;
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 3, GL_FLOAT, GL_FALSE, sizeof(Instance),
+			(void*)(offsetof(Instance, normalMatrix) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+	}
+}
+
+} // namespace aie
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace aie {
+
+// per instance transforms for instanced draws, read by the INSTANCED shader variants as vertex
+// attributes that advance once per instance (see data/shaders/include/instancing.glsl)
+class InstanceBuffer {
+public:
+
+	// the model matrix takes attributes 4 to 7, the normal matrix 8 to 10. Normal matrix
+	// columns are padded to vec4s so each starts on a 16 byte boundary
+	struct Instance {
+		glm::mat4	modelMatrix;
+		glm::vec4	normalMatrix[3];
+	};
+
+	static const unsigned int FIRST_ATTRIBUTE = 4;
+	static const unsigned int ATTRIBUTE_COUNT = 7;
+
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator = (const InstanceBuffer&) = delete;
+
+	// replaces every instance, computing the normal matrices. The buffer grows as needed and is
+	// otherwise orphaned, so the GPU never stalls on the last frame's instances
+	void update(const glm::mat4* transforms, size_t count);
+
+	// points the instance attributes of the bound vertex array at this buffer
+	void attach() const;
+
+	size_t getCount() const { return m_count; }
+	unsigned int getHandle() const { return m_handle; }
+
+	// unique for the life of the program, unlike GL names which are recycled. Meshes
+	// compare it to skip attaching the buffer their vertex arrays already point at
+	unsigned int getID() const { return m_id; }
+
+	// CPU time spent in the last update(), in milliseconds
+	float getUpdateTime() const { return m_updateTime; }
+
+protected:
+
+	unsigned int	m_handle;
+	unsigned int	m_id;
+	size_t			m_count;
+	size_t			m_capacity;
+	float			m_updateTime;
+
+	std::vector<Instance>	m_instances;
+
+	static unsigned int	sm_nextID;
+};
+
+} // namespace aie
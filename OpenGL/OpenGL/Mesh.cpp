@@ -1,9 +1,13 @@
 #include "Mesh.h"
 #include "gl_core_4_4.h"
+#include "GLState.h"
+#include "InstanceBuffer.h"
 
 // Mesh destructor destroys vertex arrays and buffers
 Mesh::~Mesh()
 {
+	aie::GLState::removeVertexArray(m_vao);
+	aie::GLState::removeBuffer(m_vbo);
 	glDeleteVertexArrays(1, &m_vao);
 	glDeleteBuffers(1, &m_vbo);
 	glDeleteBuffers(1, &m_ibo);
@@ -20,9 +24,9 @@ void Mesh::initialiseQuad()
 	glGenVertexArrays(1, &m_vao);
 
 	// bind vertex array aka a mesh wrapper
-	glBindVertexArray(m_vao);
+	aie::GLState::bindVertexArray(m_vao);
 	// bind vertex buffer
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	aie::GLState::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
 
 	// define 6 vertices for 2 triangles
 	Vertex vertices[6];
@@ -64,17 +68,21 @@ void Mesh::initialiseQuad()
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)32);
 
 	// unbind buffers
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	aie::GLState::bindVertexArray(0);
+	aie::GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 
 	// quad has 2 triangles
 	m_triCount = 2;
+
+	// the corners are half a unit from the centre on both axes
+	m_boundsCentre = glm::vec3(0);
+	m_boundsRadius = glm::sqrt(0.5f);
 }
 
 // Draw() counts the triangles in the mesh and draws the mesh in the position specified which also reads rotation and the vertices
 void Mesh::draw()
 {
-	glBindVertexArray(m_vao);
+	aie::GLState::bindVertexArray(m_vao);
 	// using indices or just vertices?
 	if (m_ibo != 0)
 		glDrawElements(GL_TRIANGLES, 3 * m_triCount,
@@ -82,3 +90,21 @@ void Mesh::draw()
 	else
 		glDrawArrays(GL_TRIANGLES, 0, 3 * m_triCount);
 }
+
+// draws every instance in the buffer, attaching it to the vertex array first if it isn't already
+void Mesh::drawInstanced(const aie::InstanceBuffer& instances)
+{
+	aie::GLState::bindVertexArray(m_vao);
+	if (m_instanceBufferID != instances.getID())
+	{
+		instances.attach();
+		m_instanceBufferID = instances.getID();
+	}
+
+	GLsizei count = (GLsizei)instances.getCount();
+	if (m_ibo != 0)
+		glDrawElementsInstanced(GL_TRIANGLES, 3 * m_triCount,
+			GL_UNSIGNED_INT, 0, count);
+	else
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 3 * m_triCount, count);
+}
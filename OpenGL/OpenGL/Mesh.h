@@ -3,10 +3,14 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
+namespace aie {
+class InstanceBuffer;
+}
+
 class Mesh
 {
 public:
-	Mesh() : m_triCount(0), m_vao(0), m_vbo(0), m_ibo(0) {}	// Mesh constructor intialises default values of 0 for m_vao, m_vbo and m_ibo
+	Mesh() : m_triCount(0), m_vao(0), m_vbo(0), m_ibo(0), m_instanceBufferID(0), m_boundsRadius(0) {}	// Mesh constructor intialises default values of 0 for m_vao, m_vbo and m_ibo
 	virtual ~Mesh();										// Mesh destructor destroys vertex arrays and buffers
 
 	// the Vertex struct has a position, normal and texture coordinates
@@ -20,8 +24,21 @@ public:
 	void initialiseQuad();	// Intialises a quad with vertices and the normal directed up
 	virtual void draw();	// Draw() counts the triangles in the mesh and draws the mesh in the position specified which also reads rotation and the vertices
 
+	// draws every instance in the buffer with one draw call, for the INSTANCED shader variants
+	void drawInstanced(const aie::InstanceBuffer& instances);
+
+	// a sphere around every vertex, in the mesh's own space, for culling
+	const glm::vec3& getBoundsCentre() const { return m_boundsCentre; }
+	float getBoundsRadius() const { return m_boundsRadius; }
+
 protected:
 	unsigned int m_triCount;
 	unsigned int m_vao, m_vbo, m_ibo;
+
+	// the instance buffer the vertex array's instance attributes point at, 0 for none
+	unsigned int m_instanceBufferID;
+
+	glm::vec3 m_boundsCentre;
+	float m_boundsRadius;
 };
 
@@ -0,0 +1,117 @@
+#include "MeshPool.h"
+#include "gl_core_4_4.h"
+#include "GLState.h"
+#include "InstanceBuffer.h"
+#include "OBJMesh.h"
+#include <cstdio>
+
+namespace aie {
+
+MeshPool::MeshPool()
+	: m_vao(0),
+	m_vbo(0),
+	m_ibo(0),
+	m_instanceBufferID(0),
+	m_vertexCount(0),
+	m_indexCount(0) {
+}
+
+MeshPool::~MeshPool() {
+	if (m_vao != 0) {
+		GLState::removeVertexArray(m_vao);
+		GLState::removeBuffer(m_vbo);
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ibo);
+	}
+}
+
+bool MeshPool::create(const std::vector<OBJMesh*>& meshes) {
+
+	if (m_vao != 0) {
+		printf("Mesh pool already created!\n");
+		return false;
+	}
+
+	// sized up front so the pool's buffers are only allocated once
+	struct ChunkCopy {
+		unsigned int	vbo, ibo;
+		GLint			vertexBytes;
+		unsigned int	indexCount;
+	};
+	std::vector<ChunkCopy> copies;
+
+	for (auto mesh : meshes) {
+		std::vector<Range>& ranges = m_ranges[mesh];
+		for (size_t i = 0; i < mesh->getChunkCount(); ++i) {
+			const OBJMesh::MeshChunk& chunk = mesh->getChunk(i);
+
+			ChunkCopy copy = { chunk.vbo, chunk.ibo, 0, chunk.indexCount };
+			glBindBuffer(GL_COPY_READ_BUFFER, chunk.vbo);
+			glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &copy.vertexBytes);
+			copies.push_back(copy);
+
+			// chunk indices start at their own first vertex, the base vertex moves them to the pool's
+			ranges.push_back({ (unsigned int)m_indexCount, chunk.indexCount, (int)m_vertexCount });
+			m_vertexCount += copy.vertexBytes / sizeof(OBJMesh::Vertex);
+			m_indexCount += chunk.indexCount;
+		}
+	}
+
+	glGenBuffers(1, &m_vbo);
+	glGenBuffers(1, &m_ibo);
+	glGenVertexArrays(1, &m_vao);
+
+	GLState::bindVertexArray(m_vao);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, m_vertexCount * sizeof(OBJMesh::Vertex), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+	GLintptr vertexOffset = 0;
+	GLintptr indexOffset = 0;
+	for (auto& copy : copies) {
+		glBindBuffer(GL_COPY_READ_BUFFER, copy.vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, vertexOffset, copy.vertexBytes);
+		vertexOffset += copy.vertexBytes;
+
+		GLsizeiptr indexBytes = copy.indexCount * sizeof(unsigned int);
+		glBindBuffer(GL_COPY_READ_BUFFER, copy.ibo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, indexOffset, indexBytes);
+		indexOffset += indexBytes;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	// the same layout as OBJMesh's chunks
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(OBJMesh::Vertex), 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(OBJMesh::Vertex), (void*)(sizeof(glm::vec4) * 1));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(OBJMesh::Vertex), (void*)(sizeof(glm::vec4) * 2));
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(OBJMesh::Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
+
+	// bind 0 for safety
+	GLState::bindVertexArray(0);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	return true;
+}
+
+const std::vector<MeshPool::Range>* MeshPool::getRanges(const OBJMesh* mesh) const {
+	auto iter = m_ranges.find(mesh);
+	return iter != m_ranges.end() ? &iter->second : nullptr;
+}
+
+void MeshPool::bind(const InstanceBuffer& instances) {
+	GLState::bindVertexArray(m_vao);
+
+	// the attributes stay in the vertex array, so they're only set when the buffer changes
+	if (m_instanceBufferID != instances.getID()) {
+		instances.attach();
+		m_instanceBufferID = instances.getID();
+	}
+}
+
+} // namespace aie
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace aie {
+
+class InstanceBuffer;
+class OBJMesh;
+
+// the chunks of many OBJMeshes copied in to one vertex and index buffer behind one vertex
+// array, so draws of different meshes can share a multi-draw call
+class MeshPool {
+public:
+
+	// where a chunk's indices and vertices sit in the pool
+	struct Range {
+		unsigned int	firstIndex;
+		unsigned int	indexCount;
+		int				baseVertex;
+	};
+
+	MeshPool();
+	~MeshPool();
+
+	MeshPool(const MeshPool&) = delete;
+	MeshPool& operator = (const MeshPool&) = delete;
+
+	// copies every chunk of the meshes in to the pool, buffer to buffer on the GPU, so the
+	// meshes' own geometry is left as it was. Will fail if already created
+	bool create(const std::vector<OBJMesh*>& meshes);
+
+	bool isCreated() const { return m_vao != 0; }
+
+	// a mesh's chunk ranges in chunk order, or nullptr if the mesh isn't in the pool
+	const std::vector<Range>* getRanges(const OBJMesh* mesh) const;
+
+	// binds the pool's vertex array with the instance buffer's attributes attached
+	void bind(const InstanceBuffer& instances);
+
+	size_t getVertexCount() const { return m_vertexCount; }
+	size_t getIndexCount() const { return m_indexCount; }
+
+protected:
+
+	unsigned int	m_vao, m_vbo, m_ibo;
+	unsigned int	m_instanceBufferID;
+	size_t			m_vertexCount;
+	size_t			m_indexCount;
+
+	std::unordered_map<const OBJMesh*, std::vector<Range>>	m_ranges;
+};
+
+} // namespace aie
@@ -4,17 +4,46 @@
 #include "Gizmos.h"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <thread>
 #include "Shader.h"
+#include "GLState.h"
+#include "TextureResidency.h"
+#include "FrameData.h"
+#include "ShaderVariants.h"
+#include "ShaderSource.h"
+#include "ShaderBindings.h"
+#include "GPUProfiler.h"
+#include "CPUProfiler.h"
 #include <imgui.h>
 #include <imgui_glfw3.h>
 
+// stb_image_write calls fopen and sprintf, which SDL checks turn in to errors
+#pragma warning(push)
+#pragma warning(disable : 4996)
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+#pragma warning(pop)
+
 using glm::vec3;
 using glm::vec4;
 using glm::mat4;
 
 using namespace aie;
 
+// the object counts the Objects combo offers
+static const unsigned int SCENE_OBJECT_COUNTS[] = { 1, 100, 10000, 100000 };
+
+// texture storage, image copies and indirect multi-draws are GL 4.3, buffer storage is optional
+static const int REQUIRED_GL_MAJOR = 4;
+static const int REQUIRED_GL_MINOR = 3;
+
+// bytes each frame can stream, draws that don't fit fall back to their own buffers
+static const size_t STREAM_FRAME_SIZE = 4 * 1024 * 1024;
+
 // Default constructor initialises time member variables
 MyApplication::MyApplication()
 {
@@ -28,18 +57,163 @@ MyApplication::~MyApplication()
 {
 }
 
+// names the command line accepts for the Current Shader and Current Model combos, as well as their index
+static const char* SHADER_NAMES[] = { "simple", "textured", "phong", "normalmap", "pbr", "mixed" };
+static const char* MODEL_NAMES[] = { "quad", "bunny", "dragon", "buddha", "lucy", "spear", "all" };
+
+// reads a whole decimal number, with nothing after it
+static bool parseUnsigned(const char* text, unsigned int& value)
+{
+	char* end = nullptr;
+	unsigned long parsed = strtoul(text, &end, 10);
+	if (end == text || *end != 0 || text[0] == '-')
+		return false;
+	value = (unsigned int)parsed;
+	return true;
+}
+
+// reads either a name from names or its index
+static bool parseChoice(const char* text, const char* const* names, unsigned int count, int& choice)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (strcmp(text, names[i]) == 0)
+		{
+			choice = (int)i;
+			return true;
+		}
+	}
+
+	unsigned int index = 0;
+	if (parseUnsigned(text, index) == false || index >= count)
+		return false;
+	choice = (int)index;
+	return true;
+}
+
+static void printUsage()
+{
+	printf("Usage: OpenGL [--headless] [options]\n"
+		   "  --headless            draw offscreen for a fixed number of frames, print the timings and exit\n"
+		   "  --egl                 create the context through EGL\n"
+		   "  --shader <name|0-5>   simple, textured, phong, normalmap, pbr or mixed\n"
+		   "  --model <name|0-6>    quad, bunny, dragon, buddha, lucy, spear or all\n"
+		   "  --objects <count>     1, 100, 10000 or 100000\n"
+		   "  --width <pixels>      offscreen target width, 1280 by default\n"
+		   "  --height <pixels>     offscreen target height, 720 by default\n"
+		   "  --frames <count>      frames timed, 300 by default\n"
+		   "  --warmup <count>      frames drawn before timing starts, 10 by default\n"
+		   "  --output <prefix>     write frames to <prefix>_<frame>.png\n"
+		   "  --output-every <n>    write every nth frame, only the last by default\n");
+}
+
+// Reads the headless benchmark options, returns false and prints the usage if any are invalid
+bool MyApplication::parseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (option == "--headless")
+		{
+			m_headless.enabled = true;
+			continue;
+		}
+		if (option == "--egl")
+		{
+			m_headless.egl = true;
+			continue;
+		}
+
+		// every other option takes a value
+		if (i + 1 >= argc)
+		{
+			printf("Missing value for %s\n", option.c_str());
+			printUsage();
+			return false;
+		}
+		const char* value = argv[++i];
+
+		bool valid = true;
+		if (option == "--shader")
+			valid = parseChoice(value, SHADER_NAMES, sizeof(SHADER_NAMES) / sizeof(SHADER_NAMES[0]), imgui_shader);
+		else if (option == "--model")
+			valid = parseChoice(value, MODEL_NAMES, sizeof(MODEL_NAMES) / sizeof(MODEL_NAMES[0]), imgui_model);
+		else if (option == "--objects")
+		{
+			unsigned int count = 0;
+			auto last = std::end(SCENE_OBJECT_COUNTS);
+			auto found = parseUnsigned(value, count) ? std::find(std::begin(SCENE_OBJECT_COUNTS), last, count) : last;
+			valid = found != last;
+			if (valid)
+				imgui_objectCount = (int)(found - std::begin(SCENE_OBJECT_COUNTS));
+		}
+		else if (option == "--width")
+			valid = parseUnsigned(value, m_headless.width) && m_headless.width > 0;
+		else if (option == "--height")
+			valid = parseUnsigned(value, m_headless.height) && m_headless.height > 0;
+		else if (option == "--frames")
+			valid = parseUnsigned(value, m_headless.frameCount) && m_headless.frameCount > 0;
+		else if (option == "--warmup")
+			valid = parseUnsigned(value, m_headless.warmupCount);
+		else if (option == "--output")
+			m_headless.output = value;
+		else if (option == "--output-every")
+			valid = parseUnsigned(value, m_headless.outputInterval);
+		else
+		{
+			printf("Unknown option %s\n", option.c_str());
+			printUsage();
+			return false;
+		}
+
+		if (valid == false)
+		{
+			printf("Invalid value [%s] for %s\n", value, option.c_str());
+			printUsage();
+			return false;
+		}
+	}
+
+	return true;
+}
+
 // Sets up a window, transforms, and lighting. Loads all shaders, textures and meshes. Initialises quads and render target. Creates imgui window. Returns an int determining success
 int MyApplication::startup()
 {
 	if (glfwInit() == false)
 		return -1;
-	m_window = glfwCreateWindow(1280, 720, "OpenGL", nullptr, nullptr);
+
+	// drivers such as Mesa only offer GL 4 through a core profile, and a default context can be
+	// older than startup needs, so one is asked for at the required version
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, REQUIRED_GL_MAJOR);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, REQUIRED_GL_MINOR);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
+	// headless runs keep the window hidden and draw offscreen at the size asked for
+	if (m_headless.enabled)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		if (m_headless.egl)
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+		m_window = glfwCreateWindow(m_headless.width, m_headless.height, "OpenGL", nullptr, nullptr);
+	}
+	else
+		m_window = glfwCreateWindow(1280, 720, "OpenGL", nullptr, nullptr);
 	if (m_window == nullptr) {
+		printf("Unable to create a GL %i.%i core context\n", REQUIRED_GL_MAJOR, REQUIRED_GL_MINOR);
 		glfwTerminate();
 		return -2;
 	}
 	glfwMakeContextCurrent(m_window);
 
+	// vsync until IMGUI picks another pacing mode
+	glfwSwapInterval(1);
+
+	// GL is only ever called from here on, render queue recording threads only touch plain data
+	GLState::setRenderThread();
+	aie::CPUProfiler::setThreadName("Render");
+
 	if (ogl_LoadFunctions() == ogl_LOAD_FAILED) {
 		glfwDestroyWindow(m_window);
 		glfwTerminate();
@@ -52,21 +226,73 @@ int MyApplication::startup()
 	auto minor = ogl_GetMinorVersion();
 	printf("GL: %i.%i\n", major, minor);
 
+	// a backstop for drivers that ignore the hints. Texture storage, image copies and indirect
+	// multi-draws would otherwise be null pointers
+	if (major < REQUIRED_GL_MAJOR ||
+		(major == REQUIRED_GL_MAJOR && minor < REQUIRED_GL_MINOR)) {
+		printf("GL %i.%i or later is required\n", REQUIRED_GL_MAJOR, REQUIRED_GL_MINOR);
+		glfwDestroyWindow(m_window);
+		glfwTerminate();
+		return -4;
+	}
+
 	glClearColor(0.25f, 0.25f, 0.25f, 1);
 	glEnable(GL_DEPTH_TEST); // enables the depth buffer
 
-	aie::Gizmos::create(65336, 65336, 256, 256);
-
 	aie::Input::create();
 
-	// imgui
-	ImGui_Init(m_window, true);
+	// textures unused for two seconds (at 60 fps) can be evicted once over budget
+	TextureResidency::setBudget((size_t)imgui_textureBudget * 1024 * 1024);
+	TextureResidency::setEvictionDelay(120);
+
+	// headless runs only draw the scene
+	if (m_headless.enabled == false)
+	{
+		aie::Gizmos::create(65336, 65336, 256, 256);
+
+		// imgui
+		ImGui_Init(m_window, true);
+
+		// without buffer storage both keep updating their own buffers
+		if (m_streamBuffer.create(STREAM_FRAME_SIZE))
+		{
+			Gizmos::setStreamBuffer(&m_streamBuffer);
+			ImGui_SetStreamBuffer(&m_streamBuffer);
+
+			// Gizmos set up its vertex array through GL directly
+			GLState::invalidate();
+		}
+	}
+
+	// camera and lights are shared by every shader through uniform blocks at fixed binding points
+	ShaderProgram::setUniformBlockBinding("FrameData", FRAME_DATA_BINDING);
+	ShaderProgram::setUniformBlockBinding("LightData", LIGHT_DATA_BINDING);
+	m_frameDataBuffer.create(FRAME_DATA_BINDING, sizeof(FrameData));
+	m_lightDataBuffer.create(LIGHT_DATA_BINDING, sizeof(LightData));
+
+	// linked programs are kept as binaries beside their sources, so warm runs skip compiling
+	ShaderProgram::setBinaryCacheDirectory("./shaders/");
+
+	// time taken to load every asset, warm runs read mip chains from the texture cache
+	double loadStartTime = glfwGetTime();
 
 	loadShaders();	// Loads in the different shaders for use - will display error is issues occur
 
+	// edited shader files are recompiled while the app keeps running
+	m_shaderWatcher.watch(&m_shader);
+	m_shaderWatcher.watch(&m_texturedShader);
+	m_phongVariants.setWatcher(&m_shaderWatcher);
+	m_normalMapVariants.setWatcher(&m_shaderWatcher);
+	m_physicBasedVariants.setWatcher(&m_shaderWatcher);
+
+	// GPU time of each pass, to compare specialised shader variants against generic ones among others
+	m_gpuProfiler.create();
+
 	loadTextures();	// Loads in the different textures for use - will display error is issues occur
 
-	intialiseRenderTarget();	// Initialises the render target for use - will display error is issues occur
+	// headless runs create their own target at the size asked for
+	if (m_headless.enabled == false)
+		intialiseRenderTarget();	// Initialises the render target for use - will display error is issues occur
 
 	m_quadMesh.initialiseQuad();
 
@@ -78,14 +304,24 @@ int MyApplication::startup()
 
 	setUpLighting();	// Creates four light sources and gives them an equal power of 100 and positions them around the mesh position
 
+	setUpMaterials();	// Creates the materials each shader draws with, holding the uniform values and textures shared by its objects
+
+	printf("Startup: %.2f ms\n", (glfwGetTime() - loadStartTime) * 1000.0);
+
 	return 0;
 }
 
 // Destroys imgui window, gizmos and window
 void MyApplication::shutdown()
 {
-	ImGui_Shutdown();
-	Gizmos::destroy();
+	if (m_headless.enabled == false)
+	{
+		ImGui_Shutdown();
+		Gizmos::destroy();
+		m_streamBuffer.destroy();
+	}
+
+	m_gpuProfiler.destroy();
 
 	glfwDestroyWindow(m_window);
 	glfwTerminate();
@@ -94,65 +330,259 @@ void MyApplication::shutdown()
 // Updates everything on screen - returns true for if the user hits escape to exit the application (stops updating)
 bool MyApplication::update()
 {
-	Input::getInstance()->clearStatus();
+	// the frame's zones are added up once it's presented
+	aie::CPUProfiler::beginFrame();
 
-	m_camera.update();
+	{
+		PROFILE_ZONE("Input::clearStatus");
+		Input::getInstance()->clearStatus();
+	}
 
 	updateTime();
 
+	// the camera moves in fixed ticks however long frames take, and is drawn between the last two
+	{
+		PROFILE_ZONE("Camera::update");
+		for (unsigned int tick = 0; tick < m_frameTimer.getTickCount(); ++tick)
+			m_camera.update(m_frameTimer.getTickTime());
+		m_camera.updateLook();
+		m_camera.interpolate(m_frameTimer.getAlpha());
+	}
+
+	// the frame just timed ran with a reload in flight if one is still pending, or finishes now
+	bool reloading = m_shaderWatcher.isReloading();
+	m_shaderWatcher.update();
+	float frameTime = (float)m_deltaTime * 1000.0f;
+	if (reloading || m_shaderWatcher.isReloading())
+		m_reloadFrameTime = glm::max(m_reloadFrameTime, frameTime);
+	else
+		m_averageFrameTime += (frameTime - m_averageFrameTime) * 0.05f;
+
 	// Draw 
 
+	// reads back the passes of a few frames ago and starts timing this one
+	m_gpuProfiler.beginFrame();
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	Gizmos::clear();
-	Gizmos::addTransform(glm::mat4(1));
-	vec4 white(1);
-	vec4 black(0, 0, 0, 1);
+	{
+		PROFILE_ZONE("Gizmos Build");
+		Gizmos::clear();
+		Gizmos::addTransform(glm::mat4(1));
+		vec4 white(1);
+		vec4 black(0, 0, 0, 1);
+
+		// draws grid
+		for (int i = 0; i < 21; ++i)
+		{
+			Gizmos::addLine(vec3(-10 + i, 0, 10), vec3(-10 + i, 0, -10), i == 10 ? white : black);
+			Gizmos::addLine(vec3(10, 0, -10 + i), vec3(-10, 0, -10 + i), i == 10 ? white : black);
+		}
 
-	// draws grid
-	for (int i = 0; i < 21; ++i)
+		// creates the spheres that represent the soure of the lights
+		for (int i = 0; i < m_lightCount; i++)
+		{
+			Gizmos::addSphere(m_pointLightPos[i], 1, 8, 8, vec4(m_lightColors[i], 1));
+		}
+	}
+	
+	// clear imgui
 	{
-		Gizmos::addLine(vec3(-10 + i, 0, 10), vec3(-10 + i, 0, -10), i == 10 ? white : black);
-		Gizmos::addLine(vec3(10, 0, -10 + i), vec3(-10, 0, -10 + i), i == 10 ? white : black);
+		PROFILE_ZONE("IMGUITools");
+		ImGui_NewFrame();
+		//ImGui::ShowTestWindow();
+		IMGUITools();
 	}
 
-	// creates the spheres that represent the soure of the lights
-	for (int i = 0; i < m_lightCount; i++)
 	{
-		Gizmos::addSphere(m_pointLightPos[i], 1, 8, 8, vec4(m_lightColors[i], 1));
+		PROFILE_ZONE("checkIMGUIValues");
+		aie::GPUProfiler::Scope scope(m_gpuProfiler, "Scene");
+		checkIMGUIValues();
 	}
-	
-	// clear imgui
-	ImGui_NewFrame();
-	//ImGui::ShowTestWindow();
-	IMGUITools();		
 
-	checkIMGUIValues();
+	// waits, if at all, for the GPU to finish the frame that last used this region
+	m_streamBuffer.beginFrame();
 
-	Gizmos::draw(m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix());
+	{
+		PROFILE_ZONE("Gizmos::draw");
+		aie::GPUProfiler::Scope scope(m_gpuProfiler, "Gizmos");
+		Gizmos::draw(m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix());
+	}
 
 	// draw IMGUI last
-	ImGui::Render();
+	{
+		PROFILE_ZONE("ImGui::Render");
+		aie::GPUProfiler::Scope scope(m_gpuProfiler, "IMGUI");
+		ImGui::Render();
+	}
+
+	m_streamBuffer.endFrame();
+	m_gpuProfiler.endFrame();
+
+	// Gizmos and IMGUI bind through GL directly, so the state cache can't trust what it last saw
+	GLState::invalidate();
+
+	// held back to the target frame rate's deadline, if there is one, before presenting
+	updatePacing();
+	{
+		PROFILE_ZONE("Pacing Wait");
+		m_frameTimer.waitForDeadline();
+	}
 
 	// So does our render code!
-	glfwSwapBuffers(m_window);
+	{
+		PROFILE_ZONE("Present");
+		glfwSwapBuffers(m_window);
+	}
 	glfwPollEvents();
+
+	TextureResidency::endFrame();
+
+	m_locationQueries = ShaderProgram::getLocationQueryCount();
+	ShaderProgram::resetLocationQueryCount();
+	GLState::endFrame();
+	aie::CPUProfiler::endFrame();
 	
 	return (glfwWindowShouldClose(m_window) == false && glfwGetKey(m_window, GLFW_KEY_ESCAPE) != GLFW_PRESS);
 }
 
+// Draws the scene a fixed number of frames in to an offscreen target, saving them if asked, and prints the frame times. Returns the exit code
+int MyApplication::runHeadless()
+{
+	if (m_headlessTarget.initialise(1, m_headless.width, m_headless.height) == false)
+	{
+		printf("Headless Render Target Error!\n");
+		return -4;
+	}
+
+	// the scene is drawn straight in to the offscreen target, without gizmos or IMGUI
+	imgui_renderTarget = 0;
+
+	printf("Headless: %s shader, %s model, %u objects, %ux%u, %u frames after %u warmup\n",
+		   SHADER_NAMES[imgui_shader], MODEL_NAMES[imgui_model], SCENE_OBJECT_COUNTS[imgui_objectCount],
+		   m_headless.width, m_headless.height, m_headless.frameCount, m_headless.warmupCount);
+
+	std::vector<float> frameTimes;
+	frameTimes.reserve(m_headless.frameCount);
+	double startTime = 0;
+	double saveTime = 0;
+	bool saved = true;
+
+	unsigned int totalFrames = m_headless.warmupCount + m_headless.frameCount;
+	for (unsigned int frame = 0; frame < totalFrames; ++frame)
+	{
+		// timing starts once the warmup frames are done on the GPU too
+		if (frame == m_headless.warmupCount)
+		{
+			glFinish();
+			startTime = glfwGetTime();
+		}
+
+		double frameStart = glfwGetTime();
+		aie::CPUProfiler::beginFrame();
+		m_gpuProfiler.beginFrame();
+		updateTime();
+
+		m_headlessTarget.bind();
+		glViewport(0, 0, m_headless.width, m_headless.height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		{
+			PROFILE_ZONE("checkIMGUIValues");
+			aie::GPUProfiler::Scope scope(m_gpuProfiler, "Scene");
+			checkIMGUIValues();
+		}
+		m_headlessTarget.unbind();
+		m_gpuProfiler.endFrame();
+
+		// nothing is presented, so flushing is what hands each frame to the GPU
+		glFlush();
+
+		if (frame >= m_headless.warmupCount)
+		{
+			frameTimes.push_back((float)((glfwGetTime() - frameStart) * 1000.0));
+
+			// reading a frame back waits for the GPU, so isn't counted in the total
+			unsigned int timedFrame = frame - m_headless.warmupCount;
+			if (m_headless.output.empty() == false &&
+				((m_headless.outputInterval > 0 && timedFrame % m_headless.outputInterval == 0) ||
+				 timedFrame == m_headless.frameCount - 1))
+			{
+				double saveStart = glfwGetTime();
+				char filename[512];
+				snprintf(filename, sizeof(filename), "%s_%04u.png", m_headless.output.c_str(), timedFrame);
+				saved = saveFrame(filename) && saved;
+				saveTime += glfwGetTime() - saveStart;
+			}
+		}
+
+		TextureResidency::endFrame();
+		ShaderProgram::resetLocationQueryCount();
+		GLState::endFrame();
+		aie::CPUProfiler::endFrame();
+		glfwPollEvents();
+	}
+
+	glFinish();
+	double totalTime = (glfwGetTime() - startTime - saveTime) * 1000.0;
+
+	// frame times are the CPU's, the total waits for the GPU to finish the last frame
+	std::vector<float> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&sorted](float p) { return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+	float sum = 0;
+	for (float time : frameTimes)
+		sum += time;
+
+	printf("Total: %.2f ms, %.1f frames per second\n", totalTime, m_headless.frameCount * 1000.0 / totalTime);
+	printf("CPU frame: mean %.3f ms, min %.3f, median %.3f, 95th %.3f, 99th %.3f, max %.3f\n",
+		   sum / frameTimes.size(), sorted.front(), percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back());
+
+	const aie::GPUProfiler::Pass* scenePass = m_gpuProfiler.findPass("Scene");
+	if (scenePass != nullptr)
+		printf("GPU scene: mean %.3f ms, min %.3f, max %.3f over the last %u frames, %u dropped\n",
+			   scenePass->average, scenePass->min, scenePass->max, m_gpuProfiler.getHistoryCount(), m_gpuProfiler.getDroppedCount());
+
+	return saved ? 0 : -5;
+}
+
+// Reads back the offscreen target and writes it as a PNG
+bool MyApplication::saveFrame(const char* filename)
+{
+	unsigned int width = m_headlessTarget.getWidth();
+	unsigned int height = m_headlessTarget.getHeight();
+	std::vector<unsigned char> pixels(width * height * 4);
+
+	m_headlessTarget.bind();
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	m_headlessTarget.unbind();
+
+	// GL's rows start at the bottom, so they're written from the last row up
+	int rowSize = (int)width * 4;
+	if (stbi_write_png(filename, width, height, 4, pixels.data() + (height - 1) * rowSize, -rowSize) == 0)
+	{
+		printf("Failed to write [%s]\n", filename);
+		return false;
+	}
+
+	return true;
+}
+
 // Loads in the different shaders for use - will display error is issues occur
 void MyApplication::loadShaders()
 {
+	// every compile and link is submitted before any status is asked for, so drivers with
+	// parallel shader compile can work on all of them at once
+	ShaderProgram::setMaxCompilerThreads(std::thread::hardware_concurrency());
+	double setupStartTime = glfwGetTime();
+
 	// load vertex simple shader from file
 	m_shader.loadShader(aie::eShaderStage::VERTEX,
 		"./shaders/simple.vert");
 	// load fragment simple shader from file
 	m_shader.loadShader(aie::eShaderStage::FRAGMENT,
 		"./shaders/simple.frag");
-	if (m_shader.link() == false) {
-		printf("Shader Error: %s\n", m_shader.getLastError());
-	}
 
 	// load vertex textured shader from file
 	m_texturedShader.loadShader(aie::eShaderStage::VERTEX,
@@ -160,52 +590,225 @@ void MyApplication::loadShaders()
 	// load fragment textured shader from file
 	m_texturedShader.loadShader(aie::eShaderStage::FRAGMENT,
 		"./shaders/textured.frag");
-	if (m_texturedShader.link() == false) {
-		printf("Shader Error: %s\n", m_texturedShader.getLastError());
-	}
-
-	// load vertex phong shader from file
-	m_phongShader.loadShader(aie::eShaderStage::VERTEX,
-		"./shaders/phong.vert");
-	// load fragment phong shader from file
-	m_phongShader.loadShader(aie::eShaderStage::FRAGMENT,
-		"./shaders/phong.frag");
-	if (m_phongShader.link() == false) {
-		printf("Shader Error: %s\n", m_phongShader.getLastError());
-	}
-
-	// load vertex normal map shader from file
-	m_normalMapShader.loadShader(aie::eShaderStage::VERTEX,
-		"./shaders/normalmap.vert");
-	// load fragment normal map shader from file
-	m_normalMapShader.loadShader(aie::eShaderStage::FRAGMENT,
-		"./shaders/normalmap.frag");
-	if (m_normalMapShader.link() == false) {
-		printf("Shader Error: %s\n", m_normalMapShader.getLastError());
-	}
-
-	// load vertex oren-nayar BRDF shader from file
-	m_physicBasedShadar.loadShader(aie::eShaderStage::VERTEX,
-		"./shaders/physic-based.vert");
-	// load fragment normal map shader from file
-	m_physicBasedShadar.loadShader(aie::eShaderStage::FRAGMENT,
-		"./shaders/physic-based.frag");
-	if (m_physicBasedShadar.link() == false) {
-		printf("Shader Error: %s\n", m_physicBasedShadar.getLastError());
+
+	// phong, normal map and oren-nayar BRDF shaders are built per light count and material
+	// features the first time each combination is drawn
+	m_phongVariants.setStage(aie::eShaderStage::VERTEX, "./shaders/phong.vert");
+	m_phongVariants.setStage(aie::eShaderStage::FRAGMENT, "./shaders/phong.frag");
+
+	m_normalMapVariants.setStage(aie::eShaderStage::VERTEX, "./shaders/normalmap.vert");
+	m_normalMapVariants.setStage(aie::eShaderStage::FRAGMENT, "./shaders/normalmap.frag");
+
+	m_physicBasedVariants.setStage(aie::eShaderStage::VERTEX, "./shaders/physic-based.vert");
+	m_physicBasedVariants.setStage(aie::eShaderStage::FRAGMENT, "./shaders/physic-based.frag");
+
+	// start the variants the scene draws with all lights on, alongside the two plain programs
+	m_phongVariants.prepare(MAX_LIGHTS, 0);
+	m_normalMapVariants.prepare(MAX_LIGHTS, ShaderVariants::DIFFUSE_TEXTURE | ShaderVariants::NORMAL_MAP);
+	m_physicBasedVariants.prepare(MAX_LIGHTS, ShaderVariants::DIFFUSE_TEXTURE);
+
+	ShaderProgram* programs[] = { &m_shader, &m_texturedShader };
+	if (ShaderProgram::linkAll(programs, 2) == false) {
+		for (auto program : programs)
+			if (program->isLinked() == false)
+				printf("Shader Error: %s\n", program->getLastError());
+	}
+
+	// the explicit sync point for the variants, failures are reported by get()
+	m_phongVariants.get(MAX_LIGHTS, 0);
+	m_normalMapVariants.get(MAX_LIGHTS, ShaderVariants::DIFFUSE_TEXTURE | ShaderVariants::NORMAL_MAP);
+	m_physicBasedVariants.get(MAX_LIGHTS, ShaderVariants::DIFFUSE_TEXTURE);
+
+	m_shaderSetupTime = (float)((glfwGetTime() - setupStartTime) * 1000.0);
+	printf("Shader setup: %.2f ms for 5 programs\n", m_shaderSetupTime);
+
+	// variants share their stage files and the lighting includes, so most loads hit the source cache
+	m_shaderLoadTime = ShaderSource::getLoadTime();
+	m_shaderFileReads = ShaderSource::getFileReadCount();
+	m_shaderCacheHits = ShaderSource::getCacheHitCount();
+	printf("Shader sources: %.2f ms loading, %u files read, %u from cache\n", m_shaderLoadTime, m_shaderFileReads, m_shaderCacheHits);
+
+	// the bindings are generated along with the layout qualifiers, so these only fail if a
+	// shader was edited without running the build step
+	shaders::Simple::validate(m_shader);
+	shaders::Textured::validate(m_texturedShader);
+	if (ShaderProgram* phong = m_phongVariants.get(MAX_LIGHTS, 0))
+		shaders::Phong::validate(*phong);
+	if (ShaderProgram* normalMap = m_normalMapVariants.get(MAX_LIGHTS, ShaderVariants::DIFFUSE_TEXTURE | ShaderVariants::NORMAL_MAP))
+		shaders::Normalmap::validate(*normalMap);
+	if (ShaderProgram* physicBased = m_physicBasedVariants.get(MAX_LIGHTS, ShaderVariants::DIFFUSE_TEXTURE))
+		shaders::PhysicBased::validate(*physicBased);
+
+	// cold runs compile every stage, warm runs load the binaries saved by the cold run
+	const char* names[] = { "Simple", "Textured" };
+	for (int i = 0; i < 2; ++i)
+		printf("Shader [%s] linked in %.2f ms (%s)\n", names[i], programs[i]->getLinkTime(),
+			   programs[i]->isFromBinaryCache() ? "binary cache" : "compiled");
+}
+
+// Compiles 100 unique variants of the physics based shader one at a time, as a batch, then as pipelines, and records each time
+void MyApplication::measureShaderStress()
+{
+	const unsigned int variantCount = 100;
+
+	// every variant gets a define no earlier run has used, so neither the binary cache nor
+	// the driver's own shader cache can skip the compile
+	std::string cacheDirectory = ShaderProgram::getBinaryCacheDirectory();
+	ShaderProgram::setBinaryCacheDirectory("");
+	unsigned int seed = (unsigned int)(glfwGetTime() * 1000.0) * 1000;
+
+	for (int batched = 0; batched < 2; ++batched)
+	{
+		std::vector<std::unique_ptr<ShaderProgram>> variants(variantCount);
+		double startTime = glfwGetTime();
+
+		for (unsigned int i = 0; i < variantCount; ++i)
+		{
+			variants[i].reset(new ShaderProgram());
+			variants[i]->setDefines({ "LIGHT_COUNT " + std::to_string(i % (MAX_LIGHTS + 1)),
+									  "HAS_DIFFUSE_TEX",
+									  "STRESS_VARIANT " + std::to_string(seed + batched * variantCount + i) });
+			variants[i]->loadShader(aie::eShaderStage::VERTEX, "./shaders/physic-based.vert");
+			variants[i]->loadShader(aie::eShaderStage::FRAGMENT, "./shaders/physic-based.frag");
+
+			// one at a time waits on each link before submitting the next
+			if (batched == 0)
+				variants[i]->link();
+		}
+
+		if (batched == 1)
+		{
+			std::vector<ShaderProgram*> programs;
+			for (auto& v : variants)
+				programs.push_back(v.get());
+			ShaderProgram::linkAll(programs.data(), programs.size());
+		}
+
+		float time = (float)((glfwGetTime() - startTime) * 1000.0);
+		if (batched == 1)
+			m_stressBatchTime = time;
+		else
+			m_stressSerialTime = time;
+	}
+
+	// as pipelines the vertex stage is compiled once and only the fragment stages are per variant
+	{
+		double startTime = glfwGetTime();
+
+		std::shared_ptr<ShaderProgram> vertex = std::make_shared<ShaderProgram>();
+		vertex->setSeparable(true);
+		vertex->loadShader(aie::eShaderStage::VERTEX, "./shaders/physic-based.vert");
+
+		std::vector<std::unique_ptr<ShaderProgram>> pipelines(variantCount);
+		for (unsigned int i = 0; i < variantCount; ++i)
+		{
+			std::shared_ptr<ShaderProgram> fragment = std::make_shared<ShaderProgram>();
+			fragment->setSeparable(true);
+			fragment->setDefines({ "LIGHT_COUNT " + std::to_string(i % (MAX_LIGHTS + 1)),
+								   "HAS_DIFFUSE_TEX",
+								   "STRESS_VARIANT " + std::to_string(seed + 2 * variantCount + i) });
+			fragment->loadShader(aie::eShaderStage::FRAGMENT, "./shaders/physic-based.frag");
+
+			pipelines[i].reset(new ShaderProgram());
+			pipelines[i]->setPipelineStage(aie::eShaderStage::VERTEX, vertex);
+			pipelines[i]->setPipelineStage(aie::eShaderStage::FRAGMENT, fragment);
+		}
+
+		std::vector<ShaderProgram*> programs;
+		for (auto& p : pipelines)
+			programs.push_back(p.get());
+		ShaderProgram::linkAll(programs.data(), programs.size());
+
+		m_stressPipelineTime = (float)((glfwGetTime() - startTime) * 1000.0);
+	}
+
+	ShaderProgram::setBinaryCacheDirectory(cacheDirectory.c_str());
+	printf("Shader stress: %u variants in %.2f ms one at a time, %.2f ms batched, %.2f ms as pipelines\n", variantCount,
+		   m_stressSerialTime, m_stressBatchTime, m_stressPipelineTime);
+}
+
+// Sets a phong draw's uniforms by name and then through the generated bindings, and records the CPU time per draw of each
+void MyApplication::measureUniformBinding()
+{
+	ShaderProgram* shader = m_phongVariants.get(MAX_LIGHTS, 0);
+	if (shader == nullptr)
+		return;
+	shader->bind();
+
+	const int drawCount = 10000;
+	glm::mat4 pvm(1);
+	glm::mat3 normalMatrix(1);
+
+	// every value differs from the last so none of the calls are skipped as redundant
+	for (int generated = 0; generated < 2; ++generated)
+	{
+		double startTime = glfwGetTime();
+
+		for (int i = 0; i < drawCount; ++i)
+		{
+			pvm[3][0] = normalMatrix[0][0] = (float)(generated * drawCount + i);
+			if (generated == 1)
+			{
+				shaders::Phong::setSpecularPower(*shader, pvm[3][0]);
+				shaders::Phong::setProjectionViewModel(*shader, pvm);
+				shaders::Phong::setNormalMatrix(*shader, normalMatrix);
+			}
+			else
+			{
+				shader->bindUniform("specularPower", pvm[3][0]);
+				shader->bindUniform("ProjectionViewModel", pvm);
+				shader->bindUniform("NormalMatrix", normalMatrix);
+			}
+		}
+
+		float time = (float)((glfwGetTime() - startTime) * 1000000.0 / drawCount);
+		if (generated == 1)
+			m_generatedBindTime = time;
+		else
+			m_namedBindTime = time;
 	}
+
+	printf("Uniforms per draw: %.3f us by name, %.3f us through generated bindings\n", m_namedBindTime, m_generatedBindTime);
+}
+
+// Returns the variant for the current light count, or the generic variant if specialisation is off
+ShaderProgram* MyApplication::selectVariant(ShaderVariants& variants, unsigned int features)
+{
+	unsigned int lightCount = imgui_specialiseShaders == 1 ? (unsigned int)m_lightCount : ShaderVariants::ANY_LIGHT_COUNT;
+	variants.setSeparable(imgui_separablePrograms == 1);
+	return variants.get(lightCount, features);
+}
+
+// Returns the shader features every material of a mesh provides, so one variant can draw the whole mesh
+unsigned int MyApplication::getMeshFeatures(OBJMesh& mesh)
+{
+	if (mesh.getMaterialCount() == 0)
+		return 0;
+
+	unsigned int features = ShaderVariants::DIFFUSE_TEXTURE | ShaderVariants::NORMAL_MAP;
+	for (size_t i = 0; i < mesh.getMaterialCount(); ++i)
+	{
+		// evicted textures keep their size, so test that rather than the handle
+		OBJMesh::Material& material = mesh.getMaterial(i);
+		if (material.diffuseTexture.getWidth() == 0)
+			features &= ~ShaderVariants::DIFFUSE_TEXTURE;
+		if (material.normalTexture.getWidth() == 0)
+			features &= ~ShaderVariants::NORMAL_MAP;
+	}
+	return features;
 }
 
 // Loads in the different textures for use - will display error is issues occur
 bool MyApplication::loadTextures()
 {
 	// Grid texture
-	if (m_gridTexture.load("./textures/numbered_grid.tga") == false) {
+	if (m_gridTexture.load("./textures/numbered_grid.tga", Texture::LOAD_COMPRESSED) == false) {
 		printf("Failed to load texture!\n");
 		return false;
 	}
 
 	// Denim texture
-	if (m_denimTexture.load("./textures/denim-textures-3.jpg") == false) {
+	if (m_denimTexture.load("./textures/denim-textures-3.jpg", Texture::LOAD_COMPRESSED) == false) {
 		printf("Failed to load texture!\n");
 		return false;
 	}
@@ -293,7 +896,7 @@ bool MyApplication::loadStanfordModels()
 
 	// Spear ---------------------------------------
 	if (m_spearMesh.load("./soulspear/soulspear.obj",
-		true, true) == false) {
+		true, true, true) == false) {
 		printf("Soulspear Mesh Error!\n");
 		return false;
 	}
@@ -325,13 +928,27 @@ void MyApplication::setUpLighting()
 	m_lightCount = 4;
 }
 
-// Ensures the current, previous and delta time are updated accordingly
+// Ensures the current, previous and delta time are updated accordingly, and works out the simulation ticks due this frame
 void MyApplication::updateTime()
 {
 	// Update deltaTime
 	m_currTime = glfwGetTime();
 	m_deltaTime = m_currTime - m_prevTime;
 	m_prevTime = m_currTime;
+
+	m_frameTimer.beginFrame();
+}
+
+// Applies the pacing mode, target frame rate and tick rate chosen in IMGUI
+void MyApplication::updatePacing()
+{
+	// the other modes present as soon as a frame is done
+	FrameTimer::PacingMode mode = (FrameTimer::PacingMode)imgui_pacing;
+	if (mode != m_frameTimer.getPacingMode())
+		glfwSwapInterval(mode == FrameTimer::PACING_VSYNC ? 1 : 0);
+
+	m_frameTimer.setPacing(mode, (float)imgui_targetFPS);
+	m_frameTimer.setTickRate((float)imgui_tickRate);
 }
 
 // Checks for changes made by the user on the imGui tool and runs which demonstration the user has selected
@@ -339,115 +956,22 @@ void MyApplication::checkIMGUIValues()
 {
 	updateLighting();
 
-	switch (imgui_shader)
+	updateUniformBuffers();
+
+	// the scene is only rebuilt when what it shows changes
+	if (imgui_shader != m_sceneShader ||
+		imgui_model != m_sceneModel ||
+		imgui_objectCount != m_sceneObjectCount ||
+		imgui_instanced != m_sceneInstanced)
 	{
-	case 0:	// If simple
-		switch (imgui_model)
-		{
-		case 0:	// If quad
-			simpleShaderQuad();
-			break;
-		case 1:	// If bunny
-			simpleShaderBunny();
-			break;
-		case 2:	// If dragon
-			simpleShaderDragon();
-			break;
-		case 3:	// If buddha
-			simpleShaderBuddha();
-			break;
-		case 4:	// If lucy
-			simpleShaderLucy();
-			break;
-		case 5:	// If spear
-			simpleShaderSpear();
-			break;
-		}
-		break;
-	case 1: // If textured
-		switch (imgui_model)
-		{
-		case 0:	// If quad
-			texturedShaderQuad();
-			break;
-		case 1:	// If bunny
-			break;
-		case 2:	// If dragon
-			break;
-		case 3:	// If buddha
-			break;
-		case 4:	// If lucy
-			break;
-		case 5:	// If spear
-			texturedShaderSpear();
-			break;
-		}
-		break;
-	case 2: // If phong
-		switch (imgui_model)
-		{
-		case 0:	// If quad
-			phongShaderQuad();
-			break;
-		case 1:	// If bunny
-			phongShaderBunny();
-			break;
-		case 2:	// If dragon
-			phongShaderDragon();
-			break;
-		case 3:	// If buddha
-			phongShaderBuddha();
-			break;
-		case 4:	// If lucy
-			phongShaderLucy();
-			break;
-		case 5:	// If spear
-			phongShaderSpear();
-			break;
-		}
-		break;
-	case 3: // If normal map
-		switch (imgui_model)
-		{
-		case 0:	// If quad
-			break;
-		case 1:	// If bunny
-			break;
-		case 2:	// If dragon
-			break;
-		case 3:	// If buddha
-			break;
-		case 4:	// If lucy
-			break;
-		case 5:	// If spear
-			normalMapShaderSpear();
-			break;
-		}
-		break;
-	case 4: // If physics based
-		switch (imgui_model)
-		{
-		case 0:	// If quad
-			physicsBasedShaderQuad();
-			break;
-		case 1:	// If bunny
-			physicsBasedShaderBunny();
-			break;
-		case 2:	// If dragon
-			physicsBasedShaderDragon();
-			break;
-		case 3:	// If buddha
-			physicsBasedShaderBuddha();
-			break;
-		case 4:	// If lucy
-			physicsBasedShaderLucy();
-			break;
-		case 5:	// If spear
-			physicsBasedShaderSpear();
-			break;
-		}
-		break;
+		m_sceneShader = imgui_shader;
+		m_sceneModel = imgui_model;
+		m_sceneObjectCount = imgui_objectCount;
+		m_sceneInstanced = imgui_instanced;
+		buildScene(SCENE_OBJECT_COUNTS[imgui_objectCount], (SceneBatching)imgui_instanced);
 	}
+
+	drawScene();
 }
 
 // Checks for changes made by the user on the imGui tool and changes color of lights to user's choice
@@ -516,582 +1040,687 @@ void MyApplication::updateLighting()
 		m_lightColors[3] = vec3(1, 0, 1);		// Purple
 }
 
-// Draws a quad using the simple shader (checks if render target is on and applies accordingly)
-void MyApplication::simpleShaderQuad()
+// Writes the camera and lights in to the uniform buffers shared by every shader, once per frame
+void MyApplication::updateUniformBuffers()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
-
-	// Bind shader
-	m_shader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_quadTransform;
-	m_shader.bindUniform("ProjectionViewModel", pvm);
-	// Draw quad
-	m_quadMesh.draw();
-
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	FrameData frame;
+	frame.view = m_camera.GetViewMatrix();
+	frame.projection = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight());
+	frame.projectionView = frame.projection * frame.view;
+	frame.cameraPosition = vec3(glm::inverse(frame.view)[3]);
+	frame.time = (float)m_currTime;
+	m_frameDataBuffer.update(frame);
+
+	LightData lights;
+	lights.ambient = m_ambientLight;
+	lights.lightCount = m_lightCount;
+	for (unsigned int i = 0; i < MAX_LIGHTS; ++i)
+	{
+		lights.positions[i] = vec4(m_pointLightPos[i], 1);
+		lights.colours[i] = vec4(m_lightColors[i], 0);
+		lights.power[i] = vec4(m_lightPower[i], 0, 0, 0);
+	}
+	m_lightDataBuffer.update(lights);
 }
 
-// Draws a bunny using the simple shader (checks if render target is on and applies accordingly)
-void MyApplication::simpleShaderBunny()
+// Creates the materials each shader draws with, holding the uniform values and textures shared by its objects
+void MyApplication::setUpMaterials()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	m_gridMaterial.texture = &m_gridTexture;
+	m_gridMaterial.textureUnit = shaders::Textured::Binding::diffuseTexture;
 
-	// Bind shader
-	m_shader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_bunnyTransform;
-	m_shader.bindUniform("ProjectionViewModel", pvm);
-	// Draw bunny
-	m_bunnyMesh.draw();
+	m_phongMaterial.values = { { shaders::Phong::Location::specularPower, 0.5f } };
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	m_normalMapMaterial.values = { { shaders::Normalmap::Location::specularPower, 0.5f } };
+
+	// the spear brings its own textures, everything else is drawn in denim
+	m_physicBasedMaterial.values = {
+		{ shaders::PhysicBased::Location::Roughness, 0.05f },
+		{ shaders::PhysicBased::Location::ReflectionCoefficient, 0.5f } };
+	m_denimMaterial.values = m_physicBasedMaterial.values;
+	m_denimMaterial.texture = &m_denimTexture;
+	m_denimMaterial.textureUnit = shaders::PhysicBased::Binding::diffuseTex;
 }
 
-// Draws a dragon using the simple shader (checks if render target is on and applies accordingly)
-void MyApplication::simpleShaderDragon()
+// Describes how a shader draws a model, by their IMGUI indices. Returns false for pairs that can't be drawn
+bool MyApplication::getSceneObject(int shader, int model, SceneObject& object)
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
-
-	// Bind shader
-	m_shader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_dragonTransform;
-	m_shader.bindUniform("ProjectionViewModel", pvm);
-	// Draw dragon
-	m_dragonMesh.draw();
+	// the textured shader needs texture coordinates, which only the quad and spear have, and the
+	// normal map shader needs the spear's tangents and normal map
+	if ((shader == 1 && model != 0 && model != 5) ||
+		(shader == 3 && model != 5))
+		return false;
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	aie::OBJMesh* meshes[] = { nullptr, &m_bunnyMesh, &m_dragonMesh, &m_buddhaMesh, &m_lucyMesh, &m_spearMesh };
+	const mat4* transforms[] = { &m_quadTransform, &m_bunnyTransform, &m_dragonTransform, &m_buddhaTransform, &m_lucyTransform, &m_spearTransform };
 
-// Draws a buddha using the simple shader (checks if render target is on and applies accordingly)
-void MyApplication::simpleShaderBuddha()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	object = SceneObject();
+	object.renderable.mesh = model == 0 ? &m_quadMesh : nullptr;
+	object.renderable.objMesh = meshes[model];
+	object.renderable.transform = *transforms[model];
 
-	// Bind shader
-	m_shader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_buddhaTransform;
-	m_shader.bindUniform("ProjectionViewModel", pvm);
-	// Draw buddha
-	m_buddhaMesh.draw();
+	// variants are picked by the features the mesh's materials provide
+	unsigned int meshFeatures = meshes[model] != nullptr ? getMeshFeatures(*meshes[model]) : 0;
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	switch (shader)
+	{
+	case 0:	// simple
+		object.program = &m_shader;
+		break;
+	case 1:	// textured, the spear binds its own textures
+		object.program = &m_texturedShader;
+		object.renderable.material = model == 0 ? &m_gridMaterial : nullptr;
+		break;
+	case 2:	// phong
+		object.variants = &m_phongVariants;
+		object.features = meshFeatures;
+		object.renderable.material = &m_phongMaterial;
+		break;
+	case 3:	// normal map
+		object.variants = &m_normalMapVariants;
+		object.features = meshFeatures;
+		object.renderable.material = &m_normalMapMaterial;
+		break;
+	case 4:	// physics based
+		object.variants = &m_physicBasedVariants;
+		object.features = model == 5 ? meshFeatures : ShaderVariants::DIFFUSE_TEXTURE;
+		object.renderable.material = model == 5 ? &m_physicBasedMaterial : &m_denimMaterial;
+		break;
+	default:
+		return false;
+	}
+	return true;
 }
 
-// Draws a lucy using the simple shader (checks if render target is on and applies accordingly)
-void MyApplication::simpleShaderLucy()
+// Fills the scene with count objects, laid out in a grid, for the selected shader and model, grouped in to draws by batching
+void MyApplication::buildScene(unsigned int count, SceneBatching batching)
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	PROFILE_ZONE("buildScene");
+
+	const int shaderCount = 5;
+	const int modelCount = 6;
+
+	// the render queue's handles point at the buffers and batches freed here, the scene's
+	// objects look theirs up again in setUpSceneRecording
+	m_renderQueue.resetHandles();
+	m_sceneObjects.clear();
+	m_instanceBuffers.clear();
+	m_indirectBatches.clear();
+	m_culler.clear();
+	m_boundTransforms.clear();
+	m_boundObjects.clear();
+
+	unsigned int side = (unsigned int)glm::ceil(glm::sqrt((float)count));
+	float spacing = imgui_model == 0 ? 10.0f : 3.0f;
+
+	m_sceneObjects.reserve(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		// mixed gives each object the next shader that can draw the model
+		SceneObject object;
+		bool drawable = false;
+		// all cycles through the stanford models and the spear
+		int model = imgui_model < modelCount ? imgui_model : 1 + (int)i % (modelCount - 1);
+		for (int attempt = 0; attempt < shaderCount && drawable == false; ++attempt)
+		{
+			int shader = imgui_shader < shaderCount ? imgui_shader : (int)(i + attempt) % shaderCount;
+			drawable = getSceneObject(shader, model, object);
+		}
+		if (drawable == false)
+			continue;
 
-	// Bind shader
-	m_shader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_lucyTransform;
-	m_shader.bindUniform("ProjectionViewModel", pvm);
-	// Draw lucy
-	m_lucyMesh.draw();
+		// a single object stays at the origin
+		vec3 offset((float)(i % side) - (side - 1) * 0.5f, 0, (float)(i / side) - (side - 1) * 0.5f);
+		object.renderable.transform = glm::translate(mat4(1), offset * spacing) * object.renderable.transform;
+		m_sceneObjects.push_back(object);
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	// the pool copies every model's geometry once, the first time it's needed
+	if (batching == BATCH_INDIRECT &&
+		m_meshPool.isCreated() == false &&
+		m_meshPool.create({ &m_bunnyMesh, &m_dragonMesh, &m_buddhaMesh, &m_lucyMesh, &m_spearMesh }) == false)
+		batching = BATCH_INSTANCED;
 
-// Draws a spear using the simple shader (checks if render target is on and applies accordingly)
-void MyApplication::simpleShaderSpear()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	if (batching == BATCH_NONE)
+	{
+		for (auto& object : m_sceneObjects)
+			addSceneBounds(object, &object.renderable.transform, 1);
+		setUpSceneRecording();
+		return;
+	}
 
-	// Bind shader
-	m_shader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_spearTransform;
-	m_shader.bindUniform("ProjectionViewModel", pvm);
-	// Draw spear
-	m_spearMesh.draw();
+	if (batching == BATCH_INDIRECT)
+	{
+		buildIndirectBatches();
+		setUpSceneRecording();
+		return;
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	// fixed programs have no instanced variant so still draw one at a time, every other object
+	// joins the group drawn with the same variant, mesh and material
+	std::vector<SceneObject> objects;
+	objects.swap(m_sceneObjects);
+	std::vector<SceneObject> groups;
+	std::vector<std::vector<mat4>> groupTransforms;
 
-// Draws a quad using the textured shader (checks if render target is on and applies accordingly)
-void MyApplication::texturedShaderQuad()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	for (auto& object : objects)
+	{
+		if (object.variants == nullptr)
+		{
+			m_sceneObjects.push_back(object);
+			addSceneBounds(m_sceneObjects.back(), &object.renderable.transform, 1);
+			continue;
+		}
 
-	// Bind shader
-	m_texturedShader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_quadTransform;
-	m_texturedShader.bindUniform("ProjectionViewModel", pvm);
-	// Bind texture location
-	m_texturedShader.bindUniform("diffuseTexture", 0);
-	// Bind texture to specified location
-	m_gridTexture.bind(0);
-	// Draw quad
-	m_quadMesh.draw();
+		size_t group = 0;
+		while (group < groups.size() &&
+			   (groups[group].variants != object.variants ||
+				groups[group].features != object.features ||
+				groups[group].renderable.mesh != object.renderable.mesh ||
+				groups[group].renderable.objMesh != object.renderable.objMesh ||
+				groups[group].renderable.material != object.renderable.material))
+			++group;
+		if (group == groups.size())
+		{
+			groups.push_back(object);
+			groupTransforms.emplace_back();
+		}
+		groupTransforms[group].push_back(object.renderable.transform);
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	// the grid is centred on the origin, which places each group for depth sorting
+	for (size_t group = 0; group < groups.size(); ++group)
+	{
+		m_instanceBuffers.emplace_back(new InstanceBuffer());
+		m_instanceBuffers.back()->update(groupTransforms[group].data(), groupTransforms[group].size());
+
+		SceneObject object = groups[group];
+		object.features |= ShaderVariants::INSTANCED;
+		object.renderable.instances = m_instanceBuffers.back().get();
+		object.renderable.transform = mat4(1);
+		object.instanceBuffer = (int)m_instanceBuffers.size() - 1;
+		m_sceneObjects.push_back(object);
+		addSceneBounds(m_sceneObjects.back(), groupTransforms[group].data(), groupTransforms[group].size());
+	}
+	setUpSceneRecording();
 }
 
-// Draws a spear using the textured shader (checks if render target is on and applies accordingly)
-void MyApplication::texturedShaderSpear()
+// Adds a bounding sphere to the culler for each of an object's transforms, one per instance for instanced objects
+void MyApplication::addSceneBounds(SceneObject& object, const mat4* transforms, size_t count)
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
-
-	// Bind shader
-	m_texturedShader.bind();
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_spearTransform;
-	m_texturedShader.bindUniform("ProjectionViewModel", pvm);
-	// Draw mesh
-	m_spearMesh.draw();
-
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	const Renderable& renderable = object.renderable;
+	vec3 centre = renderable.mesh != nullptr ? renderable.mesh->getBoundsCentre() : renderable.objMesh->getBoundsCentre();
+	float radius = renderable.mesh != nullptr ? renderable.mesh->getBoundsRadius() : renderable.objMesh->getBoundsRadius();
+
+	object.firstBound = (unsigned int)m_culler.getCount();
+	object.boundCount = (unsigned int)count;
+	unsigned int objectIndex = (unsigned int)(&object - m_sceneObjects.data());
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_culler.add(transforms[i], centre, radius);
+		m_boundTransforms.push_back(transforms[i]);
+		m_boundObjects.push_back(objectIndex);
+	}
 }
 
-// Draws a quad using the phong shader (checks if render target is on and applies accordingly)
-void MyApplication::phongShaderQuad()
+// Groups the scene objects in to multi-draw batches by variant and material, a draw per mesh chunk. Objects with no variant or pooled mesh still draw one at a time
+void MyApplication::buildIndirectBatches()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
-
-	// bind phong shader program
-	m_phongShader.bind();
-	// bind light
-	m_phongShader.bindUniform("Ia", m_ambientLight);
+	struct BatchDraw
+	{
+		const OBJMesh*	mesh;
+		MeshPool::Range	range;
+		mat4			transform;
+	};
 
-	m_phongShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_phongShader.bindUniform("m_lightCount", m_lightCount);
-	m_phongShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_phongShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_phongShader.bindUniform("specularPower", 0.5f);
+	// chunks without a material share a batch whatever mesh they're from
+	struct Batch
+	{
+		SceneObject				object;
+		const OBJMesh*			materialMesh;
+		int						materialID;
+		std::vector<BatchDraw>	draws;
+	};
 
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_quadTransform;
-	m_phongShader.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_quadTransform)));
-	m_phongShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw quad
-	m_quadMesh.draw();
+	std::vector<SceneObject> objects;
+	objects.swap(m_sceneObjects);
+	std::vector<Batch> batches;
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	for (auto& object : objects)
+	{
+		OBJMesh* mesh = object.renderable.objMesh;
+		const std::vector<MeshPool::Range>* ranges = mesh != nullptr ? m_meshPool.getRanges(mesh) : nullptr;
+		if (object.variants == nullptr ||
+			ranges == nullptr)
+		{
+			m_sceneObjects.push_back(object);
+			addSceneBounds(m_sceneObjects.back(), &object.renderable.transform, 1);
+			continue;
+		}
 
-// Draws a bunny using the phong shader (checks if render target is on and applies accordingly)
-void MyApplication::phongShaderBunny()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+		for (size_t chunk = 0; chunk < ranges->size(); ++chunk)
+		{
+			int materialID = mesh->getChunk(chunk).materialID;
+			const OBJMesh* materialMesh = materialID >= 0 ? mesh : nullptr;
+
+			size_t batch = 0;
+			while (batch < batches.size() &&
+				   (batches[batch].object.variants != object.variants ||
+					batches[batch].object.features != object.features ||
+					batches[batch].object.renderable.material != object.renderable.material ||
+					batches[batch].materialMesh != materialMesh ||
+					batches[batch].materialID != materialID))
+				++batch;
+			if (batch == batches.size())
+			{
+				batches.emplace_back();
+				batches.back().object = object;
+				batches.back().materialMesh = materialMesh;
+				batches.back().materialID = materialID;
+			}
+			batches[batch].draws.push_back({ mesh, (*ranges)[chunk], object.renderable.transform });
+		}
+	}
 
-	// bind phong shader program
-	m_phongShader.bind();
-	// bind light
-	m_phongShader.bindUniform("Ia", m_ambientLight);
-
-	m_phongShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_phongShader.bindUniform("m_lightCount", m_lightCount);
-	m_phongShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_phongShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_phongShader.bindUniform("specularPower", 0.5f);
-
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_bunnyTransform;
-	m_phongShader.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_bunnyTransform)));
-	m_phongShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw bunny
-	m_bunnyMesh.draw();
+	// without the split by material there'd be a batch per variant, features and render material
+	std::vector<const Batch*> unsplit;
+	for (auto& batch : batches)
+	{
+		auto same = std::find_if(unsplit.begin(), unsplit.end(), [&batch](const Batch* other)
+		{
+			return other->object.variants == batch.object.variants &&
+				other->object.features == batch.object.features &&
+				other->object.renderable.material == batch.object.renderable.material;
+		});
+		if (same == unsplit.end())
+			unsplit.push_back(&batch);
+	}
+	m_indirectBatchCount = (unsigned int)batches.size();
+	m_indirectMaterialBatches = (unsigned int)(batches.size() - unsplit.size());
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	for (auto& batch : batches)
+	{
+		m_indirectBatches.emplace_back(new IndirectBatch(m_meshPool));
+		IndirectBatch& indirect = *m_indirectBatches.back();
+		indirect.setMaterial(batch.object.renderable.objMesh, batch.materialID);
+
+		// placed at the origin for depth sorting like the instanced groups
+		SceneObject object = batch.object;
+		object.features |= ShaderVariants::INSTANCED;
+		object.renderable.objMesh = nullptr;
+		object.renderable.batch = &indirect;
+		object.renderable.transform = mat4(1);
+		object.batch = (int)m_indirectBatches.size() - 1;
+		object.firstBound = (unsigned int)m_culler.getCount();
+		object.boundCount = (unsigned int)batch.draws.size();
+		unsigned int objectIndex = (unsigned int)m_sceneObjects.size();
+		m_sceneObjects.push_back(object);
+
+		// a bound per draw in draw order, so a visible bound's draw is its offset from the first
+		for (auto& draw : batch.draws)
+		{
+			indirect.add(draw.range, draw.transform);
+			m_culler.add(draw.transform, draw.mesh->getBoundsCentre(), draw.mesh->getBoundsRadius());
+			m_boundTransforms.push_back(draw.transform);
+			m_boundObjects.push_back(objectIndex);
+		}
+	}
 }
 
-// Draws a dragon using the phong shader (checks if render target is on and applies accordingly)
-void MyApplication::phongShaderDragon()
+// Gives each scene object its render queue handles and pipeline, which recording threads draw it with
+void MyApplication::setUpSceneRecording()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	m_scenePipelines.clear();
+	m_instancedObjects.clear();
 
-	// bind phong shader program
-	m_phongShader.bind();
-	// bind light
-	m_phongShader.bindUniform("Ia", m_ambientLight);
-
-	m_phongShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_phongShader.bindUniform("m_lightCount", m_lightCount);
-	m_phongShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_phongShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_phongShader.bindUniform("specularPower", 0.5f);
-
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_dragonTransform;
-	m_phongShader.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_dragonTransform)));
-	m_phongShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw dragon
-	m_dragonMesh.draw();
+	for (unsigned int i = 0; i < m_sceneObjects.size(); ++i)
+	{
+		SceneObject& object = m_sceneObjects[i];
+		const Renderable& renderable = object.renderable;
+		object.material = m_renderQueue.getMaterialHandle(renderable.material);
+		object.mesh = renderable.mesh != nullptr ? m_renderQueue.getMeshHandle(renderable.mesh) :
+			renderable.batch != nullptr ? m_renderQueue.getMeshHandle(renderable.batch) : m_renderQueue.getMeshHandle(renderable.objMesh);
+
+		// only a handful of pipelines are ever in one scene
+		size_t pipeline = 0;
+		while (pipeline < m_scenePipelines.size() &&
+			   (m_scenePipelines[pipeline].program != object.program ||
+				m_scenePipelines[pipeline].variants != object.variants ||
+				m_scenePipelines[pipeline].features != object.features))
+			++pipeline;
+		if (pipeline == m_scenePipelines.size())
+		{
+			ScenePipeline scenePipeline;
+			scenePipeline.program = object.program;
+			scenePipeline.variants = object.variants;
+			scenePipeline.features = object.features;
+			m_scenePipelines.push_back(scenePipeline);
+		}
+		object.pipeline = (unsigned int)pipeline;
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+		if (object.instanceBuffer >= 0 ||
+			object.batch >= 0)
+			m_instancedObjects.push_back(i);
+	}
 }
 
-// Draws a buddha using the phong shader (checks if render target is on and applies accordingly)
-void MyApplication::phongShaderBuddha()
+// Submits every scene object to the render queue with the program its pipeline picks, then sorts and draws them
+void MyApplication::drawScene()
 {
+	PROFILE_ZONE("drawScene");
+
 	if (imgui_renderTarget == 1)
 		renderTargetStart();
 
-	// bind phong shader program
-	m_phongShader.bind();
-	// bind light
-	m_phongShader.bindUniform("Ia", m_ambientLight);
-	
-	m_phongShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_phongShader.bindUniform("m_lightCount", m_lightCount);
-	m_phongShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_phongShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_phongShader.bindUniform("specularPower", 0.5f);
-	
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_buddhaTransform;
-	m_phongShader.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_buddhaTransform)));
-	m_phongShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw buddha
-	m_buddhaMesh.draw();
+	mat4 view = m_camera.GetViewMatrix();
+	mat4 projection = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight());
+	m_renderQueue.begin(view, projection);
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	// the visible list comes back in bound order, which is scene object order
+	bool culling = imgui_culling != 0;
+	if (culling)
+		m_culler.cull(projection * view, m_visibleBounds, (FrustumCuller::Method)(imgui_culling - 1));
 
-// Draws a lucy using the phong shader (checks if render target is on and applies accordingly)
-void MyApplication::phongShaderLucy()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	// variants are picked, and compiled the first time, here on the render thread
+	for (auto& pipeline : m_scenePipelines)
+	{
+		pipeline.resolved = pipeline.variants != nullptr ? selectVariant(*pipeline.variants, pipeline.features) : pipeline.program;
 
-	// bind phong shader program
-	m_phongShader.bind();
-	// bind light
-	m_phongShader.bindUniform("Ia", m_ambientLight);
-
-	m_phongShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_phongShader.bindUniform("m_lightCount", m_lightCount);
-	m_phongShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_phongShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_phongShader.bindUniform("specularPower", 0.5f);
-
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_lucyTransform;
-	m_phongShader.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_lucyTransform)));
-	m_phongShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw lucy
-	m_lucyMesh.draw();
+		// variants that failed to compile are skipped, as the draw functions did
+		pipeline.handle = pipeline.resolved != nullptr ? m_renderQueue.getProgramHandle(pipeline.resolved) : ProgramHandle();
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	// instance buffers and batches are filled here too, with only the visible instances or draws when culling
+	for (unsigned int index : m_instancedObjects)
+	{
+		SceneObject& object = m_sceneObjects[index];
+		auto first = m_visibleBounds.end();
+		auto last = m_visibleBounds.end();
+		if (culling)
+		{
+			first = std::lower_bound(m_visibleBounds.begin(), m_visibleBounds.end(), object.firstBound);
+			last = std::lower_bound(first, m_visibleBounds.end(), object.firstBound + object.boundCount);
+			if (first == last)
+				continue;
+		}
 
-// Draws a spear using the phong shader (checks if render target is on and applies accordingly)
-void MyApplication::phongShaderSpear()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+		if (object.batch >= 0)
+		{
+			IndirectBatch& batch = *m_indirectBatches[object.batch];
+			if (culling)
+			{
+				m_visibleDraws.clear();
+				for (auto bound = first; bound != last; ++bound)
+					m_visibleDraws.push_back(*bound - object.firstBound);
+				batch.upload(m_visibleDraws.data(), m_visibleDraws.size());
+			}
+			else if (batch.getUploadedCount() != batch.getDrawCount())
+				batch.upload();
+		}
+		else
+		{
+			InstanceBuffer& instances = *m_instanceBuffers[object.instanceBuffer];
+			if (culling)
+			{
+				m_visibleTransforms.clear();
+				for (auto bound = first; bound != last; ++bound)
+					m_visibleTransforms.push_back(m_boundTransforms[*bound]);
+				instances.update(m_visibleTransforms.data(), m_visibleTransforms.size());
+			}
+			else if (instances.getCount() != object.boundCount)
+				instances.update(&m_boundTransforms[object.firstBound], object.boundCount);
+		}
 
-	// bind phong shader program
-	m_phongShader.bind();
-	// bind light
-	m_phongShader.bindUniform("Ia", m_ambientLight);
-
-	m_phongShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_phongShader.bindUniform("m_lightCount", m_lightCount);
-	m_phongShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_phongShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_phongShader.bindUniform("specularPower", 0.5f);
-
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_spearTransform;
-	m_phongShader.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_phongShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_spearTransform)));
-	m_phongShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw spear
-	m_spearMesh.draw();
+		if (m_scenePipelines[object.pipeline].resolved != nullptr)
+			m_renderQueue.submit(object.renderable, m_scenePipelines[object.pipeline].resolved);
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	// every other object is recorded across threads, from handles and transforms alone
+	const SceneObject* objects = m_sceneObjects.data();
+	const ScenePipeline* pipelines = m_scenePipelines.data();
+	const unsigned int* boundObjects = m_boundObjects.data();
+	const unsigned int* visible = culling ? m_visibleBounds.data() : nullptr;
+	unsigned int count = culling ? (unsigned int)m_visibleBounds.size() : (unsigned int)m_boundObjects.size();
 
-// Draws a spear using the normal map shader (checks if render target is on and applies accordingly)
-void MyApplication::normalMapShaderSpear()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	m_renderQueue.record(count, [objects, pipelines, boundObjects, visible](CommandList& list, unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			const SceneObject& object = objects[boundObjects[visible != nullptr ? visible[i] : i]];
+			const ScenePipeline& pipeline = pipelines[object.pipeline];
+			if (object.instanceBuffer < 0 &&
+				object.batch < 0 &&
+				pipeline.handle.isValid())
+				list.draw(pipeline.handle, object.material, object.mesh, object.renderable.transform, object.renderable.pass);
+		}
+	}, (unsigned int)imgui_recordThreads);
 
-	// Bind shader
-	m_normalMapShader.bind();
-	// Bind light 
-	m_normalMapShader.bindUniform("Ia", m_ambientLight);
-	m_normalMapShader.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_normalMapShader.bindUniform("m_lightCount", m_lightCount);
-	m_normalMapShader.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_normalMapShader.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	m_normalMapShader.bindUniform("specularPower", 0.5f);
-	// Bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_spearTransform;
-	m_normalMapShader.bindUniform("ProjectionViewModel", pvm);
-	m_normalMapShader.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_spearTransform)));
-	// Bind camera
-	m_normalMapShader.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// Draw spear
-	m_spearMesh.draw();
+	m_renderQueue.execute();
 
 	if (imgui_renderTarget == 1)
 		renderTargetEnd();
 }
 
-// Draws a quad using the physicsBased shader (checks if render target is on and applies accordingly)
-void MyApplication::physicsBasedShaderQuad()
+// Draws the scene at 1, 100 and 10,000 objects and records the state changes and CPU time per frame of each
+void MyApplication::measureRenderQueue()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	const int frameCount = 10;
 
-	// Bind Oren-Nayar BDRF shader program
-	m_physicBasedShadar.bind();
-	// bind light
-	m_physicBasedShadar.bindUniform("Ia", m_ambientLight);
-
-	m_physicBasedShadar.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_physicBasedShadar.bindUniform("m_lightCount", m_lightCount);
-	m_physicBasedShadar.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_physicBasedShadar.bindUniform("m_lightPower", 4, &m_lightPower[0]);
+	for (int i = 0; i < 3; ++i)
+	{
+		buildScene(SCENE_OBJECT_COUNTS[i], BATCH_NONE);
 
-	m_physicBasedShadar.bindUniform("Roughness", 0.05f);
-	m_physicBasedShadar.bindUniform("ReflectionCoefficient", 0.5f);
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_quadTransform;
-	m_physicBasedShadar.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_physicBasedShadar.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_quadTransform)));
-	// Bind camera
-	m_physicBasedShadar.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
+		// the first frame compiles any variants the scene hadn't used yet
+		drawScene();
 
-	m_physicBasedShadar.bindUniform("diffuseTex", 0);
-	// Bind texture to specified location
-	m_denimTexture.bind(0);
+		double startTime = glfwGetTime();
+		for (int frame = 0; frame < frameCount; ++frame)
+			drawScene();
+		m_queueFrameTimes[i] = (float)((glfwGetTime() - startTime) * 1000.0 / frameCount);
+		m_queueStats[i] = m_renderQueue.getStats();
 
-	// Draw quad
-	m_quadMesh.draw();
+		printf("Render queue, %zu objects: %.3f ms per frame, %u program, %u material and %u mesh changes\n",
+			   m_sceneObjects.size(), m_queueFrameTimes[i], m_queueStats[i].programChanges,
+			   m_queueStats[i].materialChanges, m_queueStats[i].meshChanges);
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	// rebuilt for the current selections next frame
+	m_sceneShader = -1;
 }
 
-// Draws a bunny using the physicsBased shader (checks if render target is on and applies accordingly)
-void MyApplication::physicsBasedShaderBunny()
+// Draws 1,000, 10,000 and 100,000 objects recorded on 1 thread up to one per core, and records the CPU time per frame of each
+void MyApplication::measureCommandRecording()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	const int frameCount = 10;
 
-	// Bind Oren-Nayar BDRF shader program
-	m_physicBasedShadar.bind();
-	// bind light
-	m_physicBasedShadar.bindUniform("Ia", m_ambientLight);
-
-	m_physicBasedShadar.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_physicBasedShadar.bindUniform("m_lightCount", m_lightCount);
-	m_physicBasedShadar.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_physicBasedShadar.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-
-	m_physicBasedShadar.bindUniform("Roughness", 0.05f);
-	m_physicBasedShadar.bindUniform("ReflectionCoefficient", 0.5f);
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_bunnyTransform;
-	m_physicBasedShadar.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_physicBasedShadar.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_bunnyTransform)));
-	// Bind camera
-	m_physicBasedShadar.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-
-	m_physicBasedShadar.bindUniform("diffuseTex", 0);
-	// Bind texture to specified location
-	m_denimTexture.bind(0);
-
-	// draw bunny
-	m_bunnyMesh.draw();
+	// every object is recorded, one draw each
+	int culling = imgui_culling;
+	int recordThreads = imgui_recordThreads;
+	imgui_culling = 0;
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
-}
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < 5; ++i)
+		m_recordThreadCounts[i] = (1u << i) <= cores ? (1u << i) : 0;
 
-// Draws a dragon using the physicsBased shader (checks if render target is on and applies accordingly)
-void MyApplication::physicsBasedShaderDragon()
-{
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	for (int i = 0; i < 3; ++i)
+	{
+		buildScene(counts[i], BATCH_NONE);
 
-	// Bind Oren-Nayar BDRF shader program
-	m_physicBasedShadar.bind();
-	// bind light
-	m_physicBasedShadar.bindUniform("Ia", m_ambientLight);
-	
-	m_physicBasedShadar.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_physicBasedShadar.bindUniform("m_lightCount", m_lightCount);
-	m_physicBasedShadar.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_physicBasedShadar.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-	
-	m_physicBasedShadar.bindUniform("Roughness", 0.05f);
-	m_physicBasedShadar.bindUniform("ReflectionCoefficient", 0.5f);
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_dragonTransform;
-	m_physicBasedShadar.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_physicBasedShadar.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_dragonTransform)));
-	// Bind camera
-	m_physicBasedShadar.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-
-	m_physicBasedShadar.bindUniform("diffuseTex", 0);
-	// Bind texture to specified location
-	m_denimTexture.bind(0);
-
-	// draw dragon
-	m_dragonMesh.draw();
+		// the first frame compiles any variants the scene hadn't used yet
+		drawScene();
+		glFinish();
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+		for (int t = 0; t < 5 && m_recordThreadCounts[t] != 0; ++t)
+		{
+			imgui_recordThreads = (int)m_recordThreadCounts[t];
+
+			float recordTime = 0;
+			double startTime = glfwGetTime();
+			for (int frame = 0; frame < frameCount; ++frame)
+			{
+				drawScene();
+				recordTime += m_renderQueue.getStats().recordTime;
+			}
+			m_recordFrameTimes[i][t] = (float)((glfwGetTime() - startTime) * 1000.0 / frameCount);
+			m_recordTimes[i][t] = recordTime / frameCount;
+
+			// outside the timing, so GPU work queued by one thread count isn't waited on by the next
+			glFinish();
+
+			printf("Command recording, %u objects on %u threads: %.3f ms per frame, %.3f ms recording\n",
+				   counts[i], m_recordThreadCounts[t], m_recordFrameTimes[i][t], m_recordTimes[i][t]);
+		}
+	}
+
+	imgui_culling = culling;
+	imgui_recordThreads = recordThreads;
+	m_sceneShader = -1;
 }
 
-// Draws a buddha using the physicsBased shader (checks if render target is on and applies accordingly)
-void MyApplication::physicsBasedShaderBuddha()
+// Culls 10,000, 100,000 and 1,000,000 random spheres with each method and records the spheres culled per ms
+void MyApplication::measureCulling()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	const unsigned int counts[] = { 10000, 100000, 1000000 };
+	const int repeatCount = 10;
 
-	// Bind Oren-Nayar BDRF shader program
-	m_physicBasedShadar.bind();
-	// bind light
-	m_physicBasedShadar.bindUniform("Ia", m_ambientLight);
-
-	m_physicBasedShadar.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_physicBasedShadar.bindUniform("m_lightCount", m_lightCount);
-	m_physicBasedShadar.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_physicBasedShadar.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-
-	m_physicBasedShadar.bindUniform("Roughness", 0.05f);
-	m_physicBasedShadar.bindUniform("ReflectionCoefficient", 0.5f);
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_buddhaTransform;
-	m_physicBasedShadar.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_physicBasedShadar.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_buddhaTransform)));
-	// Bind camera
-	m_physicBasedShadar.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-
-	m_physicBasedShadar.bindUniform("diffuseTex", 0);
-	// Bind texture to specified location
-	m_denimTexture.bind(0);
-
-	// draw buddha
-	m_buddhaMesh.draw();
+	mat4 view = m_camera.GetViewMatrix();
+	mat4 projectionView = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * view;
+	vec3 cameraPosition = vec3(glm::inverse(view)[3]);
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	FrustumCuller culler;
+	std::vector<unsigned int> visible;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		// spread around the camera so roughly as many fall on each side of every plane
+		culler.clear();
+		culler.reserve(counts[i]);
+		for (unsigned int sphere = 0; sphere < counts[i]; ++sphere)
+			culler.add(cameraPosition + glm::linearRand(vec3(-500), vec3(500)), glm::linearRand(0.5f, 2.0f));
+
+		for (int method = 0; method < 3; ++method)
+		{
+			// the first run touches every sphere once so all of them start in the cache
+			culler.cull(projectionView, visible, (FrustumCuller::Method)method);
+
+			float time = 0;
+			for (int repeat = 0; repeat < repeatCount; ++repeat)
+			{
+				culler.cull(projectionView, visible, (FrustumCuller::Method)method);
+				time += culler.getCullTime();
+			}
+			m_cullRates[i][method] = counts[i] / (time / repeatCount);
+		}
+		m_cullVisibleFraction = (float)visible.size() / counts[i];
+
+		printf("Culling %u spheres: %.0f per ms scalar, %.0f per ms %s, %.0f per ms %s across threads, %.1f%% visible\n",
+			   counts[i], m_cullRates[i][0], m_cullRates[i][1], FrustumCuller::getSIMDName(), m_cullRates[i][2],
+			   FrustumCuller::getSIMDName(), m_cullVisibleFraction * 100);
+	}
 }
 
-// Draws a lucy using the physicsBased shader (checks if render target is on and applies accordingly)
-void MyApplication::physicsBasedShaderLucy()
+// Draws the scene at 1 to 100,000 objects, one draw per object and then instanced, and records the frame and submit time of each
+void MyApplication::measureInstancing()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
+	const unsigned int counts[] = { 1, 100, 1000, 10000, 100000 };
+	const int frameCount = 10;
 
-	// Bind Oren-Nayar BDRF shader program
-	m_physicBasedShadar.bind();
-	// bind light
-	m_physicBasedShadar.bindUniform("Ia", m_ambientLight);
-
-	m_physicBasedShadar.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_physicBasedShadar.bindUniform("m_lightCount", m_lightCount);
-	m_physicBasedShadar.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_physicBasedShadar.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-
-	m_physicBasedShadar.bindUniform("Roughness", 0.05f);
-	m_physicBasedShadar.bindUniform("ReflectionCoefficient", 0.5f);
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_lucyTransform;
-	m_physicBasedShadar.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_physicBasedShadar.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_lucyTransform)));
-	// Bind camera
-	m_physicBasedShadar.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-
-	m_physicBasedShadar.bindUniform("diffuseTex", 0);
-	// Bind texture to specified location
-	m_denimTexture.bind(0);
-	
-	// draw lucy
-	m_lucyMesh.draw();
+	for (int i = 0; i < 5; ++i)
+	{
+		for (int instanced = 0; instanced < 2; ++instanced)
+		{
+			buildScene(counts[i], instanced ? BATCH_INSTANCED : BATCH_NONE);
+			if (instanced)
+			{
+				m_instancingUploadTimes[i] = 0;
+				for (auto& buffer : m_instanceBuffers)
+					m_instancingUploadTimes[i] += buffer->getUpdateTime();
+			}
+
+			// the first frame compiles any variants the scene hadn't used yet
+			drawScene();
+			glFinish();
+
+			// waiting for the GPU each frame so the frame time includes drawing the instances
+			float submitTime = 0;
+			double startTime = glfwGetTime();
+			for (int frame = 0; frame < frameCount; ++frame)
+			{
+				drawScene();
+				glFinish();
+				const RenderQueue::Stats& stats = m_renderQueue.getStats();
+				submitTime += stats.submitTime + stats.sortTime + stats.executeTime;
+			}
+			m_instancingFrameTimes[i][instanced] = (float)((glfwGetTime() - startTime) * 1000.0 / frameCount);
+			m_instancingSubmitTimes[i][instanced] = submitTime / frameCount;
+			m_instancingDrawCounts[i][instanced] = m_renderQueue.getStats().drawCount;
+
+			printf("%s, %u objects: %.3f ms per frame, %.3f ms submitting %u draws\n", instanced ? "Instanced" : "Per object",
+				   counts[i], m_instancingFrameTimes[i][instanced], m_instancingSubmitTimes[i][instanced],
+				   m_instancingDrawCounts[i][instanced]);
+		}
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	m_sceneShader = -1;
 }
 
-// Draws a spear using the physicsBased shader (checks if render target is on and applies accordingly)
-void MyApplication::physicsBasedShaderSpear()
+// Draws 1,000, 10,000 and 100,000 objects of every model with each batching, and records the draw calls and frame and submit time of each
+void MyApplication::measureIndirect()
 {
-	if (imgui_renderTarget == 1)
-		renderTargetStart();
-
-	// Bind Oren-Nayar BDRF shader program
-	m_physicBasedShadar.bind();
-	// bind light
-	m_physicBasedShadar.bindUniform("Ia", m_ambientLight);
-
-	m_physicBasedShadar.bindUniform("m_pointLightPos", 4, &m_pointLightPos[0]);
-	m_physicBasedShadar.bindUniform("m_lightCount", m_lightCount);
-	m_physicBasedShadar.bindUniform("m_lightColors", 4, &m_lightColors[0]);
-	m_physicBasedShadar.bindUniform("m_lightPower", 4, &m_lightPower[0]);
-
-	m_physicBasedShadar.bindUniform("Roughness", 0.05f);
-	m_physicBasedShadar.bindUniform("ReflectionCoefficient", 0.5f);
-	// bind transform
-	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_spearTransform;
-	m_physicBasedShadar.bindUniform("ProjectionViewModel", pvm);
-	// bind transforms for lighting
-	m_physicBasedShadar.bindUniform("NormalMatrix", glm::inverseTranspose(glm::mat3(m_spearTransform)));
-	// Bind camera
-	m_physicBasedShadar.bindUniform("CameraPosition", vec3(glm::inverse(m_camera.GetViewMatrix())[3]));
-	// draw spear
-	m_spearMesh.draw();
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	const char* batchingNames[] = { "Per object", "Instanced", "Multi-draw indirect" };
+	const int frameCount = 10;
+
+	// phong draws every model, and with culling off every object is drawn each frame
+	int shader = imgui_shader;
+	int model = imgui_model;
+	int culling = imgui_culling;
+	imgui_shader = 2;
+	imgui_model = 6;
+	imgui_culling = 0;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int batching = 0; batching < 3; ++batching)
+		{
+			buildScene(counts[i], (SceneBatching)batching);
+
+			// the first frame compiles any variants the scene hadn't used yet, and fills the buffers
+			drawScene();
+			glFinish();
+
+			float submitTime = 0;
+			double startTime = glfwGetTime();
+			for (int frame = 0; frame < frameCount; ++frame)
+			{
+				drawScene();
+				glFinish();
+				const RenderQueue::Stats& stats = m_renderQueue.getStats();
+				submitTime += stats.submitTime + stats.recordTime + stats.sortTime + stats.executeTime;
+			}
+			m_indirectFrameTimes[i][batching] = (float)((glfwGetTime() - startTime) * 1000.0 / frameCount);
+			m_indirectSubmitTimes[i][batching] = submitTime / frameCount;
+			m_indirectDrawCounts[i][batching] = m_renderQueue.getStats().drawCount;
+
+			printf("%s, %u objects: %.3f ms per frame, %.3f ms submitting %u draws\n", batchingNames[batching], counts[i],
+				   m_indirectFrameTimes[i][batching], m_indirectSubmitTimes[i][batching], m_indirectDrawCounts[i][batching]);
+			if (batching == BATCH_INDIRECT)
+				printf("  %u batches, %u of them from splitting by material\n", m_indirectBatchCount, m_indirectMaterialBatches);
+		}
+	}
 
-	if (imgui_renderTarget == 1)
-		renderTargetEnd();
+	imgui_shader = shader;
+	imgui_model = model;
+	imgui_culling = culling;
+	m_sceneShader = -1;
 }
 
 // Binds the render target and clears the screen
 void MyApplication::renderTargetStart()
 {
+	aie::GPUProfiler::Scope scope(m_gpuProfiler, "Render Target Start");
+
 	// bind our render target
 	m_renderTarget.bind();
 
@@ -1101,6 +1730,8 @@ void MyApplication::renderTargetStart()
 // Unbinds the render target, clears the screen and draws a textured quad with the rendered image
 void MyApplication::renderTargetEnd()
 {
+	aie::GPUProfiler::Scope scope(m_gpuProfiler, "Render Target End");
+
 	// unbind target to return to backbuffer
 	m_renderTarget.unbind();
 
@@ -1110,9 +1741,8 @@ void MyApplication::renderTargetEnd()
 	// bind texturing shader
 	m_texturedShader.bind();
 	auto pvm = m_camera.GetProjectionMatrix(getWindowWidth(), getWindowHeight()) * m_camera.GetViewMatrix() * m_quadTransform;
-	m_texturedShader.bindUniform("ProjectionViewModel", pvm);
-	m_texturedShader.bindUniform("diffuseTexture", 0);
-	m_renderTarget.getTarget(0).bind(0);
+	shaders::Textured::setProjectionViewModel(m_texturedShader, pvm);
+	m_renderTarget.getTarget(0).bind(shaders::Textured::Binding::diffuseTexture);
 
 	// draw quad
 	m_quadMesh2.draw();
@@ -1121,6 +1751,9 @@ void MyApplication::renderTargetEnd()
 // Returns unsigned int of the window's width
 unsigned int MyApplication::getWindowWidth()  
 {
+	if (m_headless.enabled)
+		return m_headless.width;
+
 	int width = 0, height = 0;
 	glfwGetWindowSize(m_window, &width, &height);
 	return width;
@@ -1129,6 +1762,9 @@ unsigned int MyApplication::getWindowWidth()
 // Returns unsigned int of the window's height
 unsigned int MyApplication::getWindowHeight() 
 {
+	if (m_headless.enabled)
+		return m_headless.height;
+
 	int width = 0, height = 0;
 	glfwGetWindowSize(m_window, &width, &height);
 	return height;
@@ -1136,7 +1772,7 @@ unsigned int MyApplication::getWindowHeight()
 
 void MyApplication::IMGUITools()
 {
-	ImGui::TextWrapped("Note: Textured shader only works for quad and spear, and Normal Map only works for spear");
+	ImGui::TextWrapped("Note: Textured shader only works for quad and spear, and Normal Map only works for spear. Mixed gives each object the next shader that can draw it");
 
 	if (ImGui::CollapsingHeader("Renderer Target"))
 	{
@@ -1146,12 +1782,197 @@ void MyApplication::IMGUITools()
 
 	if (ImGui::CollapsingHeader("Shaders"))
 	{
-		ImGui::Combo("Current Shader", &imgui_shader, "Simple\0Textured\0Phong\0Normal Map\0Physics Based\0\0");   // Combo using values packed in a single constant string (for really quick combo)
+		ImGui::Combo("Current Shader", &imgui_shader, "Simple\0Textured\0Phong\0Normal Map\0Physics Based\0Mixed\0\0");   // Combo using values packed in a single constant string (for really quick combo)
+
+		// Uniforms resolve through each program's location table, so this stays at 0 after the first frame
+		ImGui::Text("glGetUniformLocation calls last frame: %u", m_locationQueries);
+		// Camera and lights come from uniform buffers, so only per object uniforms are set per draw,
+		// and values a program already holds are skipped along with redundant binds
+		const char* bindingNames[] = { "glUseProgram/glBindProgramPipeline", "glBindVertexArray", "glBindBuffer", "glBindTexture", "glUniform" };
+		for (unsigned int i = 0; i < GLState::BINDING_Count; ++i)
+			ImGui::Text("%s calls last frame: %u issued, %u skipped", bindingNames[i],
+						GLState::getIssuedCount((GLState::Binding)i), GLState::getElidedCount((GLState::Binding)i));
+
+		// startup link times, warm runs should load every program from the binary cache
+		const char* names[] = { "Simple", "Textured" };
+		const ShaderProgram* programs[] = { &m_shader, &m_texturedShader };
+		for (int i = 0; i < 2; ++i)
+			ImGui::Text("%s: linked in %.2f ms (%s)", names[i], programs[i]->getLinkTime(),
+						programs[i]->isFromBinaryCache() ? "binary cache" : "compiled");
+
+		// variants are compiled as they're first drawn
+		const char* variantNames[] = { "Phong", "Normal Map", "Physics Based" };
+		const ShaderVariants* variants[] = { &m_phongVariants, &m_normalMapVariants, &m_physicBasedVariants };
+		for (int i = 0; i < 3; ++i)
+			ImGui::Text("%s: %u variants, %.2f ms linking", variantNames[i], (unsigned int)variants[i]->getVariantCount(),
+						variants[i]->getCompileTime());
+
+		// specialised variants have the light count baked in, generic ones loop over the uniform
+		ImGui::RadioButton("Generic", &imgui_specialiseShaders, 0); ImGui::SameLine();
+		ImGui::RadioButton("Specialised", &imgui_specialiseShaders, 1);
+
+		// pipelines share each set's vertex stage, so a variant only compiles its fragment stage
+		ImGui::RadioButton("Linked", &imgui_separablePrograms, 0); ImGui::SameLine();
+		ImGui::RadioButton("Pipelines", &imgui_separablePrograms, 1);
+		ImGui::Text("Programs linked: %u, stages compiled: %u", ShaderProgram::getLinkCount(), ShaderProgram::getCompileCount());
+		const aie::GPUProfiler::Pass* scenePass = m_gpuProfiler.findPass("Scene");
+		ImGui::Text("Scene GPU time: %.3f ms", scenePass != nullptr ? scenePass->average : 0.0f);
+
+		// compiles are batched so drivers with parallel shader compile can overlap them
+		ImGui::Text("Shader setup at startup: %.2f ms", m_shaderSetupTime);
+		ImGui::Text("Shader sources at startup: %.2f ms, %u files read, %u from cache", m_shaderLoadTime, m_shaderFileReads, m_shaderCacheHits);
+		if (ImGui::Button("Compile 100 variants"))
+			measureShaderStress();
+		ImGui::Text("One at a time: %.2f ms, batched: %.2f ms, pipelines: %.2f ms", m_stressSerialTime, m_stressBatchTime, m_stressPipelineTime);
+
+		// generated bindings set uniforms at compile time locations without a table lookup
+		if (ImGui::Button("Time uniform binding"))
+			measureUniformBinding();
+		ImGui::Text("Per draw: %.3f us by name, %.3f us generated", m_namedBindTime, m_generatedBindTime);
+
+		// edits to the shader files are picked up without restarting, the frame time shouldn't spike
+		ImGui::Text("Hot reload: %s, %u reloaded, %u failed", m_shaderWatcher.isUsingINotify() ? "inotify" : "polling",
+					m_shaderWatcher.getReloadCount(), m_shaderWatcher.getFailedReloadCount());
+		ImGui::Text("Watcher update: %.3f ms (peak %.3f ms)", m_shaderWatcher.getUpdateTime(), m_shaderWatcher.getPeakUpdateTime());
+		ImGui::Text("Frame time: %.2f ms, longest during a reload: %.2f ms", m_averageFrameTime, m_reloadFrameTime);
 	}
 
 	if (ImGui::CollapsingHeader("Model"))
 	{
-		ImGui::Combo("Current Model", &imgui_model, "Quad\0Bunny\0Dragon\0Buddha\0Lucy\0Spear\0\0");   // Combo using values packed in a single constant string (for really quick combo)
+		ImGui::Combo("Current Model", &imgui_model, "Quad\0Bunny\0Dragon\0Buddha\0Lucy\0Spear\0All\0\0");   // Combo using values packed in a single constant string (for really quick combo)
+		ImGui::Combo("Objects", &imgui_objectCount, "1\0" "100\0" "10,000\0" "100,000\0\0");
+
+		// objects sharing a variant, mesh and material draw with one call, simple and textured can't
+		ImGui::RadioButton("Per Object", &imgui_instanced, 0); ImGui::SameLine();
+		ImGui::RadioButton("Instanced", &imgui_instanced, 1); ImGui::SameLine();
+
+		// multi-draws also share one call between different models, a draw per mesh chunk
+		ImGui::RadioButton("Multi-Draw Indirect", &imgui_instanced, 2);
+		if (m_sceneInstanced == BATCH_INDIRECT)
+			ImGui::Text("%u batches, %u from splitting by material", m_indirectBatchCount, m_indirectMaterialBatches);
+	}
+
+	if (ImGui::CollapsingHeader("Render Queue"))
+	{
+		// packets are sorted by program, material and mesh, so each changes once per run of draws
+		const RenderQueue::Stats& stats = m_renderQueue.getStats();
+		ImGui::Text("Draws: %u, objects: %u, program changes: %u, material changes: %u, mesh changes: %u",
+					stats.drawCount, stats.instanceCount, stats.programChanges, stats.materialChanges, stats.meshChanges);
+		ImGui::Text("Submit: %.3f ms, record: %.3f ms on %u threads, sort: %.3f ms, execute: %.3f ms", stats.submitTime,
+					stats.recordTime, stats.recordThreads, stats.sortTime, stats.executeTime);
+
+		// recording threads work out keys and matrices, only the render thread makes GL calls
+		ImGui::SliderInt("Recording Threads (0 auto)", &imgui_recordThreads, 0, (int)std::max(1u, std::thread::hardware_concurrency()));
+		if (ImGui::Button("Measure recording, 1,000 to 100,000 objects"))
+			measureCommandRecording();
+		const char* recordNames[] = { "1,000", "10,000", "100,000" };
+		for (int i = 0; i < 3; ++i)
+			for (int t = 0; t < 5 && m_recordThreadCounts[t] != 0; ++t)
+				ImGui::Text("%s on %u threads: %.3f ms per frame, %.3f ms recording", recordNames[i], m_recordThreadCounts[t],
+							m_recordFrameTimes[i][t], m_recordTimes[i][t]);
+
+		if (ImGui::Button("Measure 1, 100 and 10,000 objects"))
+			measureRenderQueue();
+		const char* countNames[] = { "1", "100", "10,000" };
+		for (int i = 0; i < 3; ++i)
+			ImGui::Text("%s: %.3f ms per frame, %u/%u/%u program/material/mesh changes", countNames[i], m_queueFrameTimes[i],
+						m_queueStats[i].programChanges, m_queueStats[i].materialChanges, m_queueStats[i].meshChanges);
+
+		// spheres are tested against all six planes at once, a register of spheres per step
+		ImGui::Text("Culling (%s, %u wide):", FrustumCuller::getSIMDName(), FrustumCuller::getSIMDWidth());
+		ImGui::RadioButton("Off", &imgui_culling, 0); ImGui::SameLine();
+		ImGui::RadioButton("Scalar", &imgui_culling, 1); ImGui::SameLine();
+		ImGui::RadioButton("SIMD", &imgui_culling, 2); ImGui::SameLine();
+		ImGui::RadioButton("Threaded", &imgui_culling, 3);
+		if (imgui_culling != 0)
+			ImGui::Text("Visible: %u of %u, culled in %.3f ms", (unsigned int)m_visibleBounds.size(),
+						(unsigned int)m_culler.getCount(), m_culler.getCullTime());
+
+		if (ImGui::Button("Measure culling, 10,000 to 1,000,000 spheres"))
+			measureCulling();
+		const char* cullNames[] = { "10,000", "100,000", "1,000,000" };
+		for (int i = 0; i < 3; ++i)
+			ImGui::Text("%s: %.0f/ms scalar, %.0f/ms SIMD, %.0f/ms threaded", cullNames[i],
+						m_cullRates[i][0], m_cullRates[i][1], m_cullRates[i][2]);
+		ImGui::Text("%.1f%% of the measured spheres were visible", m_cullVisibleFraction * 100);
+
+		if (ImGui::Button("Measure instancing, 1 to 100,000 objects"))
+			measureInstancing();
+		const char* instancingNames[] = { "1", "100", "1,000", "10,000", "100,000" };
+		for (int i = 0; i < 5; ++i)
+			ImGui::Text("%s: per object %.3f ms (%.3f ms submit, %u draws), instanced %.3f ms (%.3f ms submit, %u draws, %.3f ms upload)",
+						instancingNames[i], m_instancingFrameTimes[i][0], m_instancingSubmitTimes[i][0], m_instancingDrawCounts[i][0],
+						m_instancingFrameTimes[i][1], m_instancingSubmitTimes[i][1], m_instancingDrawCounts[i][1], m_instancingUploadTimes[i]);
+
+		if (ImGui::Button("Measure multi-draw indirect, 1,000 to 100,000 objects of every model"))
+			measureIndirect();
+		const char* indirectNames[] = { "1,000", "10,000", "100,000" };
+		for (int i = 0; i < 3; ++i)
+			ImGui::Text("%s: per object %.3f ms (%.3f ms submit, %u draws), instanced %.3f ms (%.3f ms, %u), indirect %.3f ms (%.3f ms, %u)",
+						indirectNames[i], m_indirectFrameTimes[i][0], m_indirectSubmitTimes[i][0], m_indirectDrawCounts[i][0],
+						m_indirectFrameTimes[i][1], m_indirectSubmitTimes[i][1], m_indirectDrawCounts[i][1],
+						m_indirectFrameTimes[i][2], m_indirectSubmitTimes[i][2], m_indirectDrawCounts[i][2]);
+	}
+
+	if (ImGui::CollapsingHeader("Frame Pacing"))
+	{
+		// targets sleep until just before each deadline and spin the rest, so they land on it
+		ImGui::RadioButton("VSync", &imgui_pacing, FrameTimer::PACING_VSYNC); ImGui::SameLine();
+		ImGui::RadioButton("Uncapped", &imgui_pacing, FrameTimer::PACING_UNCAPPED); ImGui::SameLine();
+		ImGui::RadioButton("Target", &imgui_pacing, FrameTimer::PACING_TARGET);
+		ImGui::SliderInt("Target FPS", &imgui_targetFPS, 30, 240);
+		ImGui::SliderInt("Tick Rate", &imgui_tickRate, 10, 240);
+		ImGui::Text("Ticks this frame: %u, interpolated %.2f in to the next", m_frameTimer.getTickCount(), m_frameTimer.getAlpha());
+		ImGui::Text("Waited: %.3f ms sleeping, %.3f ms spinning", m_frameTimer.getSleepTime(), m_frameTimer.getSpinTime());
+
+		// each mode keeps the stats from the last time it was used
+		const char* modeNames[] = { "VSync", "Uncapped", "Target" };
+		for (unsigned int mode = 0; mode < FrameTimer::PACING_Count; ++mode)
+		{
+			const FrameTimer::Stats& stats = m_frameTimer.getStats((FrameTimer::PacingMode)mode);
+			ImGui::Text("%s: %.2f ms mean, %.3f ms deviation, %.2f to %.2f ms, %u missed of %u frames", modeNames[mode],
+						stats.mean, stats.deviation, stats.min, stats.max, stats.missedCount, stats.frameCount);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Streaming"))
+	{
+		// Gizmos and IMGUI vertices go straight in to mapped memory, only waiting if the GPU is frames behind
+		if (m_streamBuffer.isCreated())
+		{
+			ImGui::Text("%u frames of %.1f MB", m_streamBuffer.getFrameCount(), m_streamBuffer.getFrameSize() / (1024.0f * 1024.0f));
+			ImGui::Text("Streamed: %.1f KB per frame, peak %.1f KB", m_streamBuffer.getFrameBytes() / 1024.0f,
+						m_streamBuffer.getPeakFrameBytes() / 1024.0f);
+			ImGui::Text("Stall: %.3f ms, %u writes didn't fit", m_streamBuffer.getStallTime(), m_streamBuffer.getOverflowCount());
+		}
+		else
+			ImGui::Text("Buffer storage unavailable, updating buffers in place");
+	}
+
+	if (ImGui::CollapsingHeader("GPU Profiler"))
+	{
+		// timings trail the frame by a few frames, so reading them back never stalls
+		ImGui::Checkbox("Show Profiler", &imgui_gpuProfiler);
+		const aie::GPUProfiler::Pass* framePass = m_gpuProfiler.findPass("Frame");
+		ImGui::Text("Frame GPU time: %.3f ms", framePass != nullptr ? framePass->average : 0.0f);
+	}
+
+	if (ImGui::CollapsingHeader("CPU Profiler"))
+	{
+#if AIE_CPU_PROFILER
+		// zones from every thread added up per frame, each including the zones nested in it
+		ImGui::SliderInt("Zones Shown", &imgui_cpuZoneCount, 1, 32);
+		const auto& zones = aie::CPUProfiler::getZones();
+		for (size_t i = 0; i < zones.size() && i < (size_t)imgui_cpuZoneCount; ++i)
+			ImGui::Text("%-20s %7.3f ms avg, %7.3f ms, %u calls", zones[i].name, zones[i].average, zones[i].time, zones[i].calls);
+
+		// for chrome://tracing or Perfetto
+		ImGui::SliderInt("Trace Frames", &imgui_traceFrames, 1, (int)aie::CPUProfiler::FRAME_HISTORY);
+		if (ImGui::Button("Export Trace"))
+			aie::CPUProfiler::writeTrace("cpu_trace.json", (unsigned int)imgui_traceFrames);
+#else
+		ImGui::Text("Compiled out, AIE_CPU_PROFILER is 0");
+#endif
 	}
 
 	if (ImGui::CollapsingHeader("Lighting"))
@@ -1163,8 +1984,99 @@ void MyApplication::IMGUITools()
 		ImGui::Combo("Light 3 Color", &imgui_light3, "White\0Red\0Orange\0Yellow\0Green\0Blue\0Purple\0\0");   // Combo using values packed in a single constant string (for really quick combo)
 
 		ImGui::Combo("Light 4 Color", &imgui_light4, "White\0Red\0Orange\0Yellow\0Green\0Blue\0Purple\0\0");   // Combo using values packed in a single constant string (for really quick combo)
+
+		// each light count builds its own specialised shader variants
+		ImGui::SliderInt("Light Count", &m_lightCount, 0, MAX_LIGHTS);
+	}
+
+	if (ImGui::CollapsingHeader("Textures"))
+	{
+		// Video memory and load time of each texture
+		std::vector<const Texture*> textures = { &m_gridTexture, &m_denimTexture };
+		for (size_t i = 0; i < m_spearMesh.getMaterialCount(); ++i)
+		{
+			textures.push_back(&m_spearMesh.getMaterial(i).diffuseTexture);
+			textures.push_back(&m_spearMesh.getMaterial(i).specularTexture);
+			textures.push_back(&m_spearMesh.getMaterial(i).normalTexture);
+		}
+
+		for (auto texture : textures)
+		{
+			if (texture->getFilename() == "none")
+				continue;
+			ImGui::Text("%s", texture->getFilename().c_str());
+			ImGui::Text("  %ux%u %s %.1f KB, loaded in %.2f ms", texture->getWidth(), texture->getHeight(),
+				texture->isCompressed() ? "compressed" : "uncompressed", texture->getMemorySize() / 1024.0f, texture->getLoadTime());
+			if (texture->getResidency() == Texture::RESIDENT_SMALL_MIPS)
+				ImGui::Text("  evicted down to mip %u", texture->getResidentLevel());
+			else if (texture->getResidency() == Texture::EVICTED)
+				ImGui::Text("  evicted");
+		}
+
+		// Binds and CPU cost of the last spear draw, packed materials share their atlases
+		ImGui::Text("Spear: %u atlases, %u texture binds, draw %.3f ms", (unsigned int)m_spearMesh.getAtlasCount(),
+			m_spearMesh.getTextureBindCount(), m_spearMesh.getDrawTime());
 	}
 
+	if (ImGui::CollapsingHeader("Texture Memory"))
+	{
+		// Current and peak memory of every texture, least recently used textures are evicted over budget
+		if (ImGui::SliderInt("Budget (MB)", &imgui_textureBudget, 0, 512))
+			TextureResidency::setBudget((size_t)imgui_textureBudget * 1024 * 1024);
+		ImGui::Text("GPU: %.2f MB, peak %.2f MB", TextureResidency::getGPUMemory() / (1024.0f * 1024.0f),
+			TextureResidency::getPeakGPUMemory() / (1024.0f * 1024.0f));
+		ImGui::Text("CPU: %.2f MB, peak %.2f MB", TextureResidency::getCPUMemory() / (1024.0f * 1024.0f),
+			TextureResidency::getPeakCPUMemory() / (1024.0f * 1024.0f));
+		ImGui::Text("%u textures, %u evicted", (unsigned int)TextureResidency::getTextureCount(),
+			(unsigned int)TextureResidency::getEvictedCount());
+	}
+
+	if (imgui_gpuProfiler)
+		gpuProfilerWindow();
+}
+
+// Shows each pass's GPU time with a graph of its recent frames, and exports them as CSV
+void MyApplication::gpuProfilerWindow()
+{
+	ImGui::SetNextWindowSize(ImVec2(420, 480), ImGuiSetCond_FirstUseEver);
+	if (ImGui::Begin("GPU Profiler", &imgui_gpuProfiler) == false)
+	{
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("%u frames, %u dropped waiting on results", m_gpuProfiler.getHistoryCount(), m_gpuProfiler.getDroppedCount());
+	if (ImGui::Button("Export CSV"))
+	{
+		if (m_gpuProfiler.writeCSV("gpu_profile.csv"))
+			printf("GPU profile written to gpu_profile.csv\n");
+	}
+
+	// history is a ring, the graph starts from its oldest frame. Frames a pass didn't run in
+	// plot as 0
+	float values[aie::GPUProfiler::HISTORY_SIZE];
+	unsigned int count = m_gpuProfiler.getHistoryCount();
+	unsigned int start = m_gpuProfiler.getHistoryStart();
+	for (size_t i = 0; i < m_gpuProfiler.getPassCount(); ++i)
+	{
+		const aie::GPUProfiler::Pass& pass = m_gpuProfiler.getPass(i);
+		for (unsigned int j = 0; j < count; ++j)
+			values[j] = glm::max(pass.history[(start + j) % aie::GPUProfiler::HISTORY_SIZE], 0.0f);
+
+		// nested passes sit under the pass they ran in
+		ImGui::Separator();
+		if (pass.depth > 0)
+			ImGui::Indent(pass.depth * 16.0f);
+		ImGui::Text("%s: %.3f ms, avg %.3f, min %.3f, max %.3f", pass.name.c_str(), pass.last, pass.average, pass.min, pass.max);
+
+		char label[64];
+		snprintf(label, sizeof(label), "##%s", pass.name.c_str());
+		if (count > 0)
+			ImGui::PlotLines(label, values, (int)count, 0, nullptr, 0, pass.max * 1.25f + 0.001f, ImVec2(0, 40));
+		if (pass.depth > 0)
+			ImGui::Unindent(pass.depth * 16.0f);
+	}
 
+	ImGui::End();
 }
 
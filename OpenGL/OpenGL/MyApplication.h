@@ -5,6 +5,19 @@
 #include "Shader.h"
 #include "OBJMesh.h"
 #include "RenderTarget.h"
+#include "UniformBuffer.h"
+#include "ShaderWatcher.h"
+#include "ShaderVariants.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "FrustumCuller.h"
+#include "MeshPool.h"
+#include "IndirectBatch.h"
+#include "StreamBuffer.h"
+#include "FrameTimer.h"
+#include "GPUProfiler.h"
+#include <memory>
+#include <string>
 
 class MyApplication
 {
@@ -12,45 +25,48 @@ public:
 	MyApplication();				// Default constructor initialises time member variables
 	virtual ~MyApplication();		// Virtual destructor
 
+	bool parseCommandLine(int argc, char* argv[]);	// Reads the headless benchmark options, returns false and prints the usage if any are invalid
+	bool isHeadless() const { return m_headless.enabled; }
+	int runHeadless();				// Draws the scene a fixed number of frames in to an offscreen target, saving them if asked, and prints the frame times. Returns the exit code
+	bool saveFrame(const char* filename);	// Reads back the offscreen target and writes it as a PNG
+
 	int startup();					// Sets up a window, transforms, and lighting. Loads all shaders, textures and meshes. Initialises quads and render target. Creates imgui window. Returns an int determining success
 	void shutdown();				// Destroys imgui window, gizmos and window
 	bool update();					// Updates everything on screen - returns true for if the user hits escape to exit the application (stops updating)
 	void loadShaders();				// Loads in the different shaders for use - will display error is issues occur
+	void measureShaderStress();		// Compiles 100 unique variants of the physics based shader one at a time, as a batch, then as pipelines, and records each time
+	void measureUniformBinding();	// Sets a phong draw's uniforms by name and then through the generated bindings, and records the CPU time per draw of each
 	bool loadTextures();			// Loads in the different textures for use - will display error is issues occur
 	bool intialiseRenderTarget();	// Initialises the render target for use - will display error is issues occur
 	void setUpTransforms();			// Assigns each matrix4 member variable for object transforms to similar sizes
 	bool loadStanfordModels();		// Loads in the stanford models from the data folder
 	void setUpLighting();			// Creates four light sources and gives them an equal power of 100 and positions them around the mesh position
 
-	void updateTime();				// Ensures the current, previous and delta time are updated accordingly
+	void updateTime();				// Ensures the current, previous and delta time are updated accordingly, and works out the simulation ticks due this frame
+	void updatePacing();			// Applies the pacing mode, target frame rate and tick rate chosen in IMGUI
 	void checkIMGUIValues();		// Checks for changes made by the user on the imGui tool and runs which demonstration the user has selected
 	void updateLighting();			// Checks for changes made by the user on the imGui tool and changes color of lights to user's choice
+	void updateUniformBuffers();	// Writes the camera and lights in to the uniform buffers shared by every shader, once per frame
 
-	void simpleShaderQuad();		// Draws a quad using the simple shader (checks if render target is on and applies accordingly)
-	void simpleShaderBunny();		// Draws a bunny using the simple shader (checks if render target is on and applies accordingly)
-	void simpleShaderDragon();		// Draws a dragon using the simple shader (checks if render target is on and applies accordingly)
-	void simpleShaderBuddha();		// Draws a buddha using the simple shader (checks if render target is on and applies accordingly)
-	void simpleShaderLucy();		// Draws a lucy using the simple shader (checks if render target is on and applies accordingly)
-	void simpleShaderSpear();		// Draws a spear using the simple shader (checks if render target is on and applies accordingly)
-
-	void texturedShaderQuad();		// Draws a quad using the textured shader (checks if render target is on and applies accordingly)
-	void texturedShaderSpear();		// Draws a spear using the textured shader (checks if render target is on and applies accordingly)
-
-	void phongShaderQuad();			// Draws a quad using the phong shader (checks if render target is on and applies accordingly)	
-	void phongShaderBunny();		// Draws a bunny using the phong shader (checks if render target is on and applies accordingly)
-	void phongShaderDragon();		// Draws a dragon using the phong shader (checks if render target is on and applies accordingly)
-	void phongShaderBuddha();		// Draws a buddha using the phong shader (checks if render target is on and applies accordingly)
-	void phongShaderLucy();			// Draws a lucy using the phong shader (checks if render target is on and applies accordingly)
-	void phongShaderSpear();		// Draws a spear using the phong shader (checks if render target is on and applies accordingly)
+	aie::ShaderProgram* selectVariant(aie::ShaderVariants& variants, unsigned int features);	// Returns the variant for the current light count, or the generic variant if specialisation is off
+	static unsigned int getMeshFeatures(aie::OBJMesh& mesh);	// Returns the shader features every material of a mesh provides, so one variant can draw the whole mesh
 
-	void normalMapShaderSpear();	// Draws a spear using the normal map shader (checks if render target is on and applies accordingly)
+	void setUpMaterials();			// Creates the materials each shader draws with, holding the uniform values and textures shared by its objects
+	// How buildScene groups objects in to draws
+	enum SceneBatching
+	{
+		BATCH_NONE,			// a draw per object
+		BATCH_INSTANCED,	// an instanced draw per variant, mesh and material
+		BATCH_INDIRECT,		// a multi-draw per variant and material, over every model in the mesh pool
+	};
 
-	void physicsBasedShaderQuad();	// Draws a quad using the physicsBased shader (checks if render target is on and applies accordingly)	
-	void physicsBasedShaderBunny();	// Draws a bunny using the physicsBased shader (checks if render target is on and applies accordingly)
-	void physicsBasedShaderDragon();// Draws a dragon using the physicsBased shader (checks if render target is on and applies accordingly)
-	void physicsBasedShaderBuddha();// Draws a buddha using the physicsBased shader (checks if render target is on and applies accordingly)
-	void physicsBasedShaderLucy();	// Draws a lucy using the physicsBased shader (checks if render target is on and applies accordingly)
-	void physicsBasedShaderSpear();	// Draws a spear using the physicsBased shader (checks if render target is on and applies accordingly)
+	void buildScene(unsigned int count, SceneBatching batching);	// Fills the scene with count objects, laid out in a grid, for the selected shader and model, grouped in to draws by batching
+	void drawScene();				// Submits every scene object to the render queue with the program its pipeline picks, then sorts and draws them
+	void measureRenderQueue();		// Draws the scene at 1, 100 and 10,000 objects and records the state changes and CPU time per frame of each
+	void measureCommandRecording();	// Draws 1,000, 10,000 and 100,000 objects recorded on 1 thread up to one per core, and records the CPU time per frame of each
+	void measureCulling();			// Culls 10,000, 100,000 and 1,000,000 random spheres with each method and records the spheres culled per ms
+	void measureInstancing();		// Draws the scene at 1 to 100,000 objects, one draw per object and then instanced, and records the frame and submit time of each
+	void measureIndirect();			// Draws 1,000, 10,000 and 100,000 objects of every model with each batching, and records the draw calls and frame and submit time of each
 
 	void renderTargetStart();		// Binds the render target and clears the screen
 	void renderTargetEnd();			// Unbinds the render target, clears the screen and draws a textured quad with the rendered image
@@ -59,9 +75,47 @@ public:
 	unsigned int getWindowHeight();	// Returns unsigned int of the window's height
 
 	void IMGUITools();
+	void gpuProfilerWindow();		// Shows each pass's GPU time with a graph of its recent frames, and exports them as CSV
 
 private:
 
+	// a renderable and the pipeline that picks its program, either a fixed program or the
+	// variant with the given features
+	struct SceneObject
+	{
+		aie::Renderable			renderable;
+		aie::ShaderProgram*		program = nullptr;
+		aie::ShaderVariants*	variants = nullptr;
+		unsigned int			features = 0;
+
+		// the object's bounds in the culler, one per instance for instanced objects
+		unsigned int			firstBound = 0;
+		unsigned int			boundCount = 0;
+		int						instanceBuffer = -1;	// index in m_instanceBuffers, -1 if not instanced
+		int						batch = -1;				// index in m_indirectBatches, -1 if not batched, with a bound per draw
+
+		// what recording threads draw the object with, set up by setUpSceneRecording
+		unsigned int			pipeline = 0;	// index in m_scenePipelines
+		aie::MaterialHandle		material;
+		aie::MeshHandle			mesh;
+	};
+
+	// a fixed program or a set of variants and features, resolved to a program on the render thread each frame
+	struct ScenePipeline
+	{
+		aie::ShaderProgram*		program = nullptr;
+		aie::ShaderVariants*	variants = nullptr;
+		unsigned int			features = 0;
+
+		aie::ShaderProgram*		resolved = nullptr;	// this frame's program, nullptr if it failed to compile
+		aie::ProgramHandle		handle;
+	};
+
+	bool getSceneObject(int shader, int model, SceneObject& object);	// Describes how a shader draws a model, by their IMGUI indices. Returns false for pairs that can't be drawn
+	void addSceneBounds(SceneObject& object, const glm::mat4* transforms, size_t count);	// Adds a bounding sphere to the culler for each of an object's transforms, one per instance for instanced objects
+	void setUpSceneRecording();		// Gives each scene object its render queue handles and pipeline, which recording threads draw it with
+	void buildIndirectBatches();	// Groups the scene objects in to multi-draw batches by variant and material, a draw per mesh chunk. Objects with no variant or pooled mesh still draw one at a time
+
 	GLFWwindow*		m_window;
 	Camera			m_camera;
 
@@ -69,6 +123,9 @@ private:
 	double			m_currTime;
 	double			m_deltaTime;
 
+	// Fixed simulation ticks and frame pacing
+	aie::FrameTimer	m_frameTimer;
+
 	struct Light 
 	{
 		glm::vec3 direction;
@@ -78,6 +135,22 @@ private:
 
 	aie::RenderTarget	m_renderTarget;
 
+	// Running without a visible window for benchmarks, set from the command line
+	struct HeadlessSettings
+	{
+		bool			enabled = false;
+		bool			egl = false;			// create the context through EGL rather than GLX or WGL
+		unsigned int	width = 1280;
+		unsigned int	height = 720;
+		unsigned int	frameCount = 300;		// frames timed
+		unsigned int	warmupCount = 10;		// frames drawn before timing starts, while variants compile and caches fill
+		std::string		output;					// PNGs are written to output_frame.png, none if empty
+		unsigned int	outputInterval = 0;		// write every nth timed frame, 0 for only the last
+	};
+
+	HeadlessSettings	m_headless;
+	aie::RenderTarget	m_headlessTarget;	// Every headless frame is drawn here, there's nothing to present to
+
 	// Lighting
 	glm::vec3			m_ambientLight;
 	glm::vec3			m_pointLightPos[4];
@@ -85,12 +158,25 @@ private:
 	float				m_lightPower[4];
 	int					m_lightCount;
 
+	// Per frame uniform blocks shared by every shader
+	aie::UniformBuffer	m_frameDataBuffer;
+	aie::UniformBuffer	m_lightDataBuffer;
+
+	// Mapped memory Gizmos and IMGUI write their vertices in to, a region per frame in flight
+	aie::StreamBuffer	m_streamBuffer;
+
+	// GPU time of each pass, read back a few frames later so it never waits on the GPU
+	aie::GPUProfiler	m_gpuProfiler;
+
 	// Shaders
 	aie::ShaderProgram	m_shader;
 	aie::ShaderProgram	m_texturedShader;
-	aie::ShaderProgram	m_phongShader;
-	aie::ShaderProgram	m_normalMapShader;
-	aie::ShaderProgram	m_physicBasedShadar;
+	aie::ShaderVariants	m_phongVariants;
+	aie::ShaderVariants	m_normalMapVariants;
+	aie::ShaderVariants	m_physicBasedVariants;
+
+	// Reloads the shaders above when their files change
+	aie::ShaderWatcher	m_shaderWatcher;
 
 	// Textures
 	aie::Texture		m_gridTexture;
@@ -118,6 +204,38 @@ private:
 	aie::OBJMesh		m_buddhaMesh;
 	glm::mat4			m_buddhaTransform;
 
+	// Uniform values and textures the shaders draw with
+	aie::RenderMaterial	m_gridMaterial;
+	aie::RenderMaterial	m_phongMaterial;
+	aie::RenderMaterial	m_normalMapMaterial;
+	aie::RenderMaterial	m_denimMaterial;
+	aie::RenderMaterial	m_physicBasedMaterial;
+
+	// Objects drawn each frame and the queue that sorts them
+	std::vector<SceneObject>	m_sceneObjects;
+	std::vector<ScenePipeline>	m_scenePipelines;
+	std::vector<unsigned int>	m_instancedObjects;	// Instanced and batched scene objects, drawn from the render thread after their buffers are filled
+	aie::RenderQueue	m_renderQueue;
+	int					m_sceneShader = -1;	// The selections the scene was last built for
+	int					m_sceneModel = -1;
+	int					m_sceneObjectCount = -1;
+	int					m_sceneInstanced = -1;
+
+	// Per instance transforms of the instanced scene objects
+	std::vector<std::unique_ptr<aie::InstanceBuffer>>	m_instanceBuffers;
+
+	// Every model's chunks in one set of buffers, created the first time a scene is batched, and the batches drawing from it
+	aie::MeshPool	m_meshPool;
+	std::vector<std::unique_ptr<aie::IndirectBatch>>	m_indirectBatches;
+	std::vector<unsigned int>	m_visibleDraws;
+
+	// Bounding spheres of every object and instance, the transform of each, and the last frame's visible ones
+	aie::FrustumCuller	m_culler;
+	std::vector<glm::mat4>		m_boundTransforms;
+	std::vector<unsigned int>	m_boundObjects;		// the scene object each bound belongs to
+	std::vector<unsigned int>	m_visibleBounds;
+	std::vector<glm::mat4>		m_visibleTransforms;
+
 	// IMGUI variables
 	int imgui_renderTarget = 0;
 	int imgui_shader = 0;
@@ -128,4 +246,60 @@ private:
 	int imgui_light2 = 0;
 	int imgui_light3 = 0;
 	int imgui_light4 = 0;
+
+	int imgui_objectCount = 0;	// Objects drawn, 0 for 1, 1 for 100, 2 for 10,000 and 3 for 100,000
+	int imgui_culling = 2;		// Frustum culling, 0 for off, 1 scalar, 2 SIMD and 3 SIMD across threads
+	int imgui_recordThreads = 0;	// Threads recording the scene's draws, 0 for one per core when there are enough draws to share
+	int imgui_instanced = 0;	// A SceneBatching, 1 for an instanced draw per variant, mesh and material and 2 for a multi-draw per variant and material
+
+	int imgui_textureBudget = 256;	// Video memory budget for textures in MB, 0 for unlimited
+
+	int imgui_pacing = 0;		// A FrameTimer::PacingMode, 0 for vsync, 1 uncapped and 2 the target frame rate
+	int imgui_targetFPS = 60;	// Frame rate held in the target pacing mode
+	int imgui_tickRate = 60;	// Simulation ticks per second, independent of the frame rate
+
+	unsigned int m_locationQueries = 0;	// glGetUniformLocation calls made during the last frame
+
+	float m_averageFrameTime = 0;	// Smoothed frame time in ms while no shader reload is in flight
+	float m_reloadFrameTime = 0;	// Longest frame in ms while a shader reload was in flight
+
+	int imgui_specialiseShaders = 1;	// Use shader variants with the light count baked in, 0 for the generic variants
+	int imgui_separablePrograms = 0;	// Draw with program pipelines sharing one vertex stage, 0 for fully linked programs
+
+	bool imgui_gpuProfiler = false;	// Show the GPU profiler window
+	int imgui_cpuZoneCount = 10;	// CPU zones listed, slowest first
+	int imgui_traceFrames = 60;		// Most recent frames written to the CPU trace
+
+	float m_shaderSetupTime = 0;	// Time in ms to compile and link the startup programs
+	float m_shaderLoadTime = 0;		// Time in ms spent reading and expanding shader sources at startup
+	unsigned int m_shaderFileReads = 0;	// Shader files read from disk at startup, the rest came from the source cache
+	unsigned int m_shaderCacheHits = 0;	// Shader file loads served from the source cache at startup
+	float m_stressSerialTime = 0;	// Time in ms to build 100 variants waiting on each link
+	float m_stressBatchTime = 0;	// Time in ms to build 100 variants submitted as one batch
+	float m_stressPipelineTime = 0;	// Time in ms to build 100 variants as pipelines sharing a vertex stage
+
+	float m_namedBindTime = 0;		// CPU time in us to set a phong draw's uniforms by name
+	float m_generatedBindTime = 0;	// CPU time in us to set them through the generated bindings
+
+	float m_queueFrameTimes[3] = { 0, 0, 0 };	// CPU time in ms per frame to submit, sort and draw 1, 100 and 10,000 objects
+	aie::RenderQueue::Stats m_queueStats[3];	// State changes and timings of the last frame at each object count
+
+	float m_instancingFrameTimes[5][2] = {};	// Time in ms per frame, waiting for the GPU, at 1 to 100,000 objects drawn one at a time and instanced
+	float m_instancingSubmitTimes[5][2] = {};	// CPU time in ms per frame to submit, sort and execute the same
+	unsigned int m_instancingDrawCounts[5][2] = {};	// Draw calls per frame for the same
+	float m_instancingUploadTimes[5] = {};		// Time in ms to fill the instance buffers at each count
+
+	float m_indirectFrameTimes[3][3] = {};	// Time in ms per frame, waiting for the GPU, at 1,000, 10,000 and 100,000 objects per object, instanced and multi-draw
+	float m_indirectSubmitTimes[3][3] = {};	// CPU time in ms per frame to submit, record, sort and execute the same
+	unsigned int m_indirectDrawCounts[3][3] = {};	// Draw calls per frame for the same
+
+	unsigned int m_indirectBatchCount = 0;		// Multi-draw batches in the scene
+	unsigned int m_indirectMaterialBatches = 0;	// Of those, the batches added by splitting by material, beyond one per variant and render material
+
+	unsigned int m_recordThreadCounts[5] = {};	// Thread counts measured, powers of two up to the core count, 0 for unused slots
+	float m_recordFrameTimes[3][5] = {};	// CPU time in ms per frame drawing 1,000, 10,000 and 100,000 objects at each thread count
+	float m_recordTimes[3][5] = {};			// Time in ms per frame spent recording the same
+
+	float m_cullRates[3][3] = {};	// Spheres culled per ms at 10,000, 100,000 and 1,000,000 spheres, scalar, SIMD and SIMD across threads
+	float m_cullVisibleFraction = 0;	// Fraction of the random spheres inside the frustum during the measurement
 };
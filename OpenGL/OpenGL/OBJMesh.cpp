@@ -1,21 +1,50 @@
 #include "OBJMesh.h"
 #include "gl_core_4_4.h"
+#include "GLState.h"
+#include "InstanceBuffer.h"
+#include "Shader.h"
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 namespace aie {
 
+// only textures up to this size are packed, larger ones gain little from sharing a binding
+static const unsigned int ATLAS_MAX_TEXTURE_SIZE = 512;
+static const unsigned int ATLAS_PAGE_SIZE = 4096;
+
+// packed mips are capped as every extra level doubles the gutter around each texture
+static const unsigned int ATLAS_MAX_LEVELS = 5;
+
+// the texture a material binds to each slot
+static const Texture& getSlotTexture(const OBJMesh::Material& material, unsigned int slot) {
+	switch (slot) {
+	case 0:	return material.diffuseTexture;
+	case 1:	return material.alphaTexture;
+	case 2:	return material.ambientTexture;
+	case 3:	return material.specularTexture;
+	case 4:	return material.specularHighlightTexture;
+	case 5:	return material.normalTexture;
+	default:	return material.displacementTexture;
+	};
+}
+
 OBJMesh::~OBJMesh() {
 	for (auto& c : m_meshChunks) {
+		GLState::removeVertexArray(c.vao);
+		GLState::removeBuffer(c.vbo);
 		glDeleteVertexArrays(1, &c.vao);
 		glDeleteBuffers(1, &c.vbo);
 		glDeleteBuffers(1, &c.ibo);
 	}
 }
 
-bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */) {
+bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool flipTextureV /* = false */, bool packTextures /* = false */) {
 
 	if (m_meshChunks.empty() == false) {
 		printf("Mesh already initialised, can't re-initialise!\n");
@@ -51,20 +80,53 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		m_materials[index].specularPower = m.shininess;
 		m_materials[index].opacity = m.dissolve;
 
-		// textures
-		m_materials[index].alphaTexture.load((folder + m.alpha_texname).c_str());
-		m_materials[index].ambientTexture.load((folder + m.ambient_texname).c_str());
-		m_materials[index].diffuseTexture.load((folder + m.diffuse_texname).c_str());
-		m_materials[index].specularTexture.load((folder + m.specular_texname).c_str());
-		m_materials[index].specularHighlightTexture.load((folder + m.specular_highlight_texname).c_str());
-		m_materials[index].normalTexture.load((folder + m.bump_texname).c_str());
-		m_materials[index].displacementTexture.load((folder + m.displacement_texname).c_str());
+		// textures (displacement is left uncompressed as block artifacts show up as geometry)
+		m_materials[index].alphaTexture.load((folder + m.alpha_texname).c_str(), Texture::LOAD_COMPRESSED | Texture::LOAD_LINEAR);
+		m_materials[index].ambientTexture.load((folder + m.ambient_texname).c_str(), Texture::LOAD_COMPRESSED);
+		m_materials[index].diffuseTexture.load((folder + m.diffuse_texname).c_str(), Texture::LOAD_COMPRESSED);
+		m_materials[index].specularTexture.load((folder + m.specular_texname).c_str(), Texture::LOAD_COMPRESSED);
+		m_materials[index].specularHighlightTexture.load((folder + m.specular_highlight_texname).c_str(), Texture::LOAD_COMPRESSED);
+		m_materials[index].normalTexture.load((folder + m.bump_texname).c_str(), Texture::LOAD_COMPRESSED | Texture::LOAD_NORMAL_MAP);
+		m_materials[index].displacementTexture.load((folder + m.displacement_texname).c_str(), Texture::LOAD_LINEAR);
 
 		++index;
 	}
 
+	// by default every material binds its own textures
+	m_materialTextures.resize(m_materials.size());
+	for (size_t i = 0; i < m_materials.size(); ++i) {
+		for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+			m_materialTextures[i].atlasHandles[slot] = 0;
+		m_materialTextures[i].packed = false;
+	}
+
+	if (packTextures) {
+
+		// a material can only be packed if all of its texture coordinates stay
+		// inside the texture, as an atlas can't repeat a single region
+		std::vector<bool> packable(m_materials.size(), true);
+		for (auto& s : shapes) {
+			if (s.mesh.material_ids.empty() ||
+				s.mesh.material_ids[0] < 0)
+				continue;
+
+			int materialID = s.mesh.material_ids[0];
+			if (s.mesh.texcoords.empty())
+				packable[materialID] = false;
+			for (auto t : s.mesh.texcoords) {
+				if (t < 0 || t > 1) {
+					packable[materialID] = false;
+					break;
+				}
+			}
+		}
+
+		packMaterialTextures(packable);
+	}
+
 	// copy shapes
 	m_meshChunks.reserve(shapes.size());
+	bool firstVertex = true;
 	for (auto& s : shapes) {
 
 		MeshChunk chunk;
@@ -75,7 +137,7 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		glGenVertexArrays(1, &chunk.vao);
 
 		// bind vertex array aka a mesh wrapper
-		glBindVertexArray(chunk.vao);
+		GLState::bindVertexArray(chunk.vao);
 
 		// set the index buffer data
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ibo);
@@ -96,8 +158,13 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		bool hasTexture = s.mesh.texcoords.empty() == false;
 
 		for (size_t i = 0; i < vertCount; ++i) {
-			if (hasPosition)
+			if (hasPosition) {
 				vertices[i].position = glm::vec4(s.mesh.positions[i * 3 + 0], s.mesh.positions[i * 3 + 1], s.mesh.positions[i * 3 + 2], 1);
+				glm::vec3 position(vertices[i].position);
+				m_boundsMin = firstVertex ? position : glm::min(m_boundsMin, position);
+				m_boundsMax = firstVertex ? position : glm::max(m_boundsMax, position);
+				firstVertex = false;
+			}
 			if (hasNormal)
 				vertices[i].normal = glm::vec4(s.mesh.normals[i * 3 + 0], s.mesh.normals[i * 3 + 1], s.mesh.normals[i * 3 + 2], 0);
 
@@ -108,12 +175,24 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 				vertices[i].texcoord = glm::vec2(vertices[i].position.x, vertices[i].position.z);
 		}
 
+		// set chunk material
+		chunk.materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
+		chunk.instanceBufferID = 0;
+
 		// calculate for normal mapping
 		if (hasNormal && hasTexture)
 			calculateTangents(vertices, s.mesh.indices);
 
+		// move texture coordinates in to the material's atlas region
+		if (chunk.materialID >= 0 &&
+			m_materialTextures[chunk.materialID].packed) {
+			const TextureAtlas::Region& region = m_materialTextures[chunk.materialID].region;
+			for (auto& v : vertices)
+				v.texcoord = v.texcoord * region.scale + region.offset;
+		}
+
 		// bind vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
 
 		// fill vertex buffer
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
@@ -135,13 +214,10 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(sizeof(glm::vec4) * 2 + sizeof(glm::vec2)));
 
 		// bind 0 for safety
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GLState::bindVertexArray(0);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-		// set chunk material
-		chunk.materialID = s.mesh.material_ids.empty() ? -1 : s.mesh.material_ids[0];
-
 		m_meshChunks.push_back(chunk);
 	}
 	
@@ -150,46 +226,96 @@ bool OBJMesh::load(const char* filename, bool loadTextures /* = true */, bool fl
 }
 
 void OBJMesh::draw(bool usePatches /* = false */) {
+	drawChunks(nullptr, usePatches);
+}
+
+void OBJMesh::drawInstanced(const InstanceBuffer& instances, bool usePatches /* = false */) {
+	drawChunks(&instances, usePatches);
+}
 
-	int program = -1;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+void OBJMesh::getMaterialUniforms(ShaderProgram& program, MaterialUniforms& uniforms) {
 
-	if (program == -1) {
+	// pull uniforms from the shader's location table
+	uniforms.ka = program.getUniform("Ka");
+	uniforms.kd = program.getUniform("Kd");
+	uniforms.ks = program.getUniform("Ks");
+	uniforms.ke = program.getUniform("Ke");
+	uniforms.opacity = program.getUniform("opacity");
+	uniforms.specularPower = program.getUniform("specularPower");
+
+	// sampler uniforms in slot order
+	static const UniformName textureUniformNames[TEXTURE_SLOT_COUNT] = {
+		"diffuseTexture", "alphaTexture", "ambientTexture", "specularTexture",
+		"specularHighlightTexture", "normalTexture", "displacementTexture"
+	};
+
+	// set texture slots (these don't change per material)
+	for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+		uniforms.textures[slot] = program.getUniform(textureUniformNames[slot]);
+		if (uniforms.textures[slot] >= 0)
+			program.bindUniform(uniforms.textures[slot], (int)slot);
+	}
+}
+
+void OBJMesh::applyMaterial(ShaderProgram& program, const MaterialUniforms& uniforms, int materialID) {
+	const Material& material = m_materials[materialID];
+	if (uniforms.ka >= 0)
+		program.bindUniform(uniforms.ka, material.ambient);
+	if (uniforms.kd >= 0)
+		program.bindUniform(uniforms.kd, material.diffuse);
+	if (uniforms.ks >= 0)
+		program.bindUniform(uniforms.ks, material.specular);
+	if (uniforms.ke >= 0)
+		program.bindUniform(uniforms.ke, material.emissive);
+	if (uniforms.opacity >= 0)
+		program.bindUniform(uniforms.opacity, material.opacity);
+	if (uniforms.specularPower >= 0)
+		program.bindUniform(uniforms.specularPower, material.specularPower);
+
+	for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+		// unpacked textures may have been evicted, so are reloaded as they're bound
+		const MaterialTextures& binding = m_materialTextures[materialID];
+		unsigned int handle = binding.packed ? binding.atlasHandles[slot] :
+			getSlotTexture(material, slot).makeResident();
+
+		// empty slots are only cleared if the shader samples them
+		if (handle == 0 && uniforms.textures[slot] < 0)
+			continue;
+
+		// materials sharing an atlas, or textures from the last draw, aren't rebound
+		if (GLState::bindTexture(slot, handle))
+			++m_textureBindCount;
+	}
+}
+
+void OBJMesh::bindMaterial(int materialID) {
+	ShaderProgram* program = ShaderProgram::getBound();
+	if (program == nullptr) {
 		printf("No shader bound!\n");
 		return;
 	}
 
-	// pull uniforms from the shader
-	int kaUniform = glGetUniformLocation(program, "Ka");
-	int kdUniform = glGetUniformLocation(program, "Kd");
-	int ksUniform = glGetUniformLocation(program, "Ks");
-	int keUniform = glGetUniformLocation(program, "Ke");
-	int opacityUniform = glGetUniformLocation(program, "opacity");
-	int specPowUniform = glGetUniformLocation(program, "specularPower");
-
-	int alphaTexUniform = glGetUniformLocation(program, "alphaTexture");
-	int ambientTexUniform = glGetUniformLocation(program, "ambientTexture");
-	int diffuseTexUniform = glGetUniformLocation(program, "diffuseTexture");
-	int specTexUniform = glGetUniformLocation(program, "specularTexture");
-	int specHighlightTexUniform = glGetUniformLocation(program, "specularHighlightTexture");
-	int normalTexUniform = glGetUniformLocation(program, "normalTexture");
-	int dispTexUniform = glGetUniformLocation(program, "displacementTexture");
+	MaterialUniforms uniforms;
+	getMaterialUniforms(*program, uniforms);
+	if (materialID >= 0)
+		applyMaterial(*program, uniforms, materialID);
+}
 
-	// set texture slots (these don't change per material)
-	if (diffuseTexUniform >= 0)
-		glUniform1i(diffuseTexUniform, 0);
-	if (alphaTexUniform >= 0)
-		glUniform1i(alphaTexUniform, 1);
-	if (ambientTexUniform >= 0)
-		glUniform1i(ambientTexUniform, 2);
-	if (specTexUniform >= 0)
-		glUniform1i(specTexUniform, 3);
-	if (specHighlightTexUniform >= 0)
-		glUniform1i(specHighlightTexUniform, 4);
-	if (normalTexUniform >= 0)
-		glUniform1i(normalTexUniform, 5);
-	if (dispTexUniform >= 0)
-		glUniform1i(dispTexUniform, 6);
+void OBJMesh::drawChunks(const InstanceBuffer* instances, bool usePatches) {
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	m_textureBindCount = 0;
+
+	// draws with the program last bound through ShaderProgram, avoiding a glGet round trip
+	ShaderProgram* program = ShaderProgram::getBound();
+
+	if (program == nullptr) {
+		printf("No shader bound!\n");
+		return;
+	}
+
+	MaterialUniforms uniforms;
+	getMaterialUniforms(*program, uniforms);
 
 	int currentMaterial = -1;
 
@@ -197,70 +323,123 @@ void OBJMesh::draw(bool usePatches /* = false */) {
 	for (auto& c : m_meshChunks) {
 
 		// bind material
-		if (currentMaterial != c.materialID) {
+		if (c.materialID >= 0 &&
+			currentMaterial != c.materialID) {
 			currentMaterial = c.materialID;
-			if (kaUniform >= 0)
-				glUniform3fv(kaUniform, 1, &m_materials[currentMaterial].ambient[0]);
-			if (kdUniform >= 0)
-				glUniform3fv(kdUniform, 1, &m_materials[currentMaterial].diffuse[0]);
-			if (ksUniform >= 0)
-				glUniform3fv(ksUniform, 1, &m_materials[currentMaterial].specular[0]);
-			if (keUniform >= 0)
-				glUniform3fv(keUniform, 1, &m_materials[currentMaterial].emissive[0]);
-			if (opacityUniform >= 0)
-				glUniform1f(opacityUniform, m_materials[currentMaterial].opacity);
-			if (specPowUniform >= 0)
-				glUniform1f(specPowUniform, m_materials[currentMaterial].specularPower);
-
-			glActiveTexture(GL_TEXTURE0);
-			if (m_materials[currentMaterial].diffuseTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].diffuseTexture.getHandle());
-			else if (diffuseTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE1);
-			if (m_materials[currentMaterial].alphaTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].alphaTexture.getHandle());
-			else if (alphaTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE2);
-			if (m_materials[currentMaterial].ambientTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].ambientTexture.getHandle());
-			else if (ambientTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE3);
-			if (m_materials[currentMaterial].specularTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularTexture.getHandle());
-			else if (specTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE4);
-			if (m_materials[currentMaterial].specularHighlightTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].specularHighlightTexture.getHandle());
-			else if (specHighlightTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE5);
-			if (m_materials[currentMaterial].normalTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].normalTexture.getHandle());
-			else if (normalTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-			glActiveTexture(GL_TEXTURE6);
-			if (m_materials[currentMaterial].displacementTexture.getHandle() > 0)
-				glBindTexture(GL_TEXTURE_2D, m_materials[currentMaterial].displacementTexture.getHandle());
-			else if (dispTexUniform >= 0)
-				glBindTexture(GL_TEXTURE_2D, 0);
+			applyMaterial(*program, uniforms, currentMaterial);
 		}
 
 		// bind and draw geometry
-		glBindVertexArray(c.vao);
-		if (usePatches)
-			glDrawElements(GL_PATCHES, c.indexCount, GL_UNSIGNED_INT, 0);
-		else
-			glDrawElements(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT, 0);
+		GLState::bindVertexArray(c.vao);
+		GLenum mode = usePatches ? GL_PATCHES : GL_TRIANGLES;
+		if (instances == nullptr) {
+			glDrawElements(mode, c.indexCount, GL_UNSIGNED_INT, 0);
+			continue;
+		}
+
+		// the attributes stay in the vertex array, so they're only set when the buffer changes
+		if (c.instanceBufferID != instances->getID()) {
+			instances->attach();
+			c.instanceBufferID = instances->getID();
+		}
+		glDrawElementsInstanced(mode, c.indexCount, GL_UNSIGNED_INT, 0, (GLsizei)instances->getCount());
+	}
+
+	m_drawTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+void OBJMesh::packMaterialTextures(const std::vector<bool>& packable) {
+
+	// group materials whose textures share one size and whose slots share formats,
+	// as every slot of a group is packed with the same layout
+	std::map<std::vector<unsigned int>, std::vector<size_t>> groups;
+	for (size_t i = 0; i < m_materials.size(); ++i) {
+		if (packable[i] == false)
+			continue;
+
+		std::vector<unsigned int> key(2 + TEXTURE_SLOT_COUNT, 0);
+		bool compatible = true;
+		bool hasTexture = false;
+		for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT && compatible; ++slot) {
+			const Texture& texture = getSlotTexture(m_materials[i], slot);
+			if (texture.getHandle() == 0)
+				continue;
+
+			if (hasTexture == false) {
+				key[0] = texture.getWidth();
+				key[1] = texture.getHeight();
+				hasTexture = true;
+			}
+			compatible = texture.getWidth() == key[0] &&
+				texture.getHeight() == key[1] &&
+				texture.getWidth() <= ATLAS_MAX_TEXTURE_SIZE &&
+				texture.getHeight() <= ATLAS_MAX_TEXTURE_SIZE;
+			key[2 + slot] = texture.getInternalFormat();
+		}
+
+		if (hasTexture && compatible)
+			groups[key].push_back(i);
+	}
+
+	for (auto& group : groups) {
+		const std::vector<unsigned int>& key = group.first;
+		const std::vector<size_t>& materials = group.second;
+
+		// a single material already binds once
+		if (materials.size() < 2)
+			continue;
+
+		// pack using the strictest alignment of any slot
+		unsigned int levelCount = ATLAS_MAX_LEVELS;
+		bool compressed = false;
+		for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot) {
+			if (key[2 + slot] == 0)
+				continue;
+			for (auto m : materials) {
+				const Texture& texture = getSlotTexture(m_materials[m], slot);
+				levelCount = std::min(levelCount, texture.getMipLevelCount());
+				compressed |= texture.isCompressed();
+			}
+		}
+
+		TextureAtlas packing;
+		std::vector<glm::uvec2> sizes(materials.size(), glm::uvec2(key[0], key[1]));
+		if (packing.layout(sizes, ATLAS_PAGE_SIZE, levelCount, compressed) == false) {
+			printf("Unable to pack %u materials of %s in to an atlas\n", (unsigned int)materials.size(), m_filename.c_str());
+			continue;
+		}
+
+		// build one atlas per used slot, the group is only packed if every slot succeeds
+		std::vector<std::unique_ptr<TextureAtlas>> atlases(TEXTURE_SLOT_COUNT);
+		bool built = true;
+		for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT && built; ++slot) {
+			if (key[2 + slot] == 0)
+				continue;
+
+			std::vector<const Texture*> textures;
+			for (auto m : materials)
+				textures.push_back(&getSlotTexture(m_materials[m], slot));
+
+			atlases[slot].reset(new TextureAtlas());
+			atlases[slot]->copyLayout(packing);
+			built = atlases[slot]->build(textures);
+		}
+
+		if (built == false)
+			continue;
+
+		for (size_t i = 0; i < materials.size(); ++i) {
+			MaterialTextures& binding = m_materialTextures[materials[i]];
+			for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; ++slot)
+				binding.atlasHandles[slot] = atlases[slot] ? atlases[slot]->getHandle() : 0;
+			binding.region = packing.getRegion(i);
+			binding.packed = true;
+		}
+
+		for (auto& atlas : atlases) {
+			if (atlas)
+				m_atlases.push_back(std::move(atlas));
+		}
 	}
 }
 
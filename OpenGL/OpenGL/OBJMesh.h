@@ -3,12 +3,18 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 #include "Texture.h"
+#include "TextureAtlas.h"
 
 namespace aie {
 
+class InstanceBuffer;
+class ShaderProgram;
+
 // a simple triangle mesh wrapper
 class OBJMesh {
 public:
@@ -47,35 +53,98 @@ public:
 		Texture displacementTexture;		// bound slot 6
 	};
 
-	OBJMesh() {}
+	// number of texture slots a material binds
+	static const unsigned int TEXTURE_SLOT_COUNT = 7;
+
+	// a shape's geometry, drawn with one material
+	struct MeshChunk {
+		unsigned int	vao, vbo, ibo;
+		unsigned int	indexCount;
+		int				materialID;
+
+		// id of the instance buffer the vertex array's instance attributes point at, 0 for none
+		unsigned int	instanceBufferID;
+	};
+
+	OBJMesh() : m_boundsMin(0), m_boundsMax(0), m_textureBindCount(0), m_drawTime(0) {}
 	~OBJMesh();
 
-	// will fail if a mesh has already been loaded in to this instance
-	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false);
+	// will fail if a mesh has already been loaded in to this instance.
+	// packTextures combines the small textures of compatible materials in to shared
+	// atlases and rewrites texture coordinates so those materials draw without rebinding
+	bool load(const char* filename, bool loadTextures = true, bool flipTextureV = false, bool packTextures = false);
 
 	// allow option to draw as patches for tessellation
 	void draw(bool usePatches = false);
 
+	// draws every instance in the buffer with one draw call per chunk. The bound program must
+	// be an INSTANCED variant, which reads its transforms from the buffer instead of uniforms
+	void drawInstanced(const InstanceBuffer& instances, bool usePatches = false);
+
+	// binds a material's values and textures to the bound program, as draw() does before each
+	// chunk, for chunks drawn from elsewhere such as a MeshPool. -1 only sets the texture slots
+	void bindMaterial(int materialID);
+
+	// the chunks' buffers, for copying their geometry elsewhere
+	size_t getChunkCount() const { return m_meshChunks.size(); }
+	const MeshChunk& getChunk(size_t index) const { return m_meshChunks[index]; }
+
 	// access to the filename that was loaded
 	const std::string& getFilename() const { return m_filename; }
 
+	// a sphere around every vertex, in the mesh's own space, for culling
+	glm::vec3 getBoundsCentre() const { return (m_boundsMin + m_boundsMax) * 0.5f; }
+	float getBoundsRadius() const { return glm::length(m_boundsMax - m_boundsMin) * 0.5f; }
+
 	// material access
 	size_t getMaterialCount() const { return m_materials.size();  }
 	Material& getMaterial(size_t index) { return m_materials[index];  }
 
+	// atlases built by packTextures, one per packed group and texture slot
+	size_t getAtlasCount() const { return m_atlases.size(); }
+	const TextureAtlas& getAtlas(size_t index) const { return *m_atlases[index]; }
+
+	// texture binds issued and CPU time spent by the last draw, in milliseconds
+	unsigned int getTextureBindCount() const { return m_textureBindCount; }
+	float getDrawTime() const { return m_drawTime; }
+
 private:
 
+	// binds materials and draws each chunk, instanced when instances isn't null
+	void drawChunks(const InstanceBuffer* instances, bool usePatches);
+
+	// a program's material uniform locations, -1 for those it doesn't use
+	struct MaterialUniforms {
+		int	ka, kd, ks, ke, opacity, specularPower;
+		int	textures[TEXTURE_SLOT_COUNT];
+	};
+
+	// looks the locations up and points the samplers at their slots
+	static void getMaterialUniforms(ShaderProgram& program, MaterialUniforms& uniforms);
+	void applyMaterial(ShaderProgram& program, const MaterialUniforms& uniforms, int materialID);
+
 	void calculateTangents(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
 
-	struct MeshChunk {
-		unsigned int	vao, vbo, ibo;
-		unsigned int	indexCount;
-		int				materialID;
+	// packs the textures of materials flagged as packable, filling in m_materialTextures
+	void packMaterialTextures(const std::vector<bool>& packable);
+
+	// the atlases a packed material binds in place of its own textures
+	struct MaterialTextures {
+		unsigned int	atlasHandles[TEXTURE_SLOT_COUNT];
+		bool			packed;
+		TextureAtlas::Region	region;
 	};
 
 	std::string				m_filename;
+	glm::vec3				m_boundsMin, m_boundsMax;
 	std::vector<MeshChunk>	m_meshChunks;
 	std::vector<Material>	m_materials;
+
+	std::vector<MaterialTextures>				m_materialTextures;
+	std::vector<std::unique_ptr<TextureAtlas>>	m_atlases;
+
+	unsigned int	m_textureBindCount;
+	float			m_drawTime;
 };
 
 } // namespace aie
\ No newline at end of file
@@ -5,22 +5,32 @@
 #include <iostream>
 #include "MyApplication.h"
 
-int main()
+int main(int argc, char* argv[])
 {
 	// allocation
 	MyApplication* app = new MyApplication();
 
+	// --headless runs a fixed number of frames offscreen and exits, for benchmarks and CI
+	int result = 0;
+	if (app->parseCommandLine(argc, argv) == false)
+		result = 1;
+
 	// initialise and loop
-	if (app->startup() == 0) 
+	else if (app->startup() == 0) 
 	{
-		while (app->update() == true) { }
+		if (app->isHeadless())
+			result = app->runHeadless();
+		else
+			while (app->update() == true) { }
 		app->shutdown();
 	}
+	else
+		result = 2;
 
 	// deallocation
 	delete app;
 
-	return 0;
+	return result;
 }
 
 // Run program: Ctrl + F5 or Debug > Start Without Debugging menu
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace aie {
+
+// splits the range [0, count) into contiguous chunks and runs each chunk on its own thread,
+// returning once every index has been processed
+template <typename Function>
+void parallelFor(unsigned int count, const Function& function) {
+
+	unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, count);
+
+	if (threadCount <= 1) {
+		for (unsigned int i = 0; i < count; ++i)
+			function(i);
+		return;
+	}
+
+	unsigned int chunkSize = (count + threadCount - 1) / threadCount;
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for (unsigned int t = 0; t < threadCount; ++t) {
+		unsigned int begin = t * chunkSize;
+		unsigned int end = std::min(count, begin + chunkSize);
+		if (begin >= end)
+			break;
+		threads.emplace_back([begin, end, &function]() {
+			for (unsigned int i = begin; i < end; ++i)
+				function(i);
+		});
+	}
+
+	for (auto& t : threads)
+		t.join();
+}
+
+} // namespace aie
@@ -0,0 +1,326 @@
+#include "RenderQueue.h"
+#include "IndirectBatch.h"
+#include "InstanceBuffer.h"
+#include "Mesh.h"
+#include "OBJMesh.h"
+#include "Shader.h"
+#include "Texture.h"
+#include <glm/glm.hpp>
+#include <cassert>
+
+namespace aie {
+
+RenderQueue::RenderQueue()
+	: m_depthRange(1000),
+	m_activeListCount(1),
+	m_sorted(false),
+	m_submitTime(0),
+	m_recordTime(0),
+	m_recordThreads(0) {
+	m_lists.emplace_back(new CommandList());
+}
+
+void RenderQueue::begin(const glm::mat4& view, const glm::mat4& projection, float depthRange) {
+	m_view = view;
+	m_projectionView = projection * view;
+	m_depthRange = depthRange;
+
+	m_lists[0]->begin(m_view, m_projectionView, m_depthRange);
+	m_activeListCount = 1;
+	m_packets.clear();
+	m_sorted = false;
+	m_submitTime = 0;
+	m_recordTime = 0;
+	m_recordThreads = 0;
+}
+
+void RenderQueue::resetHandles() {
+	m_programIndices.clear();
+	m_materialIndices.clear();
+	m_meshIndices.clear();
+	m_instanceIndices.clear();
+
+	m_programs.clear();
+	m_materials.clear();
+	m_meshes.clear();
+	m_instances.clear();
+
+	// recorded commands would refer to handles that no longer exist
+	m_lists[0]->begin(m_view, m_projectionView, m_depthRange);
+	m_activeListCount = 1;
+	m_packets.clear();
+	m_sorted = false;
+}
+
+ProgramHandle RenderQueue::getProgramHandle(ShaderProgram* program) {
+	assert(program != nullptr);
+	ProgramHandle handle;
+	auto iter = m_programIndices.find(program);
+	if (iter != m_programIndices.end()) {
+		handle.index = iter->second;
+		return handle;
+	}
+
+	ProgramEntry entry;
+	entry.program = program;
+	entry.projectionViewModel = program->getUniform("ProjectionViewModel");
+	entry.modelMatrix = program->getUniform("ModelMatrix");
+	entry.normalMatrix = program->getUniform("NormalMatrix");
+
+	handle.index = (unsigned int)m_programs.size();
+	m_programs.push_back(entry);
+	m_programIndices[program] = handle.index;
+	return handle;
+}
+
+MaterialHandle RenderQueue::getMaterialHandle(const RenderMaterial* material) {
+	MaterialHandle handle;
+	auto iter = m_materialIndices.find(material);
+	if (iter != m_materialIndices.end()) {
+		handle.index = iter->second;
+		return handle;
+	}
+
+	// a null material is a handle like any other, it just applies nothing
+	handle.index = (unsigned int)m_materials.size();
+	m_materials.push_back(material);
+	m_materialIndices[material] = handle.index;
+	return handle;
+}
+
+MeshHandle RenderQueue::getMeshHandle(Mesh* mesh) {
+	assert(mesh != nullptr);
+	MeshHandle handle;
+	auto iter = m_meshIndices.find(mesh);
+	if (iter != m_meshIndices.end()) {
+		handle.index = iter->second;
+		return handle;
+	}
+
+	handle.index = (unsigned int)m_meshes.size();
+	m_meshes.push_back({ mesh, nullptr, nullptr });
+	m_meshIndices[mesh] = handle.index;
+	return handle;
+}
+
+MeshHandle RenderQueue::getMeshHandle(OBJMesh* mesh) {
+	assert(mesh != nullptr);
+	MeshHandle handle;
+	auto iter = m_meshIndices.find(mesh);
+	if (iter != m_meshIndices.end()) {
+		handle.index = iter->second;
+		return handle;
+	}
+
+	handle.index = (unsigned int)m_meshes.size();
+	m_meshes.push_back({ nullptr, mesh, nullptr });
+	m_meshIndices[mesh] = handle.index;
+	return handle;
+}
+
+MeshHandle RenderQueue::getMeshHandle(IndirectBatch* batch) {
+	assert(batch != nullptr);
+	MeshHandle handle;
+	auto iter = m_meshIndices.find(batch);
+	if (iter != m_meshIndices.end()) {
+		handle.index = iter->second;
+		return handle;
+	}
+
+	handle.index = (unsigned int)m_meshes.size();
+	m_meshes.push_back({ nullptr, nullptr, batch });
+	m_meshIndices[batch] = handle.index;
+	return handle;
+}
+
+InstancesHandle RenderQueue::getInstancesHandle(const InstanceBuffer* instances) {
+	assert(instances != nullptr);
+	InstancesHandle handle;
+	auto iter = m_instanceIndices.find(instances);
+	if (iter != m_instanceIndices.end()) {
+		handle.index = iter->second;
+		return handle;
+	}
+
+	handle.index = (unsigned int)m_instances.size();
+	m_instances.push_back(instances);
+	m_instanceIndices[instances] = handle.index;
+	return handle;
+}
+
+void RenderQueue::submit(const Renderable& renderable, ShaderProgram* program) {
+	assert(program != nullptr);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ProgramHandle programHandle = getProgramHandle(program);
+	MaterialHandle materialHandle = getMaterialHandle(renderable.material);
+	MeshHandle meshHandle = renderable.mesh != nullptr ? getMeshHandle(renderable.mesh) :
+		renderable.batch != nullptr ? getMeshHandle(renderable.batch) : getMeshHandle(renderable.objMesh);
+
+	if (renderable.instances != nullptr)
+		m_lists[0]->drawInstanced(programHandle, materialHandle, meshHandle, getInstancesHandle(renderable.instances),
+								  renderable.transform, renderable.pass);
+	else
+		m_lists[0]->draw(programHandle, materialHandle, meshHandle, renderable.transform, renderable.pass);
+	m_sorted = false;
+
+	m_submitTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+CommandList** RenderQueue::beginRecording(unsigned int count) {
+	// lists are kept between frames so their buffers only grow once
+	while (m_lists.size() < m_activeListCount + count)
+		m_lists.emplace_back(new CommandList());
+
+	m_recordingLists.clear();
+	for (unsigned int i = 0; i < count; ++i) {
+		CommandList* list = m_lists[m_activeListCount + i].get();
+		list->begin(m_view, m_projectionView, m_depthRange);
+		m_recordingLists.push_back(list);
+	}
+	m_activeListCount += count;
+	return m_recordingLists.data();
+}
+
+size_t RenderQueue::getCommandCount() const {
+	size_t count = 0;
+	for (unsigned int list = 0; list < m_activeListCount; ++list)
+		count += m_lists[list]->getCommandCount();
+	return count;
+}
+
+void RenderQueue::sort() {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// every list's keys go in to one array, the sort puts them in a single order
+	m_packets.clear();
+	m_packets.reserve(getCommandCount());
+	for (unsigned int list = 0; list < m_activeListCount; ++list) {
+		const CommandList& commands = *m_lists[list];
+		for (size_t i = 0; i < commands.getCommandCount(); ++i)
+			m_packets.push_back({ commands.getCommand(i).key, list, (unsigned int)i });
+	}
+
+	// least significant byte first, each pass is stable so earlier passes' order is kept
+	size_t count = m_packets.size();
+	m_sortBuffer.resize(count);
+	DrawPacket* source = m_packets.data();
+	DrawPacket* destination = m_sortBuffer.data();
+
+	for (unsigned int shift = 0; shift < 64 && count > 1; shift += 8) {
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; ++i)
+			++offsets[(source[i].key >> shift) & 0xff];
+
+		// unused key bits, and ids only a few objects share, leave every key in one bucket
+		if (offsets[(source[0].key >> shift) & 0xff] == count)
+			continue;
+
+		size_t total = 0;
+		for (auto& o : offsets) {
+			size_t bucket = o;
+			o = total;
+			total += bucket;
+		}
+		for (size_t i = 0; i < count; ++i)
+			destination[offsets[(source[i].key >> shift) & 0xff]++] = source[i];
+		std::swap(source, destination);
+	}
+
+	if (source != m_packets.data())
+		m_packets.swap(m_sortBuffer);
+	m_sorted = true;
+
+	m_stats.sortTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void RenderQueue::applyMaterial(ShaderProgram& program, const RenderMaterial& material) {
+	for (auto& v : material.values)
+		program.bindUniform(v.location, v.value);
+	if (material.texture != nullptr)
+		material.texture->bind(material.textureUnit);
+}
+
+void RenderQueue::execute() {
+	PROFILE_ZONE("Execute Draws");
+	if (m_sorted == false)
+		sort();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	Stats stats;
+	stats.submitTime = m_submitTime;
+	stats.recordTime = m_recordTime;
+	stats.recordThreads = m_recordThreads;
+	stats.sortTime = m_stats.sortTime;
+
+	// handles are unique, unlike key ids which can be shared once a field runs out
+	const ProgramEntry* program = nullptr;
+	unsigned int material = ~0u;
+	unsigned int mesh = ~0u;
+
+	for (auto& packet : m_packets) {
+		const DrawCommand& command = m_lists[packet.list]->getCommand(packet.command);
+
+		if (program != &m_programs[command.program.index]) {
+			program = &m_programs[command.program.index];
+			program->program->bind();
+			++stats.programChanges;
+
+			// a new program holds none of the last material's values
+			material = ~0u;
+		}
+
+		if (command.material.index != material) {
+			material = command.material.index;
+			if (m_materials[material] != nullptr)
+				applyMaterial(*program->program, *m_materials[material]);
+			++stats.materialChanges;
+		}
+
+		if (command.mesh.index != mesh) {
+			mesh = command.mesh.index;
+			++stats.meshChanges;
+		}
+
+		const MeshEntry& meshEntry = m_meshes[command.mesh.index];
+		++stats.drawCount;
+
+		// every draw in a batch goes in one multi-draw, reading its transform like an instance
+		if (meshEntry.batch != nullptr) {
+			meshEntry.batch->draw();
+			stats.instanceCount += (unsigned int)meshEntry.batch->getUploadedCount();
+			continue;
+		}
+
+		// instanced programs read their transforms from the instance buffer and the frame data
+		if (command.instances.isValid()) {
+			const InstanceBuffer& instances = *m_instances[command.instances.index];
+			if (meshEntry.mesh != nullptr)
+				meshEntry.mesh->drawInstanced(instances);
+			else
+				meshEntry.objMesh->drawInstanced(instances);
+			stats.instanceCount += (unsigned int)instances.getCount();
+			continue;
+		}
+
+		// the values were worked out while recording, only the uniform calls are left
+		if (program->projectionViewModel >= 0)
+			program->program->bindUniform(program->projectionViewModel, command.projectionViewModel);
+		if (program->modelMatrix >= 0)
+			program->program->bindUniform(program->modelMatrix, command.modelMatrix);
+		if (program->normalMatrix >= 0)
+			program->program->bindUniform(program->normalMatrix, command.normalMatrix);
+
+		// meshes skip their own vertex array binds when the last draw used the same one
+		if (meshEntry.mesh != nullptr)
+			meshEntry.mesh->draw();
+		else
+			meshEntry.objMesh->draw();
+		++stats.instanceCount;
+	}
+
+	stats.executeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	m_stats = stats;
+}
+
+} // namespace aie
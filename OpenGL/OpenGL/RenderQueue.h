@@ -0,0 +1,202 @@
+#pragma once
+
+#include "CommandList.h"
+#include "CPUProfiler.h"
+#include "Parallel.h"
+#include <glm/mat4x4.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Mesh;
+
+namespace aie {
+
+class IndirectBatch;
+class InstanceBuffer;
+class OBJMesh;
+class ShaderProgram;
+class Texture;
+
+// uniform values and a texture shared by everything drawn with it, applied once for each run
+// of draws using it. Locations come from the generated shader bindings
+struct RenderMaterial {
+
+	struct Value {
+		int		location;
+		float	value;
+	};
+
+	std::vector<Value>	values;
+
+	const Texture*	texture = nullptr;
+	unsigned int	textureUnit = 0;
+};
+
+// a mesh drawn with a material and transform. Only one of mesh, objMesh or batch is set. With
+// instances set every instance in the buffer is drawn at once, by an INSTANCED program, and
+// transform only places the group for depth sorting. Batches draw the same way, each of their
+// draws has its own transform
+struct Renderable {
+	Mesh*					mesh = nullptr;
+	OBJMesh*				objMesh = nullptr;
+	IndirectBatch*			batch = nullptr;
+	const RenderMaterial*	material = nullptr;
+	const InstanceBuffer*	instances = nullptr;
+	glm::mat4				transform = glm::mat4(1);
+	unsigned int			pass = 0;
+};
+
+// collects a frame's draws as commands with 64 bit sort keys, radix sorts them and draws them
+// in order, only changing the program, material and mesh when the next command needs it.
+// Draws are recorded in to command lists, either by submit() on the render thread or by
+// record() across threads, and are merged in key order before they're replayed as GL calls
+class RenderQueue {
+public:
+
+	// state changes and CPU time, in milliseconds, of the last execute()
+	struct Stats {
+		unsigned int	drawCount = 0;
+		unsigned int	instanceCount = 0;	// objects drawn, counting each instance
+		unsigned int	programChanges = 0;
+		unsigned int	materialChanges = 0;
+		unsigned int	meshChanges = 0;
+		unsigned int	recordThreads = 0;	// most threads a record() used
+		float			submitTime = 0;
+		float			recordTime = 0;		// wall time of every record(), threads included
+		float			sortTime = 0;		// merging the command lists and sorting them
+		float			executeTime = 0;
+	};
+
+	RenderQueue();
+
+	RenderQueue(const RenderQueue&) = delete;
+	RenderQueue& operator = (const RenderQueue&) = delete;
+
+	// starts a frame, dropping any commands not executed. Depth is quantised over depthRange
+	void begin(const glm::mat4& view, const glm::mat4& projection, float depthRange = 1000);
+
+	// handles for command lists, render thread only. Each object gets the same handle every
+	// time, so they can be looked up once and kept
+	ProgramHandle getProgramHandle(ShaderProgram* program);
+	MaterialHandle getMaterialHandle(const RenderMaterial* material);
+	MeshHandle getMeshHandle(Mesh* mesh);
+	MeshHandle getMeshHandle(OBJMesh* mesh);
+	MeshHandle getMeshHandle(IndirectBatch* batch);
+	InstancesHandle getInstancesHandle(const InstanceBuffer* instances);
+
+	// forgets every handle, for when the objects they were looked up from are freed. Handles
+	// kept from before must be looked up again, and nothing may be left to execute
+	void resetHandles();
+
+	// records a draw on the render thread, with the program the renderable's pipeline picked
+	void submit(const Renderable& renderable, ShaderProgram* program);
+
+	// splits [0, count) in to contiguous ranges and calls recorder(list, begin, end) for each
+	// on its own thread with its own command list, returning once all are recorded. Recorders
+	// get nothing that can reach GL, they turn their range in to draws from handles and plain
+	// data. threadCount 0 uses a thread per core, fewer for small counts
+	template <typename Recorder>
+	void record(unsigned int count, const Recorder& recorder, unsigned int threadCount = 0);
+
+	// merges the command lists and sorts them
+	void sort();
+
+	// draws every command in key order, sorting first if needed
+	void execute();
+
+	size_t getCommandCount() const;
+
+	const Stats& getStats() const { return m_stats; }
+
+private:
+
+	// auto thread counts give each thread at least this many draws to record
+	static const unsigned int MIN_RECORD_RANGE = 2048;
+
+	struct DrawPacket {
+		uint64_t		key;
+		unsigned int	list;
+		unsigned int	command;
+	};
+
+	// per object uniform locations, looked up by name when a program is given a handle
+	struct ProgramEntry {
+		ShaderProgram*	program;
+		int				projectionViewModel;
+		int				modelMatrix;
+		int				normalMatrix;
+	};
+
+	// one of the three is set
+	struct MeshEntry {
+		Mesh*			mesh;
+		OBJMesh*		objMesh;
+		IndirectBatch*	batch;
+	};
+
+	// the render thread's list followed by count lists begun for recording threads
+	CommandList** beginRecording(unsigned int count);
+
+	static void applyMaterial(ShaderProgram& program, const RenderMaterial& material);
+
+	glm::mat4	m_projectionView;
+	glm::mat4	m_view;
+	float		m_depthRange;
+
+	// list 0 is the render thread's, the rest are reused by recording threads
+	std::vector<std::unique_ptr<CommandList>>	m_lists;
+	std::vector<CommandList*>	m_recordingLists;
+	unsigned int				m_activeListCount;
+
+	std::vector<DrawPacket>	m_packets;
+	std::vector<DrawPacket>	m_sortBuffer;
+	bool					m_sorted;
+
+	std::unordered_map<ShaderProgram*, unsigned int>	m_programIndices;
+	std::unordered_map<const void*, unsigned int>		m_materialIndices;
+	std::unordered_map<const void*, unsigned int>		m_meshIndices;
+	std::unordered_map<const void*, unsigned int>		m_instanceIndices;
+
+	std::vector<ProgramEntry>			m_programs;
+	std::vector<const RenderMaterial*>	m_materials;
+	std::vector<MeshEntry>				m_meshes;
+	std::vector<const InstanceBuffer*>	m_instances;
+
+	float			m_submitTime;
+	float			m_recordTime;
+	unsigned int	m_recordThreads;
+	Stats			m_stats;
+};
+
+template <typename Recorder>
+void RenderQueue::record(unsigned int count, const Recorder& recorder, unsigned int threadCount /* = 0 */) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::min(threadCount, std::max(1u, count / MIN_RECORD_RANGE));
+	}
+	threadCount = std::max(1u, std::min(threadCount, std::max(1u, count)));
+
+	CommandList** lists = beginRecording(threadCount);
+	unsigned int rangeSize = (count + threadCount - 1) / threadCount;
+
+	parallelFor(threadCount, [&](unsigned int thread) {
+		PROFILE_ZONE("Record Draws");
+		unsigned int begin = std::min(count, thread * rangeSize);
+		unsigned int end = std::min(count, begin + rangeSize);
+		if (begin < end)
+			recorder(*lists[thread], begin, end);
+	});
+
+	m_sorted = false;
+	m_recordThreads = std::max(m_recordThreads, threadCount);
+	m_recordTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+} // namespace aie
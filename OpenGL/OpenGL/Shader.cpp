@@ -1,10 +1,66 @@
 #include "Shader.h"
+#include "GLState.h"
+#include "ShaderSource.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 #include "gl_core_4_4.h"
+#include <GLFW/glfw3.h>
+
+// GL_KHR_parallel_shader_compile isn't part of the core loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace aie {
 
+static unsigned int getShaderType(unsigned int stage) {
+	switch (stage) {
+	case eShaderStage::VERTEX:	return GL_VERTEX_SHADER;
+	case eShaderStage::TESSELLATION_EVALUATION:	return GL_TESS_EVALUATION_SHADER;
+	case eShaderStage::TESSELLATION_CONTROL:	return GL_TESS_CONTROL_SHADER;
+	case eShaderStage::GEOMETRY:	return GL_GEOMETRY_SHADER;
+	case eShaderStage::FRAGMENT:	return GL_FRAGMENT_SHADER;
+	default:	return 0;
+	};
+}
+
+static unsigned int getShaderStageBit(unsigned int stage) {
+	switch (stage) {
+	case eShaderStage::VERTEX:	return GL_VERTEX_SHADER_BIT;
+	case eShaderStage::TESSELLATION_EVALUATION:	return GL_TESS_EVALUATION_SHADER_BIT;
+	case eShaderStage::TESSELLATION_CONTROL:	return GL_TESS_CONTROL_SHADER_BIT;
+	case eShaderStage::GEOMETRY:	return GL_GEOMETRY_SHADER_BIT;
+	case eShaderStage::FRAGMENT:	return GL_FRAGMENT_SHADER_BIT;
+	default:	return 0;
+	};
+}
+
+// lets program status be polled without waiting for the driver to finish compiling
+static bool supportsParallelCompile() {
+	static int supported = -1;
+	if (supported < 0) {
+		supported = 0;
+		int count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (int i = 0; i < count && supported == 0; ++i) {
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension != nullptr &&
+				(strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+				 strcmp(extension, "GL_ARB_parallel_shader_compile") == 0))
+				supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+// frames to leave a reload compiling before its status is queried, when the driver can't
+// report completion. Drivers that compile on their own threads will usually have finished
+static const unsigned int RELOAD_POLL_DELAY = 3;
+
 Shader::~Shader() {
 	glDeleteShader(m_handle);
 }
@@ -13,44 +69,17 @@ bool Shader::loadShader(unsigned int stage, const char* filename) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 
 	m_stage = stage;
-
-	switch (stage) {
-	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
-	case eShaderStage::TESSELLATION_EVALUATION:	m_handle = glCreateShader(GL_TESS_EVALUATION_SHADER);	break;
-	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
-	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
-	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
-	default:	break;
-	};
+	m_handle = glCreateShader(getShaderType(stage));
 	
-	// open file
-	FILE* file = nullptr;
-	fopen_s(&file, filename, "rb");
-	fseek(file, 0, SEEK_END);
-	unsigned int size = ftell(file);
-	char* source = new char[size + 1];
-	fseek(file, 0, SEEK_SET);
-	fread_s(source, size + 1, sizeof(char), size, file);
-	fclose(file);
-	source[size] = 0;
+	std::string source;
+	std::vector<std::string> dependencies;
+	if (ShaderSource::load(filename, source, dependencies) == false)
+		return false;
 
-	glShaderSource(m_handle, 1, (const char**)&source, 0);
+	const char* string = source.c_str();
+	glShaderSource(m_handle, 1, &string, 0);
 	glCompileShader(m_handle);
 
-	delete[] source;
-
-	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
-		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
-		return false;
-	}
-
 	return true;
 }
 
@@ -58,47 +87,112 @@ bool Shader::createShader(unsigned int stage, const char* string) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
 
 	m_stage = stage;
-
-	switch (stage) {
-	case eShaderStage::VERTEX:	m_handle = glCreateShader(GL_VERTEX_SHADER);	break;
-	case eShaderStage::TESSELLATION_EVALUATION:	m_handle = glCreateShader(GL_TESS_EVALUATION_SHADER);	break;
-	case eShaderStage::TESSELLATION_CONTROL:	m_handle = glCreateShader(GL_TESS_CONTROL_SHADER);	break;
-	case eShaderStage::GEOMETRY:	m_handle = glCreateShader(GL_GEOMETRY_SHADER);	break;
-	case eShaderStage::FRAGMENT:	m_handle = glCreateShader(GL_FRAGMENT_SHADER);	break;
-	default:	break;
-	};
+	m_handle = glCreateShader(getShaderType(stage));
 
 	glShaderSource(m_handle, 1, (const char**)&string, 0);
 	glCompileShader(m_handle);
-	
+
+	return true;
+}
+
+bool Shader::checkStatus() {
 	int success = GL_TRUE;
-	glGetShaderiv(m_handle, GL_LINK_STATUS, &success);
+	glGetShaderiv(m_handle, GL_COMPILE_STATUS, &success);
 	if (success == GL_FALSE) {
 		int infoLogLength = 0;
 		glGetShaderiv(m_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
 
 		delete[] m_lastError;
-		m_lastError = new char[infoLogLength];
-		glGetShaderInfoLog(m_handle, infoLogLength, 0, m_lastError);
+		m_lastError = new char[infoLogLength + 1];
+		m_lastError[0] = 0;
+		glGetShaderInfoLog(m_handle, infoLogLength + 1, 0, m_lastError);
 		return false;
 	}
 
 	return true;
 }
 
+ShaderProgram* ShaderProgram::sm_bound = nullptr;
+unsigned int ShaderProgram::sm_locationQueryCount = 0;
+unsigned int ShaderProgram::sm_linkCount = 0;
+unsigned int ShaderProgram::sm_compileCount = 0;
+std::vector<ShaderProgram::UniformBlockBinding> ShaderProgram::sm_uniformBlockBindings;
+std::string ShaderProgram::sm_binaryCacheDirectory;
+
+namespace {
+
+// header written ahead of each cached program binary
+struct ProgramBinaryHeader {
+	unsigned int	magic;
+	unsigned int	format;
+	unsigned int	size;
+};
+
+const unsigned int PROGRAM_BINARY_MAGIC = 0x4E494250;	// "PBIN"
+
+// 64-bit FNV-1a, wide enough that cache files keyed by it won't collide
+unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ull) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+// binaries are only valid for the driver that produced them
+const std::string& getDriverString() {
+	static std::string driver;
+	if (driver.empty()) {
+		const unsigned int names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (auto name : names) {
+			const char* value = (const char*)glGetString(name);
+			driver += value != nullptr ? value : "";
+			driver += '\n';
+		}
+	}
+	return driver;
+}
+
+}
+
 ShaderProgram::~ShaderProgram() {
+	cancelReload();
+	if (sm_bound == this)
+		sm_bound = nullptr;
 	delete[] m_lastError;
+	GLState::removeProgram(m_program);
 	glDeleteProgram(m_program);
+	if (m_pipeline != 0) {
+		GLState::removeProgramPipeline(m_pipeline);
+		glDeleteProgramPipelines(1, &m_pipeline);
+	}
 }
 
 bool ShaderProgram::loadShader(unsigned int stage, const char* filename) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
-	m_shaders[stage] = std::make_shared<Shader>();
-	return m_shaders[stage]->loadShader(stage, filename);
+	std::string source;
+	std::vector<std::string> dependencies;
+	if (ShaderSource::load(filename, source, dependencies) == false)
+		return false;
+	bool success = createShader(stage, source.c_str());
+	m_filenames[stage] = filename;
+	m_dependencies[stage].swap(dependencies);
+	return success;
 }
 
 bool ShaderProgram::createShader(unsigned int stage, const char* string) {
 	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+	m_sources[stage] = injectDefines(string);
+	m_filenames[stage].clear();
+	m_dependencies[stage].clear();
+	string = m_sources[stage].c_str();
+
+	// with a binary cache the stage is compiled at link, and only if the cache misses
+	if (sm_binaryCacheDirectory.empty() == false) {
+		m_shaders[stage] = nullptr;
+		return true;
+	}
+
+	++sm_compileCount;
 	m_shaders[stage] = std::make_shared<Shader>();
 	return m_shaders[stage]->createShader(stage, string);
 }
@@ -106,308 +200,964 @@ bool ShaderProgram::createShader(unsigned int stage, const char* string) {
 void ShaderProgram::attachShader(const std::shared_ptr<Shader>& shader) {
 	assert(shader != nullptr);
 	m_shaders[shader->getStage()] = shader;
+	m_sources[shader->getStage()].clear();
+	m_filenames[shader->getStage()].clear();
+	m_dependencies[shader->getStage()].clear();
 }
 
 bool ShaderProgram::link() {
-	m_program = glCreateProgram();
+	submitLink();
+	return finishLink();
+}
+
+void ShaderProgram::submitLink() {
+	if (m_pipeline != 0) {
+		// stages shared with other pipelines are only submitted by the first
+		for (auto& p : m_stagePrograms)
+			if (p != nullptr && p->getHandle() == 0)
+				p->submitLink();
+		m_linkPending = true;
+		m_linked = false;
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// a link still pending from an earlier submit is dropped with its program
+	GLState::removeProgram(m_program);
+	glDeleteProgram(m_program);
+	m_program = createProgram();
+	m_fromBinaryCache = false;
+	m_linkPending = true;
+	m_linked = false;
+
+	m_cachePath = getBinaryCachePath();
+	if (m_cachePath.empty() == false)
+		m_fromBinaryCache = loadBinary(m_cachePath.c_str());
+
+	if (m_fromBinaryCache == false) {
+		compileStages();
+		linkStages(m_cachePath.empty() == false);
+	}
+
+	m_linkTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool ShaderProgram::finishLink() {
+	if (m_linkPending == false)
+		return m_linked;
+	if (m_pipeline != 0)
+		return finishPipeline();
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_linkPending = false;
+
+	// this is the first status query since submitting, so it's where the driver is waited on
+	int success = GL_FALSE;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+
+	if (success == GL_FALSE &&
+		m_fromBinaryCache) {
+		// drivers reject binaries after an update, start over with a fresh program and compile
+		printf("Program binary [%s] rejected, compiling from source\n", m_cachePath.c_str());
+		GLState::removeProgram(m_program);
+		glDeleteProgram(m_program);
+		m_program = createProgram();
+		m_fromBinaryCache = false;
+		compileStages();
+		linkStages(true);
+		glGetProgramiv(m_program, GL_LINK_STATUS, &success);
+	}
+
+	if (success == GL_FALSE) {
+		unsigned int shaders[eShaderStage::SHADER_STAGE_Count] = {};
+		for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage)
+			shaders[stage] = m_shaders[stage] != nullptr ? m_shaders[stage]->getHandle() : 0;
+		setLinkError(m_program, shaders);
+	}
+	else {
+		if (m_fromBinaryCache == false &&
+			m_cachePath.empty() == false)
+			saveBinary(m_cachePath.c_str());
+
+		buildUniformTable();
+		bindUniformBlocks();
+	}
+
+	m_linked = success == GL_TRUE;
+	m_linkTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return m_linked;
+}
+
+bool ShaderProgram::isLinkComplete() const {
+	if (m_linkPending == false ||
+		supportsParallelCompile() == false)
+		return true;
+
+	if (m_pipeline != 0) {
+		for (auto& p : m_stagePrograms)
+			if (p != nullptr && p->isLinkComplete() == false)
+				return false;
+		return true;
+	}
+
+	int complete = GL_FALSE;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+bool ShaderProgram::linkAll(ShaderProgram* const* programs, size_t count) {
+	// nothing waits on the driver until every program has been submitted
+	for (size_t i = 0; i < count; ++i)
+		programs[i]->submitLink();
+
+	bool success = true;
+	for (size_t i = 0; i < count; ++i)
+		success = programs[i]->finishLink() && success;
+	return success;
+}
+
+bool ShaderProgram::setMaxCompilerThreads(unsigned int count) {
+	if (supportsParallelCompile() == false)
+		return false;
+
+	// an extension entry point, so it isn't part of the core loader
+	typedef void (APIENTRY *MaxShaderCompilerThreadsProc)(GLuint);
+	auto maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	if (maxShaderCompilerThreads == nullptr)
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	if (maxShaderCompilerThreads == nullptr)
+		return false;
+
+	maxShaderCompilerThreads(count);
+	return true;
+}
+
+void ShaderProgram::compileStages() {
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_shaders[stage] != nullptr ||
+			m_sources[stage].empty())
+			continue;
+
+		++sm_compileCount;
+		m_shaders[stage] = std::make_shared<Shader>();
+		m_shaders[stage]->createShader(stage, m_sources[stage].c_str());
+	}
+}
+
+void ShaderProgram::linkStages(bool retrievable) {
 	for (auto& s : m_shaders)
 		if (s != nullptr)
 			glAttachShader(m_program, s->getHandle());
+	if (retrievable)
+		glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	++sm_linkCount;
 	glLinkProgram(m_program);
+}
 
-	int success = GL_TRUE;
-	glGetProgramiv(m_program, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE) {
-		int infoLogLength = 0;
-		glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &infoLogLength);
+unsigned int ShaderProgram::createProgram() const {
+	unsigned int program = glCreateProgram();
+	// has to be set before the program is linked or given a binary
+	if (m_separable)
+		glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	return program;
+}
 
-		delete[] m_lastError;
-		m_lastError = new char[infoLogLength + 1];
-		glGetProgramInfoLog(m_program, infoLogLength, 0, m_lastError);
+void ShaderProgram::setPipelineStage(unsigned int stage, const std::shared_ptr<ShaderProgram>& program) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+	assert(m_program == 0 && "A linked program can't also be a pipeline");
+	assert((program == nullptr || program->isSeparable()) && "Pipeline stages must be separable programs");
+
+	if (m_pipeline == 0)
+		glGenProgramPipelines(1, &m_pipeline);
+
+	// stages may still be linking, they're finished and attached on first use
+	m_stagePrograms[stage] = program;
+	m_stageHandles[stage] = 0;
+	m_linkPending = true;
+	m_linked = false;
+}
+
+bool ShaderProgram::finishPipeline() {
+	m_linkPending = false;
+	m_linked = true;
+	m_linkTime = 0;
+
+	for (auto& p : m_stagePrograms) {
+		if (p == nullptr)
+			continue;
+
+		// a stage shared with a pipeline that finished first has nothing left to wait for
+		bool pending = p->isLinkPending();
+		if (p->finishLink() == false &&
+			m_linked) {
+			m_linked = false;
+			const char* error = p->getLastError() != nullptr ? p->getLastError() : "";
+			delete[] m_lastError;
+			m_lastError = new char[strlen(error) + 1];
+			memcpy(m_lastError, error, strlen(error) + 1);
+		}
+		if (pending)
+			m_linkTime += p->getLinkTime();
+	}
+
+	if (m_linked)
+		attachStages();
+	return m_linked;
+}
+
+void ShaderProgram::attachStages() {
+	bool changed = false;
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		unsigned int handle = m_stagePrograms[stage] != nullptr ? m_stagePrograms[stage]->getHandle() : 0;
+		if (handle == m_stageHandles[stage])
+			continue;
+		glUseProgramStages(m_pipeline, getShaderStageBit(stage), handle);
+		m_stageHandles[stage] = handle;
+		changed = true;
+	}
+	if (changed == false)
+		return;
+
+	// stages are linked apart, so nothing stops two of them using the same location
+	m_locationOwners.clear();
+	for (auto& p : m_stagePrograms) {
+		if (p == nullptr)
+			continue;
+		for (auto& e : p->m_uniforms) {
+			if (e.nameIndex < 0 || e.location < 0)
+				continue;
+			if ((size_t)e.location >= m_locationOwners.size())
+				m_locationOwners.resize(e.location + 1, nullptr);
+			if (m_locationOwners[e.location] != nullptr &&
+				m_locationOwners[e.location] != p.get())
+				printf("Pipeline stages share uniform location %d, [%s] can't be set\n", e.location, p->m_uniformNames[e.nameIndex].c_str());
+			else
+				m_locationOwners[e.location] = p.get();
+		}
+	}
+}
+
+ShaderProgram* ShaderProgram::getUniformOwner(int location) {
+	if (m_pipeline == 0)
+		return this;
+	if (m_linkPending)
+		finishLink();
+	return (size_t)location < m_locationOwners.size() ? m_locationOwners[location] : nullptr;
+}
+
+void ShaderProgram::setLinkError(unsigned int program, const unsigned int* shaders) {
+	// report the first stage that failed to compile, otherwise the link error
+	unsigned int failed = 0;
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count && failed == 0; ++stage) {
+		int compiled = GL_TRUE;
+		if (shaders[stage] != 0)
+			glGetShaderiv(shaders[stage], GL_COMPILE_STATUS, &compiled);
+		if (compiled == GL_FALSE)
+			failed = shaders[stage];
+	}
+
+	int infoLogLength = 0;
+	if (failed != 0)
+		glGetShaderiv(failed, GL_INFO_LOG_LENGTH, &infoLogLength);
+	else
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+	delete[] m_lastError;
+	m_lastError = new char[infoLogLength + 1];
+	m_lastError[0] = 0;
+	if (failed != 0)
+		glGetShaderInfoLog(failed, infoLogLength + 1, 0, m_lastError);
+	else
+		glGetProgramInfoLog(program, infoLogLength + 1, 0, m_lastError);
+}
+
+std::string ShaderProgram::getBinaryCachePath() const {
+	if (sm_binaryCacheDirectory.empty())
+		return std::string();
+
+	int formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount == 0)
+		return std::string();
+
+	const std::string& driver = getDriverString();
+	unsigned long long hash = hashBytes(driver.data(), driver.size());
+
+	// separable programs link differently, so are cached apart
+	hash = hashBytes(&m_separable, sizeof(m_separable), hash);
+
+	// any defines are part of the stage sources, so they're covered by the hash too
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_sources[stage].empty()) {
+			// stages attached precompiled have no source to key on
+			if (m_shaders[stage] != nullptr)
+				return std::string();
+			continue;
+		}
+		hash = hashBytes(&stage, sizeof(stage), hash);
+		hash = hashBytes(m_sources[stage].data(), m_sources[stage].size() + 1, hash);
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.progbin", hash);
+
+	std::string path = sm_binaryCacheDirectory;
+	if (path.back() != '/' && path.back() != '\\')
+		path += '/';
+	return path + name;
+}
+
+bool ShaderProgram::loadBinary(const char* path) {
+	MappedFile file;
+	if (file.open(path) == false)
 		return false;
+
+	ProgramBinaryHeader header;
+	if (file.getSize() < sizeof(header))
+		return false;
+	memcpy(&header, file.getData(), sizeof(header));
+	if (header.magic != PROGRAM_BINARY_MAGIC ||
+		header.size != file.getSize() - sizeof(header))
+		return false;
+
+	glProgramBinary(m_program, header.format, file.getData() + sizeof(header), (int)header.size);
+	return true;
+}
+
+void ShaderProgram::saveBinary(const char* path) {
+	int length = 0;
+	glGetProgramiv(m_program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<unsigned char> binary(length);
+	ProgramBinaryHeader header = { PROGRAM_BINARY_MAGIC, 0, 0 };
+	glGetProgramBinary(m_program, length, &length, &header.format, binary.data());
+	header.size = (unsigned int)length;
+
+	FILE* file = nullptr;
+	fopen_s(&file, path, "wb");
+	if (file == nullptr) {
+		printf("Failed to write program binary [%s]\n", path);
+		return;
+	}
+
+	bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(binary.data(), 1, header.size, file) == header.size;
+	fclose(file);
+
+	// don't leave a truncated binary behind for the next run to reject
+	if (success == false) {
+		printf("Failed to write program binary [%s]\n", path);
+		remove(path);
 	}
+}
+
+bool ShaderProgram::reload() {
+	assert(m_program > 0 && "Invalid shader program");
+
+	// a reload still in flight is replaced by the newer sources
+	cancelReload();
+
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		m_pendingSources[stage] = m_sources[stage];
+		if (m_filenames[stage].empty())
+			continue;
+		// the includes are taken as they are now even if this fails, so the watcher follows an edit
+		// that added an include which doesn't exist yet
+		if (ShaderSource::load(m_filenames[stage].c_str(), m_pendingSources[stage], m_dependencies[stage]) == false) {
+			// editors can briefly leave a file missing or empty while saving
+			cancelReload();
+			return false;
+		}
+		m_pendingSources[stage] = injectDefines(m_pendingSources[stage]);
+	}
+
+	// compile and link are only issued here, their status isn't asked for until updateReload
+	m_pendingProgram = createProgram();
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_pendingSources[stage].empty() == false) {
+			const char* source = m_pendingSources[stage].c_str();
+			++sm_compileCount;
+			m_pendingShaders[stage] = glCreateShader(getShaderType(stage));
+			glShaderSource(m_pendingShaders[stage], 1, &source, 0);
+			glCompileShader(m_pendingShaders[stage]);
+			glAttachShader(m_pendingProgram, m_pendingShaders[stage]);
+		}
+		else if (m_shaders[stage] != nullptr)
+			glAttachShader(m_pendingProgram, m_shaders[stage]->getHandle());
+	}
+	if (sm_binaryCacheDirectory.empty() == false)
+		glProgramParameteri(m_pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	++sm_linkCount;
+	glLinkProgram(m_pendingProgram);
+
+	m_pendingFrames = 0;
 	return true;
 }
 
+ShaderProgram::ReloadStatus ShaderProgram::updateReload() {
+	if (m_pendingProgram == 0)
+		return RELOAD_NONE;
+
+	// without the parallel compile extension any status query waits for the compile to finish
+	++m_pendingFrames;
+	if (supportsParallelCompile()) {
+		int complete = GL_FALSE;
+		glGetProgramiv(m_pendingProgram, GL_COMPLETION_STATUS_KHR, &complete);
+		if (complete == GL_FALSE)
+			return RELOAD_PENDING;
+	}
+	else if (m_pendingFrames < RELOAD_POLL_DELAY)
+		return RELOAD_PENDING;
+
+	int success = GL_FALSE;
+	glGetProgramiv(m_pendingProgram, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		setLinkError(m_pendingProgram, m_pendingShaders);
+		cancelReload();
+		return RELOAD_FAILED;
+	}
+
+	// swap the new program in, it takes effect from the next bind()
+	GLState::removeProgram(m_program);
+	glDeleteProgram(m_program);
+	m_program = m_pendingProgram;
+	m_pendingProgram = 0;
+	m_linkPending = false;
+	m_linked = true;
+
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_pendingShaders[stage] == 0)
+			continue;
+		// the linked program no longer needs its stages, a later link() recompiles from source
+		glDetachShader(m_program, m_pendingShaders[stage]);
+		glDeleteShader(m_pendingShaders[stage]);
+		m_pendingShaders[stage] = 0;
+		m_shaders[stage] = nullptr;
+		m_sources[stage].swap(m_pendingSources[stage]);
+	}
+
+	buildUniformTable();
+	bindUniformBlocks();
+
+	std::string cachePath = getBinaryCachePath();
+	if (cachePath.empty() == false)
+		saveBinary(cachePath.c_str());
+
+	return RELOAD_SUCCEEDED;
+}
+
+void ShaderProgram::cancelReload() {
+	for (auto& s : m_pendingShaders) {
+		glDeleteShader(s);
+		s = 0;
+	}
+	for (auto& s : m_pendingSources)
+		s.clear();
+	glDeleteProgram(m_pendingProgram);
+	m_pendingProgram = 0;
+}
+
+std::string ShaderProgram::injectDefines(const std::string& source) const {
+	if (m_defines.empty())
+		return source;
+
+	// #version has to stay first, so the defines go on the lines after it
+	size_t insert = 0;
+	size_t version = source.find("#version");
+	if (version != std::string::npos) {
+		insert = source.find('\n', version);
+		insert = insert == std::string::npos ? source.size() : insert + 1;
+	}
+
+	std::string defines;
+	for (auto& d : m_defines)
+		defines += "#define " + d + "\n";
+
+	// keep compile errors reporting the line numbers of the file
+	if (insert > 0) {
+		int line = (int)std::count(source.begin(), source.begin() + insert, '\n') + 1;
+		defines += "#line " + std::to_string(line) + "\n";
+	}
+
+	std::string result = source.substr(0, insert);
+	if (insert > 0 && result.back() != '\n')
+		result += '\n';
+	return result + defines + source.substr(insert);
+}
+
+void ShaderProgram::setUniformBlockBinding(const char* blockName, unsigned int bindingPoint) {
+	for (auto& b : sm_uniformBlockBindings) {
+		if (b.name == blockName) {
+			b.bindingPoint = bindingPoint;
+			return;
+		}
+	}
+	sm_uniformBlockBindings.push_back({ blockName, bindingPoint });
+}
+
+void ShaderProgram::bindUniformBlocks() {
+	// #version 410 has no layout(binding) for blocks, so they're bound by name after link
+	for (auto& b : sm_uniformBlockBindings) {
+		unsigned int index = glGetUniformBlockIndex(m_program, b.name.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(m_program, index, b.bindingPoint);
+	}
+}
+
 void ShaderProgram::bind() {
-	assert(m_program > 0 && "Invalid shader program");
-	glUseProgram(m_program);
+	assert(isValid() && "Invalid shader program");
+	if (m_linkPending)
+		finishLink();
+
+	if (m_pipeline != 0) {
+		// picks up stages a reload has swapped since the last bind
+		attachStages();
+		GLState::bindProgramPipeline(m_pipeline);
+	}
+	else
+		GLState::useProgram(m_program);
+	sm_bound = this;
 }
 
-int ShaderProgram::getUniform(const char* name) {
-	return glGetUniformLocation(m_program, name);
+int ShaderProgram::getUniform(const UniformName& name) {
+	return findUniform(name, false);
 }
 
-bool ShaderProgram::bindUniform(const char* name, int value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
-		return false;
+void ShaderProgram::buildUniformTable() {
+
+	m_uniforms.clear();
+	m_uniformNames.clear();
+
+	// a new program starts with its default uniform values
+	m_uniformValues.clear();
+
+	int count = 0, maxLength = 0;
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	// keep the table at most half full so probes stay short, leaving room for misses
+	size_t capacity = 16;
+	while (capacity < (size_t)count * 4)
+		capacity *= 2;
+	m_uniforms.assign(capacity, { 0, -1, -1 });
+
+	std::vector<char> buffer(maxLength + 1);
+	for (int i = 0; i < count; ++i) {
+		int length = 0, size = 0;
+		unsigned int type = 0;
+		glGetActiveUniform(m_program, i, (int)buffer.size(), &length, &size, &type, buffer.data());
+
+		// uniform block members have no location of their own
+		std::string name(buffer.data(), length);
+		++sm_locationQueryCount;
+		int location = glGetUniformLocation(m_program, name.c_str());
+		if (location < 0)
+			continue;
+
+		insertUniform(hashUniformName(name.c_str()), name, location);
+
+		// arrays are reported as "name[0]" but are usually bound by their plain name
+		if (name.size() > 3 &&
+			name.compare(name.size() - 3, 3, "[0]") == 0) {
+			std::string arrayName = name.substr(0, name.size() - 3);
+			insertUniform(hashUniformName(arrayName.c_str()), arrayName, location);
+		}
+	}
+}
+
+void ShaderProgram::insertUniform(unsigned int hash, const std::string& name, int location) {
+
+	// grow once more than half full
+	if ((m_uniformNames.size() + 1) * 2 > m_uniforms.size()) {
+		std::vector<UniformEntry> entries(std::max((size_t)16, m_uniforms.size() * 2), { 0, -1, -1 });
+		size_t mask = entries.size() - 1;
+		for (auto& e : m_uniforms) {
+			if (e.nameIndex < 0)
+				continue;
+			size_t index = e.hash & mask;
+			while (entries[index].nameIndex >= 0)
+				index = (index + 1) & mask;
+			entries[index] = e;
+		}
+		m_uniforms.swap(entries);
+	}
+
+	size_t mask = m_uniforms.size() - 1;
+	size_t index = hash & mask;
+	while (m_uniforms[index].nameIndex >= 0)
+		index = (index + 1) & mask;
+
+	m_uniforms[index] = { hash, location, (int)m_uniformNames.size() };
+	m_uniformNames.push_back(name);
+}
+
+int ShaderProgram::findUniform(const UniformName& name, bool report) {
+	assert(isValid() && "Invalid shader program");
+	if (m_linkPending)
+		finishLink();
+
+	if (m_pipeline != 0) {
+		for (auto& p : m_stagePrograms) {
+			int location = p != nullptr ? p->findUniform(name, false) : -1;
+			if (location >= 0)
+				return location;
+		}
+		if (report)
+			printf("Shader uniform [%s] not found! Is it being used?\n", name.name);
+		return -1;
+	}
+
+	if (m_uniforms.empty() == false) {
+		size_t mask = m_uniforms.size() - 1;
+		size_t index = name.hash & mask;
+		while (m_uniforms[index].nameIndex >= 0) {
+			const UniformEntry& entry = m_uniforms[index];
+			if (entry.hash == name.hash &&
+				m_uniformNames[entry.nameIndex] == name.name)
+				return entry.location;
+			index = (index + 1) & mask;
+		}
 	}
-	glUniform1i(i, value);
+
+	// names not in the table (such as array elements) are queried once and cached,
+	// including misses, so a missing uniform is only reported the first time
+	++sm_locationQueryCount;
+	int location = glGetUniformLocation(m_program, name.name);
+	insertUniform(name.hash, name.name, location);
+
+	if (location < 0 && report)
+		printf("Shader uniform [%s] not found! Is it being used?\n", name.name);
+
+	return location;
+}
+
+bool ShaderProgram::bindUniform(const UniformName& name, int value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
+		return false;
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, float value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, float value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform1f(i, value);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec2& value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::vec2& value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform2f(i, value.x, value.y);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec3& value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::vec3& value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform3f(i, value.x, value.y, value.z);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::vec4& value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::vec4& value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform4f(i, value.x, value.y, value.z, value.w);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat2& value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::mat2& value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniformMatrix2fv(i, 1, GL_FALSE, &value[0][0]);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat3& value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::mat3& value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniformMatrix3fv(i, 1, GL_FALSE, &value[0][0]);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, const glm::mat4& value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, const glm::mat4& value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniformMatrix4fv(i, 1, GL_FALSE, &value[0][0]);
+	bindUniform(i, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, int* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, int* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform1iv(i, count, value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, float* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, float* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform1fv(i, count, value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec2* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::vec2* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform2fv(i, count, (float*)value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec3* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::vec3* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform3fv(i, count, (float*)value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::vec4* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::vec4* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniform4fv(i, count, (float*)value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat2* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::mat2* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniformMatrix2fv(i, count, GL_FALSE, (float*)value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat3* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::mat3* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
-	}
-	glUniformMatrix3fv(i, count, GL_FALSE, (float*)value);
+	bindUniform(i, count, value);
 	return true;
 }
 
-bool ShaderProgram::bindUniform(const char* name, int count, const glm::mat4* value) {
-	assert(m_program > 0 && "Invalid shader program");
-	int i = glGetUniformLocation(m_program, name);
-	if (i < 0) {
-		printf("Shader uniform [%s] not found! Is it being used?\n", name);
+bool ShaderProgram::bindUniform(const UniformName& name, int count, const glm::mat4* value) {
+	assert(isValid() && "Invalid shader program");
+	int i = findUniform(name, true);
+	if (i < 0)
 		return false;
+	bindUniform(i, count, value);
+	return true;
+}
+
+bool ShaderProgram::updateUniformValue(int location, const void* value, unsigned int size) {
+	assert(size <= sizeof(UniformValue::data));
+	if (location >= MAX_SHADOWED_LOCATION) {
+		GLState::count(GLState::UNIFORM, true);
+		return true;
 	}
-	glUniformMatrix4fv(i, count, GL_FALSE, (float*)value);
+
+	if ((size_t)location >= m_uniformValues.size())
+		m_uniformValues.resize(location + 1);
+
+	UniformValue& shadow = m_uniformValues[location];
+	if (shadow.size == size &&
+		memcmp(shadow.data, value, size) == 0) {
+		GLState::count(GLState::UNIFORM, false);
+		return false;
+	}
+
+	shadow.size = size;
+	memcpy(shadow.data, value, size);
+	GLState::count(GLState::UNIFORM, true);
 	return true;
 }
 
+void ShaderProgram::forgetUniformValues(int location, int count) {
+	// arrays aren't shadowed, but their elements may have been set one at a time
+	for (int i = location; i < location + count && (size_t)i < m_uniformValues.size(); ++i)
+		m_uniformValues[i].size = 0;
+	GLState::count(GLState::UNIFORM, true);
+}
+
 void ShaderProgram::bindUniform(int ID, int value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform1i(ID, value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniform1i(owner->m_program, ID, value);
 }
 
 void ShaderProgram::bindUniform(int ID, float value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform1f(ID, value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniform1f(owner->m_program, ID, value);
 }
 
 void ShaderProgram::bindUniform(int ID, const glm::vec2& value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform2f(ID, value.x, value.y);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniform2f(owner->m_program, ID, value.x, value.y);
 }
 
 void ShaderProgram::bindUniform(int ID, const glm::vec3& value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform3f(ID, value.x, value.y, value.z);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniform3f(owner->m_program, ID, value.x, value.y, value.z);
 }
 
 void ShaderProgram::bindUniform(int ID, const glm::vec4& value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform4f(ID, value.x, value.y, value.z, value.w);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniform4f(owner->m_program, ID, value.x, value.y, value.z, value.w);
 }
 
 void ShaderProgram::bindUniform(int ID, const glm::mat2& value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniformMatrix2fv(ID, 1, GL_FALSE, &value[0][0]);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniformMatrix2fv(owner->m_program, ID, 1, GL_FALSE, &value[0][0]);
 }
 
 void ShaderProgram::bindUniform(int ID, const glm::mat3& value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniformMatrix3fv(ID, 1, GL_FALSE, &value[0][0]);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniformMatrix3fv(owner->m_program, ID, 1, GL_FALSE, &value[0][0]);
 }
 
 void ShaderProgram::bindUniform(int ID, const glm::mat4& value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniformMatrix4fv(ID, 1, GL_FALSE, &value[0][0]);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner != nullptr &&
+		owner->updateUniformValue(ID, &value, sizeof(value)))
+		glProgramUniformMatrix4fv(owner->m_program, ID, 1, GL_FALSE, &value[0][0]);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, int* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform1iv(ID, count, value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniform1iv(owner->m_program, ID, count, value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, float* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform1fv(ID, count, value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniform1fv(owner->m_program, ID, count, value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, const glm::vec2* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform2fv(ID, count, (float*)value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniform2fv(owner->m_program, ID, count, (float*)value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, const glm::vec3* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform3fv(ID, count, (float*)value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniform3fv(owner->m_program, ID, count, (float*)value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, const glm::vec4* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniform4fv(ID, count, (float*)value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniform4fv(owner->m_program, ID, count, (float*)value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, const glm::mat2* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniformMatrix2fv(ID, count, GL_FALSE, (float*)value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniformMatrix2fv(owner->m_program, ID, count, GL_FALSE, (float*)value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, const glm::mat3* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniformMatrix3fv(ID, count, GL_FALSE, (float*)value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniformMatrix3fv(owner->m_program, ID, count, GL_FALSE, (float*)value);
 }
 
 void ShaderProgram::bindUniform(int ID, int count, const glm::mat4* value) {
-	assert(m_program > 0 && "Invalid shader program");
+	assert(isValid() && "Invalid shader program");
 	assert(ID >= 0 && "Invalid shader uniform");
-	glUniformMatrix4fv(ID, count, GL_FALSE, (float*)value);
+	ShaderProgram* owner = getUniformOwner(ID);
+	if (owner == nullptr)
+		return;
+	owner->forgetUniformValues(ID, count);
+	glProgramUniformMatrix4fv(owner->m_program, ID, count, GL_FALSE, (float*)value);
 }
 
 }
\ No newline at end of file
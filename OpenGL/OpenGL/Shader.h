@@ -7,6 +7,8 @@
 #include <glm/mat3x3.hpp>
 #include <glm/mat4x4.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace aie {
 
@@ -23,6 +25,20 @@ enum eShaderStage : unsigned int {
 	SHADER_STAGE_Count,
 };
 
+// FNV-1a hash of a uniform name, usable at compile time
+constexpr unsigned int hashUniformName(const char* name, unsigned int hash = 2166136261u) {
+	return *name == 0 ? hash : hashUniformName(name + 1, (hash ^ (unsigned char)*name) * 16777619u);
+}
+
+// a uniform name paired with its hash. String literals convert implicitly and are
+// hashed by the compiler, or declare constexpr UniformNames to guarantee it
+struct UniformName {
+	constexpr UniformName(const char* name) : name(name), hash(hashUniformName(name)) {}
+
+	const char*		name;
+	unsigned int	hash;
+};
+
 // individual sharable shader stages
 class Shader {
 public:
@@ -34,9 +50,14 @@ public:
 	}
 	~Shader();
 
+	// these only submit the compile, so the driver can work on several shaders at once.
+	// Status is checked when a program linking the shader finishes, or by checkStatus()
 	bool loadShader(unsigned int stage, const char* filename);
 	bool createShader(unsigned int stage, const char* string);
 
+	// waits for the compile and returns whether it succeeded, filling in the last error if not
+	bool checkStatus();
+
 	unsigned int getStage() const { return m_stage; }
 	unsigned int getHandle() const { return m_handle; }
 
@@ -53,8 +74,13 @@ protected:
 class ShaderProgram {
 public:
 
-	ShaderProgram() : m_program(0), m_lastError(nullptr) {
+	ShaderProgram() : m_program(0), m_lastError(nullptr), m_linkTime(0), m_fromBinaryCache(false),
+		m_linkPending(false), m_linked(false), m_separable(false), m_pipeline(0), m_pendingProgram(0), m_pendingFrames(0) {
 		m_shaders[0] = m_shaders[1] = m_shaders[2] = m_shaders[3] = m_shaders[4] = 0;
+		for (auto& s : m_pendingShaders)
+			s = 0;
+		for (auto& h : m_stageHandles)
+			h = 0;
 	}
 	~ShaderProgram();
 
@@ -62,16 +88,112 @@ public:
 	bool createShader(unsigned int stage, const char* string);
 	void attachShader(const std::shared_ptr<Shader>& shader);
 
+	// compiles and links, waiting for the result. Same as submitLink() followed by finishLink()
 	bool link();
 
+	// starts compiling and linking without asking the driver for any status, so many programs
+	// can compile in parallel. The link is finished the first time the program is bound or has
+	// a uniform looked up, or explicitly by finishLink()
+	void submitLink();
+
+	// waits for a submitted link and checks its status, then builds the uniform table
+	bool finishLink();
+
+	bool isLinkPending() const { return m_linkPending; }
+
+	// true if the last finished link succeeded
+	bool isLinked() const { return m_linked; }
+
+	// true once the driver has finished a submitted link. Only known without waiting when the
+	// driver supports parallel shader compile, otherwise this is always true
+	bool isLinkComplete() const;
+
+	// submits every program's link before finishing any of them, returning false if any failed
+	static bool linkAll(ShaderProgram* const* programs, size_t count);
+
+	// programs linked afterwards can be used as stages of a program pipeline
+	void setSeparable(bool separable) { m_separable = separable; }
+	bool isSeparable() const { return m_separable; }
+
+	// makes this a program pipeline instead of a linked program, taking the stage from a separable
+	// program. A separable program can be a stage of many pipelines, so it's only compiled and linked
+	// once however many programs it's combined with. Binding and uniforms work as for a linked
+	// program, with each uniform set on the stage that declares it, so stages must not share locations
+	void setPipelineStage(unsigned int stage, const std::shared_ptr<ShaderProgram>& program);
+	ShaderProgram* getPipelineStage(unsigned int stage) const { return m_stagePrograms[stage].get(); }
+	bool isPipeline() const { return m_pipeline != 0; }
+
+	// programs linked and stages compiled, including reloads, since startup
+	static unsigned int getLinkCount() { return sm_linkCount; }
+	static unsigned int getCompileCount() { return sm_compileCount; }
+
+	// asks drivers with parallel shader compile to use this many compiler threads.
+	// Returns false if the driver doesn't support it
+	static bool setMaxCompilerThreads(unsigned int count);
+
 	const char* getLastError() const { return m_lastError; }
 
+	// time spent submitting and finishing the last link, in milliseconds. With a binary cache
+	// this includes compiling the stages when no usable binary was found
+	float getLinkTime() const { return m_linkTime; }
+
+	// true if the last link loaded a cached program binary rather than compiling
+	bool isFromBinaryCache() const { return m_fromBinaryCache; }
+
+	// #defines inserted after the #version line of every stage loaded or created afterwards, each
+	// entry either "NAME" or "NAME VALUE". Sources are keyed after injection, so the binary cache
+	// and hot reload both keep each set of defines apart
+	void setDefines(const std::vector<std::string>& defines) { m_defines = defines; }
+	const std::vector<std::string>& getDefines() const { return m_defines; }
+
+	// the file a stage was loaded from, empty for stages created from a string or attached
+	const std::string& getFilename(unsigned int stage) const { return m_filenames[stage]; }
+
+	// the files a stage's file includes, as of its last load or reload
+	const std::vector<std::string>& getDependencies(unsigned int stage) const { return m_dependencies[stage]; }
+
+	enum ReloadStatus {
+		RELOAD_NONE,
+		RELOAD_PENDING,
+		RELOAD_SUCCEEDED,
+		RELOAD_FAILED,
+	};
+
+	// starts recompiling the program with each stage re-read from its file, without waiting on the
+	// driver. The current program stays in use until the new one has linked, and is kept if it fails
+	bool reload();
+
+	// polls a reload once per frame, swapping the new program in once it has linked
+	ReloadStatus updateReload();
+
+	bool isReloading() const { return m_pendingProgram != 0; }
+
+	// when set, programs linked afterwards are saved to and loaded from this directory, keyed by
+	// a hash of their stage sources and the driver. Stages are then only compiled if the cache misses
+	static void setBinaryCacheDirectory(const char* directory) { sm_binaryCacheDirectory = directory; }
+	static const std::string& getBinaryCacheDirectory() { return sm_binaryCacheDirectory; }
+
+	// skips glUseProgram if the program is already in use
 	void bind();
 
 	unsigned int getHandle() const { return m_program; }
 
-	int getUniform(const char* name);
+	// the location of a uniform from the table built at link, -1 if it isn't active
+	int getUniform(const UniformName& name);
+
+	// the program most recently bound through bind()
+	static ShaderProgram* getBound() { return sm_bound; }
+
+	// calls made to glGetUniformLocation, uniforms are only looked up at link or on a first miss
+	static unsigned int getLocationQueryCount() { return sm_locationQueryCount; }
+	static void resetLocationQueryCount() { sm_locationQueryCount = 0; }
 
+	// every program linked afterwards that declares the named uniform block has it bound to this point
+	static void setUniformBlockBinding(const char* blockName, unsigned int bindingPoint);
+
+	// each program shadows the values it was last given, so setting a uniform to the value it
+	// already holds is skipped. Counted as GLState::UNIFORM calls issued or elided. Uniforms are set
+	// with glProgramUniform, so the program doesn't need to be bound
 	void bindUniform(int ID, int value);
 	void bindUniform(int ID, float value);
 	void bindUniform(int ID, const glm::vec2& value);
@@ -89,31 +211,134 @@ public:
 	void bindUniform(int ID, int count, const glm::mat3* value);
 	void bindUniform(int ID, int count, const glm::mat4* value);
 
-	// these calls should be avoided, but wraps up opengl a little
-	bool bindUniform(const char* name, int value);
-	bool bindUniform(const char* name, float value);
-	bool bindUniform(const char* name, const glm::vec2& value);
-	bool bindUniform(const char* name, const glm::vec3& value);
-	bool bindUniform(const char* name, const glm::vec4& value);
-	bool bindUniform(const char* name, const glm::mat2& value);
-	bool bindUniform(const char* name, const glm::mat3& value);
-	bool bindUniform(const char* name, const glm::mat4& value);
-	bool bindUniform(const char* name, int count, int* value);
-	bool bindUniform(const char* name, int count, float* value);
-	bool bindUniform(const char* name, int count, const glm::vec2* value);
-	bool bindUniform(const char* name, int count, const glm::vec3* value);
-	bool bindUniform(const char* name, int count, const glm::vec4* value);
-	bool bindUniform(const char* name, int count, const glm::mat2* value);
-	bool bindUniform(const char* name, int count, const glm::mat3* value);
-	bool bindUniform(const char* name, int count, const glm::mat4* value);
+	// these resolve names through the uniform table, missing uniforms are reported once
+	bool bindUniform(const UniformName& name, int value);
+	bool bindUniform(const UniformName& name, float value);
+	bool bindUniform(const UniformName& name, const glm::vec2& value);
+	bool bindUniform(const UniformName& name, const glm::vec3& value);
+	bool bindUniform(const UniformName& name, const glm::vec4& value);
+	bool bindUniform(const UniformName& name, const glm::mat2& value);
+	bool bindUniform(const UniformName& name, const glm::mat3& value);
+	bool bindUniform(const UniformName& name, const glm::mat4& value);
+	bool bindUniform(const UniformName& name, int count, int* value);
+	bool bindUniform(const UniformName& name, int count, float* value);
+	bool bindUniform(const UniformName& name, int count, const glm::vec2* value);
+	bool bindUniform(const UniformName& name, int count, const glm::vec3* value);
+	bool bindUniform(const UniformName& name, int count, const glm::vec4* value);
+	bool bindUniform(const UniformName& name, int count, const glm::mat2* value);
+	bool bindUniform(const UniformName& name, int count, const glm::mat3* value);
+	bool bindUniform(const UniformName& name, int count, const glm::mat4* value);
 
 private:
 
+	// finds a uniform, querying and caching it on a miss. Reports missing uniforms once if asked
+	int findUniform(const UniformName& name, bool report);
+
+	bool isValid() const { return m_program > 0 || m_pipeline > 0; }
+
+	// a new program object, made separable if asked for
+	unsigned int createProgram() const;
+
+	// pipelines finish each stage's link, and attach stages whose program changed since last time
+	bool finishPipeline();
+	void attachStages();
+
+	// the program a uniform location is set on, nullptr if no stage of a pipeline has it
+	ShaderProgram* getUniformOwner(int location);
+
+	// compiles stages whose compile was deferred for the binary cache
+	void compileStages();
+	void linkStages(bool retrievable);
+
+	// fills in the last error from the first of the shaders that failed to compile, or the link log
+	void setLinkError(unsigned int program, const unsigned int* shaders);
+
+	// empty if the program can't be cached, such as when a stage was attached precompiled
+	std::string getBinaryCachePath() const;
+	// submits the cached binary, its status is checked as the link finishes
+	bool loadBinary(const char* path);
+	void saveBinary(const char* path);
+
+	void cancelReload();
+
+	// the source with m_defines inserted after its #version line
+	std::string injectDefines(const std::string& source) const;
+
+	void buildUniformTable();
+	void bindUniformBlocks();
+	void insertUniform(unsigned int hash, const std::string& name, int location);
+
+	// records a value given to a uniform, returning false if the location already held it
+	bool updateUniformValue(int location, const void* value, unsigned int size);
+	// forgets the values of locations an array upload overwrote
+	void forgetUniformValues(int location, int count);
+
+	// open addressed table of uniform locations, sized to a power of two
+	struct UniformEntry {
+		unsigned int	hash;
+		int				location;
+		int				nameIndex;	// -1 for an empty entry
+	};
+
 	unsigned int	m_program;
 
 	std::shared_ptr<Shader> m_shaders[eShaderStage::SHADER_STAGE_Count];
 
 	char*			m_lastError;
+
+	// the source of each stage loaded through this program, which keys the binary cache
+	std::string		m_sources[eShaderStage::SHADER_STAGE_Count];
+
+	std::string		m_filenames[eShaderStage::SHADER_STAGE_Count];
+	std::vector<std::string>	m_dependencies[eShaderStage::SHADER_STAGE_Count];
+
+	std::vector<std::string>	m_defines;
+
+	float			m_linkTime;
+	bool			m_fromBinaryCache;
+	bool			m_linkPending;
+	bool			m_linked;
+	bool			m_separable;
+	std::string		m_cachePath;
+
+	// a pipeline's object and stage programs, with the handle each stage was attached with so
+	// stages swapped by a reload are attached again, and the stage owning each uniform location
+	unsigned int					m_pipeline;
+	std::shared_ptr<ShaderProgram>	m_stagePrograms[eShaderStage::SHADER_STAGE_Count];
+	unsigned int					m_stageHandles[eShaderStage::SHADER_STAGE_Count];
+	std::vector<ShaderProgram*>		m_locationOwners;
+
+	// a reload in flight, swapped in for m_program once linked
+	unsigned int	m_pendingProgram;
+	unsigned int	m_pendingShaders[eShaderStage::SHADER_STAGE_Count];
+	std::string		m_pendingSources[eShaderStage::SHADER_STAGE_Count];
+	unsigned int	m_pendingFrames;
+
+	std::vector<UniformEntry>	m_uniforms;
+	std::vector<std::string>	m_uniformNames;
+
+	// the last value set at each location, up to a mat4. A size of 0 means it isn't known
+	struct UniformValue {
+		UniformValue() : size(0) {}
+
+		unsigned int	size;
+		float			data[16];
+	};
+	static const int MAX_SHADOWED_LOCATION = 1024;
+	std::vector<UniformValue>	m_uniformValues;
+
+	static ShaderProgram*	sm_bound;
+	static unsigned int		sm_locationQueryCount;
+	static unsigned int		sm_linkCount;
+	static unsigned int		sm_compileCount;
+
+	struct UniformBlockBinding {
+		std::string		name;
+		unsigned int	bindingPoint;
+	};
+	static std::vector<UniformBlockBinding>	sm_uniformBlockBindings;
+
+	static std::string	sm_binaryCacheDirectory;
 };
 
 }
\ No newline at end of file
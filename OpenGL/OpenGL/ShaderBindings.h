@@ -0,0 +1,208 @@
+// Generated by tools/shader_reflect.py from data/shaders, do not edit.
+// Locations are injected in to the shaders as layout qualifiers by the same build step.
+#pragma once
+
+#include "Shader.h"
+#include <cstdio>
+
+namespace aie {
+namespace shaders {
+
+inline bool validateLocation(ShaderProgram& program, const char* name, int location) {
+	int actual = program.getUniform(name);
+	if (actual < 0 || actual == location)
+		return true;
+	printf("Uniform [%s] is at location %d, bindings expect %d. Rerun shader_reflect.py\n", name, actual, location);
+	return false;
+}
+
+// normalmap.vert + normalmap.frag
+struct Normalmap {
+
+	struct Location {
+		static constexpr int ProjectionViewModel = 0;
+		static constexpr int ModelMatrix = 1;
+		static constexpr int NormalMatrix = 2;
+		static constexpr int Ka = 3;
+		static constexpr int Kd = 4;
+		static constexpr int Ks = 5;
+		static constexpr int specularPower = 6;
+		static constexpr int Id = 7;
+		static constexpr int Is = 8;
+	};
+
+	// texture unit each sampler reads from
+	struct Binding {
+		static constexpr unsigned int diffuseTexture = 0;
+		static constexpr unsigned int specularTexture = 3;
+		static constexpr unsigned int normalTexture = 5;
+	};
+
+	static void setProjectionViewModel(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ProjectionViewModel, value); }
+	static void setModelMatrix(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ModelMatrix, value); }
+	static void setNormalMatrix(ShaderProgram& program, const glm::mat3& value) { program.bindUniform(Location::NormalMatrix, value); }
+	static void setKa(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Ka, value); }
+	static void setKd(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Kd, value); }
+	static void setKs(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Ks, value); }
+	static void setSpecularPower(ShaderProgram& program, float value) { program.bindUniform(Location::specularPower, value); }
+	static void setId(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Id, value); }
+	static void setIs(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Is, value); }
+
+	// checks the locations against a linked program, reporting any that differ
+	static bool validate(ShaderProgram& program) {
+		bool valid = true;
+		valid &= validateLocation(program, "ProjectionViewModel", Location::ProjectionViewModel);
+		valid &= validateLocation(program, "ModelMatrix", Location::ModelMatrix);
+		valid &= validateLocation(program, "NormalMatrix", Location::NormalMatrix);
+		valid &= validateLocation(program, "Ka", Location::Ka);
+		valid &= validateLocation(program, "Kd", Location::Kd);
+		valid &= validateLocation(program, "Ks", Location::Ks);
+		valid &= validateLocation(program, "specularPower", Location::specularPower);
+		valid &= validateLocation(program, "Id", Location::Id);
+		valid &= validateLocation(program, "Is", Location::Is);
+		return valid;
+	}
+};
+
+// phong.vert + phong.frag
+struct Phong {
+
+	struct Location {
+		static constexpr int ProjectionViewModel = 0;
+		static constexpr int ModelMatrix = 1;
+		static constexpr int NormalMatrix = 2;
+		static constexpr int Ka = 3;
+		static constexpr int Kd = 4;
+		static constexpr int Ks = 5;
+		static constexpr int specularPower = 6;
+		static constexpr int Id = 7;
+		static constexpr int Is = 8;
+	};
+
+	// texture unit each sampler reads from
+	struct Binding {
+		static constexpr unsigned int diffuseTexture = 0;
+	};
+
+	static void setProjectionViewModel(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ProjectionViewModel, value); }
+	static void setModelMatrix(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ModelMatrix, value); }
+	static void setNormalMatrix(ShaderProgram& program, const glm::mat3& value) { program.bindUniform(Location::NormalMatrix, value); }
+	static void setKa(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Ka, value); }
+	static void setKd(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Kd, value); }
+	static void setKs(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Ks, value); }
+	static void setSpecularPower(ShaderProgram& program, float value) { program.bindUniform(Location::specularPower, value); }
+	static void setId(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Id, value); }
+	static void setIs(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Is, value); }
+
+	// checks the locations against a linked program, reporting any that differ
+	static bool validate(ShaderProgram& program) {
+		bool valid = true;
+		valid &= validateLocation(program, "ProjectionViewModel", Location::ProjectionViewModel);
+		valid &= validateLocation(program, "ModelMatrix", Location::ModelMatrix);
+		valid &= validateLocation(program, "NormalMatrix", Location::NormalMatrix);
+		valid &= validateLocation(program, "Ka", Location::Ka);
+		valid &= validateLocation(program, "Kd", Location::Kd);
+		valid &= validateLocation(program, "Ks", Location::Ks);
+		valid &= validateLocation(program, "specularPower", Location::specularPower);
+		valid &= validateLocation(program, "Id", Location::Id);
+		valid &= validateLocation(program, "Is", Location::Is);
+		return valid;
+	}
+};
+
+// physic-based.vert + physic-based.frag
+struct PhysicBased {
+
+	struct Location {
+		static constexpr int ProjectionViewModel = 0;
+		static constexpr int ModelMatrix = 1;
+		static constexpr int NormalMatrix = 2;
+		static constexpr int Ka = 3;
+		static constexpr int Kd = 4;
+		static constexpr int Ks = 5;
+		static constexpr int specularPower = 6;
+		static constexpr int Id = 7;
+		static constexpr int Is = 8;
+		static constexpr int Roughness = 9;
+		static constexpr int ReflectionCoefficient = 10;
+	};
+
+	// texture unit each sampler reads from
+	struct Binding {
+		static constexpr unsigned int diffuseTex = 0;
+	};
+
+	static void setProjectionViewModel(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ProjectionViewModel, value); }
+	static void setModelMatrix(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ModelMatrix, value); }
+	static void setNormalMatrix(ShaderProgram& program, const glm::mat3& value) { program.bindUniform(Location::NormalMatrix, value); }
+	static void setKa(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Ka, value); }
+	static void setKd(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Kd, value); }
+	static void setKs(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Ks, value); }
+	static void setSpecularPower(ShaderProgram& program, float value) { program.bindUniform(Location::specularPower, value); }
+	static void setId(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Id, value); }
+	static void setIs(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Is, value); }
+	static void setRoughness(ShaderProgram& program, float value) { program.bindUniform(Location::Roughness, value); }
+	static void setReflectionCoefficient(ShaderProgram& program, float value) { program.bindUniform(Location::ReflectionCoefficient, value); }
+
+	// checks the locations against a linked program, reporting any that differ
+	static bool validate(ShaderProgram& program) {
+		bool valid = true;
+		valid &= validateLocation(program, "ProjectionViewModel", Location::ProjectionViewModel);
+		valid &= validateLocation(program, "ModelMatrix", Location::ModelMatrix);
+		valid &= validateLocation(program, "NormalMatrix", Location::NormalMatrix);
+		valid &= validateLocation(program, "Ka", Location::Ka);
+		valid &= validateLocation(program, "Kd", Location::Kd);
+		valid &= validateLocation(program, "Ks", Location::Ks);
+		valid &= validateLocation(program, "specularPower", Location::specularPower);
+		valid &= validateLocation(program, "Id", Location::Id);
+		valid &= validateLocation(program, "Is", Location::Is);
+		valid &= validateLocation(program, "Roughness", Location::Roughness);
+		valid &= validateLocation(program, "ReflectionCoefficient", Location::ReflectionCoefficient);
+		return valid;
+	}
+};
+
+// simple.vert + simple.frag
+struct Simple {
+
+	struct Location {
+		static constexpr int ProjectionViewModel = 0;
+		static constexpr int Kd = 1;
+	};
+
+	static void setProjectionViewModel(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ProjectionViewModel, value); }
+	static void setKd(ShaderProgram& program, const glm::vec3& value) { program.bindUniform(Location::Kd, value); }
+
+	// checks the locations against a linked program, reporting any that differ
+	static bool validate(ShaderProgram& program) {
+		bool valid = true;
+		valid &= validateLocation(program, "ProjectionViewModel", Location::ProjectionViewModel);
+		valid &= validateLocation(program, "Kd", Location::Kd);
+		return valid;
+	}
+};
+
+// textured.vert + textured.frag
+struct Textured {
+
+	struct Location {
+		static constexpr int ProjectionViewModel = 0;
+	};
+
+	// texture unit each sampler reads from
+	struct Binding {
+		static constexpr unsigned int diffuseTexture = 0;
+	};
+
+	static void setProjectionViewModel(ShaderProgram& program, const glm::mat4& value) { program.bindUniform(Location::ProjectionViewModel, value); }
+
+	// checks the locations against a linked program, reporting any that differ
+	static bool validate(ShaderProgram& program) {
+		bool valid = true;
+		valid &= validateLocation(program, "ProjectionViewModel", Location::ProjectionViewModel);
+		return valid;
+	}
+};
+
+} // namespace shaders
+} // namespace aie
@@ -0,0 +1,156 @@
+#include "ShaderSource.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+
+namespace aie {
+
+std::unordered_map<std::string, ShaderSource::CachedFile> ShaderSource::sm_cache;
+
+unsigned int ShaderSource::sm_fileReadCount = 0;
+unsigned int ShaderSource::sm_cacheHitCount = 0;
+float ShaderSource::sm_loadTime = 0;
+
+time_t ShaderSource::getModifiedTime(const char* filename) {
+	struct stat info;
+	if (stat(filename, &info) != 0)
+		return 0;
+	return info.st_mtime;
+}
+
+bool ShaderSource::load(const char* filename, std::string& source, std::vector<std::string>& dependencies) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// the stage file is source string 0 in compile errors, includes are numbered in the order found
+	std::vector<std::string> files = { filename };
+	source.clear();
+	bool success = expand(filename, source, files, 0);
+	dependencies.assign(files.begin() + 1, files.end());
+
+	sm_loadTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return success;
+}
+
+void ShaderSource::invalidate(const std::string& filename) {
+	sm_cache.erase(filename);
+}
+
+void ShaderSource::clearCache() {
+	sm_cache.clear();
+}
+
+const std::string* ShaderSource::read(const std::string& filename) {
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return nullptr;
+
+	// the size catches most edits made within the same second as the last read
+	auto iter = sm_cache.find(filename);
+	if (iter != sm_cache.end() &&
+		iter->second.modified == info.st_mtime &&
+		iter->second.size == (long long)info.st_size) {
+		++sm_cacheHitCount;
+		return &iter->second.source;
+	}
+
+	FILE* file = nullptr;
+	fopen_s(&file, filename.c_str(), "rb");
+	if (file == nullptr)
+		return nullptr;
+	++sm_fileReadCount;
+
+	std::string source;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	source.resize(size > 0 ? (size_t)size : 0);
+	size_t read = source.empty() ? 0 : fread_s(&source[0], source.size(), sizeof(char), source.size(), file);
+	fclose(file);
+	if (read != source.size())
+		return nullptr;
+
+	CachedFile& cached = sm_cache[filename];
+	cached.modified = info.st_mtime;
+	cached.size = (long long)info.st_size;
+	cached.source.swap(source);
+	return &cached.source;
+}
+
+bool ShaderSource::expand(const std::string& filename, std::string& output, std::vector<std::string>& files, unsigned int depth) {
+	if (depth > MAX_INCLUDE_DEPTH) {
+		printf("Shader includes nested too deeply at [%s]\n", filename.c_str());
+		return false;
+	}
+
+	const std::string* source = read(filename);
+	if (source == nullptr) {
+		printf("Failed to read shader [%s]\n", filename.c_str());
+		return false;
+	}
+
+	size_t separator = filename.find_last_of("/\\");
+	std::string directory = separator == std::string::npos ? "" : filename.substr(0, separator + 1);
+	int sourceIndex = (int)(std::find(files.begin(), files.end(), filename) - files.begin());
+
+	size_t lineStart = 0;
+	int line = 1;
+	while (lineStart < source->size()) {
+		// GLSL ends a line at a lone CR too, and the #line numbers have to agree with it
+		size_t lineEnd = source->find_first_of("\r\n", lineStart);
+		if (lineEnd == std::string::npos)
+			lineEnd = source->size();
+		else if ((*source)[lineEnd] == '\r' &&
+				 lineEnd + 1 < source->size() &&
+				 (*source)[lineEnd + 1] == '\n')
+			lineEnd += 2;
+		else
+			++lineEnd;
+
+		// directives may be indented and have spaces after the #
+		size_t p = source->find_first_not_of(" \t", lineStart);
+		bool directive = p < lineEnd && (*source)[p] == '#';
+		if (directive)
+			p = source->find_first_not_of(" \t", p + 1);
+		if (directive == false ||
+			source->compare(p, 7, "include") != 0) {
+			output.append(*source, lineStart, lineEnd - lineStart);
+			lineStart = lineEnd;
+			++line;
+			continue;
+		}
+
+		size_t open = source->find('"', p + 7);
+		size_t close = open < lineEnd ? source->find('"', open + 1) : std::string::npos;
+		if (close >= lineEnd) {
+			printf("Malformed #include in [%s] line %d\n", filename.c_str(), line);
+			return false;
+		}
+
+		std::string name = source->substr(open + 1, close - open - 1);
+		bool absolute = name.empty() == false && (name[0] == '/' || name[0] == '\\' || name.find(':') != std::string::npos);
+		std::string path = absolute ? name : directory + name;
+
+		// a file already in this stage is skipped, which also stops include cycles
+		if (std::find(files.begin(), files.end(), path) == files.end()) {
+			files.push_back(path);
+			output += "#line 1 " + std::to_string(files.size() - 1) + "\n";
+			if (expand(path, output, files, depth + 1) == false) {
+				printf("Included from [%s] line %d\n", filename.c_str(), line);
+				return false;
+			}
+			if (output.empty() == false &&
+				output.back() != '\n' &&
+				output.back() != '\r')
+				output += '\n';
+		}
+
+		// back to the line after the #include in this file
+		output += "#line " + std::to_string(line + 1) + " " + std::to_string(sourceIndex) + "\n";
+		lineStart = lineEnd;
+		++line;
+	}
+	return true;
+}
+
+} // namespace aie
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace aie {
+
+// reads shader stage files, expanding #include "file" directives, through a cache of file
+// contents keyed by path and modification time. Variants and reloads of the same stage file
+// only read it from disk once for as long as it is unchanged
+class ShaderSource {
+public:
+
+	// reads a stage file with its includes expanded in place. Includes are resolved relative to
+	// the including file and each is only expanded once per stage, so they need no guards.
+	// Every included file is added to dependencies, not including the stage file itself
+	static bool load(const char* filename, std::string& source, std::vector<std::string>& dependencies);
+
+	// drops a file's cached contents so the next load reads it again, for files known to have
+	// changed within the modification time's resolution
+	static void invalidate(const std::string& filename);
+	static void clearCache();
+
+	// 0 if the file doesn't exist
+	static time_t getModifiedTime(const char* filename);
+
+	// files read from disk, loads of a file served from the cache, and the total time spent in load()
+	static unsigned int getFileReadCount() { return sm_fileReadCount; }
+	static unsigned int getCacheHitCount() { return sm_cacheHitCount; }
+	static float getLoadTime() { return sm_loadTime; }
+
+private:
+
+	// nested includes deeper than this are reported as an error, as they're likely a cycle
+	static const unsigned int MAX_INCLUDE_DEPTH = 16;
+
+	struct CachedFile {
+		time_t		modified;
+		long long	size;
+		std::string	source;
+	};
+
+	// returns the file's contents, or nullptr if it can't be read
+	static const std::string* read(const std::string& filename);
+
+	static bool expand(const std::string& filename, std::string& output, std::vector<std::string>& files, unsigned int depth);
+
+	static std::unordered_map<std::string, CachedFile>	sm_cache;
+
+	static unsigned int	sm_fileReadCount;
+	static unsigned int	sm_cacheHitCount;
+	static float		sm_loadTime;
+};
+
+} // namespace aie
@@ -0,0 +1,138 @@
+#include "ShaderVariants.h"
+#include "ShaderWatcher.h"
+#include <cassert>
+#include <cstdio>
+
+namespace aie {
+
+void ShaderVariants::setStage(unsigned int stage, const char* filename) {
+	assert(stage > 0 && stage < eShaderStage::SHADER_STAGE_Count);
+	assert(m_variants.empty() && "Stages must be set before any variant is built");
+	m_filenames[stage] = filename;
+}
+
+ShaderProgram* ShaderVariants::get(unsigned int lightCount, unsigned int features) {
+
+	unsigned int key = makeKey(lightCount, features);
+	auto iter = m_variants.find(key);
+	ShaderProgram* program = iter != m_variants.end() ? iter->second.get() : create(key, lightCount, features);
+	if (program == nullptr ||
+		program->isLinkPending() == false)
+		return program;
+
+	bool success = program->finishLink();
+	m_compileTime += program->getLinkTime();
+
+	// failures are cached too, so a broken variant is only compiled and reported once
+	if (success == false) {
+		printf("Shader variant (lights %u, features 0x%x) failed: %s\n", lightCount, features,
+			   program->getLastError() != nullptr ? program->getLastError() : "");
+		m_variants[key] = nullptr;
+		return nullptr;
+	}
+
+	if (m_watcher != nullptr) {
+		// a pipeline has no sources of its own, its stages reload and it attaches them on bind
+		if (program->isPipeline()) {
+			for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage)
+				if (program->getPipelineStage(stage) != nullptr)
+					m_watcher->watch(program->getPipelineStage(stage));
+		}
+		else
+			m_watcher->watch(program);
+	}
+
+	return program;
+}
+
+void ShaderVariants::prepare(unsigned int lightCount, unsigned int features) {
+	unsigned int key = makeKey(lightCount, features);
+	if (m_variants.find(key) == m_variants.end())
+		create(key, lightCount, features);
+}
+
+std::vector<std::string> ShaderVariants::makeDefines(unsigned int lightCount, unsigned int features) {
+	std::vector<std::string> defines;
+	if (lightCount != ANY_LIGHT_COUNT)
+		defines.push_back("LIGHT_COUNT " + std::to_string(lightCount));
+	if (features & DIFFUSE_TEXTURE)
+		defines.push_back("HAS_DIFFUSE_TEX");
+	if (features & NORMAL_MAP)
+		defines.push_back("HAS_NORMAL_MAP");
+	if (features & INSTANCED)
+		defines.push_back("INSTANCED");
+	return defines;
+}
+
+ShaderProgram* ShaderVariants::create(unsigned int key, unsigned int lightCount, unsigned int features) {
+
+	std::vector<std::string> defines = makeDefines(lightCount, features);
+
+	std::unique_ptr<ShaderProgram> program(new ShaderProgram());
+
+	if (m_separable) {
+		SharedStages* shared = createSharedStages(features & VERTEX_FEATURES);
+		if (shared == nullptr) {
+			m_variants[key] = nullptr;
+			return nullptr;
+		}
+
+		std::shared_ptr<ShaderProgram> fragment = std::make_shared<ShaderProgram>();
+		fragment->setSeparable(true);
+		fragment->setDefines(defines);
+		if (fragment->loadShader(eShaderStage::FRAGMENT, m_filenames[eShaderStage::FRAGMENT].c_str()) == false) {
+			m_variants[key] = nullptr;
+			return nullptr;
+		}
+
+		for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage)
+			if ((*shared)[stage] != nullptr)
+				program->setPipelineStage(stage, (*shared)[stage]);
+		program->setPipelineStage(eShaderStage::FRAGMENT, fragment);
+
+		program->submitLink();
+
+		ShaderProgram* result = program.get();
+		m_variants[key] = std::move(program);
+		return result;
+	}
+
+	program->setDefines(defines);
+
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (m_filenames[stage].empty() == false &&
+			program->loadShader(stage, m_filenames[stage].c_str()) == false) {
+			m_variants[key] = nullptr;
+			return nullptr;
+		}
+	}
+
+	program->submitLink();
+
+	ShaderProgram* result = program.get();
+	m_variants[key] = std::move(program);
+	return result;
+}
+
+ShaderVariants::SharedStages* ShaderVariants::createSharedStages(unsigned int vertexFeatures) {
+	assert(m_filenames[eShaderStage::FRAGMENT].empty() == false && "Separable variants need a fragment stage");
+
+	SharedStages& shared = m_sharedStages[vertexFeatures];
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (stage == eShaderStage::FRAGMENT ||
+			m_filenames[stage].empty() ||
+			shared[stage] != nullptr)
+			continue;
+
+		// the other stages only read the vertex features, so one build serves every light count
+		std::shared_ptr<ShaderProgram> program = std::make_shared<ShaderProgram>();
+		program->setSeparable(true);
+		program->setDefines(makeDefines(ANY_LIGHT_COUNT, vertexFeatures));
+		if (program->loadShader(stage, m_filenames[stage].c_str()) == false)
+			return nullptr;
+		shared[stage] = program;
+	}
+	return &shared;
+}
+
+} // namespace aie
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Shader.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace aie {
+
+class ShaderWatcher;
+
+// permutations of one shader built from the same stage files with different #defines injected.
+// Each variant is compiled the first time it is asked for and cached by its key
+class ShaderVariants {
+public:
+
+	// optional features, each injecting the #define named beside it
+	enum Feature : unsigned int {
+		DIFFUSE_TEXTURE	= 1 << 0,	// HAS_DIFFUSE_TEX
+		NORMAL_MAP		= 1 << 1,	// HAS_NORMAL_MAP
+		INSTANCED		= 1 << 2,	// INSTANCED, transforms come from an InstanceBuffer
+	};
+
+	// features the vertex stage reads, separable variants share one vertex stage per combination
+	static const unsigned int VERTEX_FEATURES = INSTANCED;
+
+	// light count for the generic variant, which loops over the light count uniform instead
+	// of having LIGHT_COUNT baked in
+	static const unsigned int ANY_LIGHT_COUNT = 0xff;
+
+	ShaderVariants() : m_watcher(nullptr), m_compileTime(0), m_separable(false) {}
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator = (const ShaderVariants&) = delete;
+
+	// the file every variant loads the stage from, set before the first get()
+	void setStage(unsigned int stage, const char* filename);
+
+	// variants are watched for hot reload as they are created
+	void setWatcher(ShaderWatcher* watcher) { m_watcher = watcher; }
+
+	// separable variants are pipelines where only the fragment stage is built per variant, every
+	// other stage is compiled once for each combination of VERTEX_FEATURES and shared. Variants
+	// are cached apart for each mode
+	void setSeparable(bool separable) { m_separable = separable; }
+	bool isSeparable() const { return m_separable; }
+
+	// returns the variant for the light count and features, compiling it if it doesn't exist yet.
+	// Returns nullptr if it fails to compile, which is reported once
+	ShaderProgram* get(unsigned int lightCount, unsigned int features);
+
+	// submits a variant's compile without waiting for it, so variants that will be needed soon
+	// compile in parallel. The first get() for the variant finishes its link
+	void prepare(unsigned int lightCount, unsigned int features);
+
+	size_t getVariantCount() const { return m_variants.size(); }
+
+	// total time spent compiling and linking variants, in milliseconds
+	float getCompileTime() const { return m_compileTime; }
+
+protected:
+
+	static const unsigned int SEPARABLE_KEY = 1 << 24;
+
+	unsigned int makeKey(unsigned int lightCount, unsigned int features) const {
+		return (features << 8) | (lightCount & 0xff) | (m_separable ? SEPARABLE_KEY : 0);
+	}
+
+	// creates the variant and submits its link
+	ShaderProgram* create(unsigned int key, unsigned int lightCount, unsigned int features);
+
+	// the defines a variant injects for its light count and features
+	static std::vector<std::string> makeDefines(unsigned int lightCount, unsigned int features);
+
+	// the stages shared by separable variants with the same vertex features, created by the first
+	typedef std::shared_ptr<ShaderProgram> SharedStages[eShaderStage::SHADER_STAGE_Count];
+	SharedStages* createSharedStages(unsigned int vertexFeatures);
+
+	std::string		m_filenames[eShaderStage::SHADER_STAGE_Count];
+
+	std::unordered_map<unsigned int, std::unique_ptr<ShaderProgram>>	m_variants;
+
+	// separable programs for every stage but fragment, which is always built per variant, keyed by
+	// the vertex features they were built with
+	std::unordered_map<unsigned int, SharedStages>	m_sharedStages;
+
+	ShaderWatcher*	m_watcher;
+	float			m_compileTime;
+	bool			m_separable;
+};
+
+} // namespace aie
@@ -0,0 +1,196 @@
+#include "ShaderWatcher.h"
+#include "Shader.h"
+#include "ShaderSource.h"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace aie {
+
+static void addUnique(std::vector<ShaderProgram*>& programs, ShaderProgram* program) {
+	if (std::find(programs.begin(), programs.end(), program) == programs.end())
+		programs.push_back(program);
+}
+
+// the first stage loaded from a file, as separable variants watch their vertex stage on its own
+static const std::string& getProgramFilename(const ShaderProgram& program) {
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		if (program.getFilename(stage).empty() == false)
+			return program.getFilename(stage);
+	}
+	return program.getFilename(eShaderStage::FRAGMENT);
+}
+
+ShaderWatcher::ShaderWatcher()
+	: m_inotify(-1),
+	m_pollInterval(0.5f),
+	m_lastPoll(std::chrono::steady_clock::now()),
+	m_reloadCount(0),
+	m_failedReloadCount(0),
+	m_updateTime(0),
+	m_peakUpdateTime(0) {
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0)
+		printf("inotify unavailable, polling shader files instead\n");
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+#ifdef __linux__
+	if (m_inotify >= 0)
+		close(m_inotify);
+#endif
+}
+
+void ShaderWatcher::watch(ShaderProgram* program) {
+	addUnique(m_programs, program);
+
+	for (unsigned int stage = 1; stage < eShaderStage::SHADER_STAGE_Count; ++stage) {
+		const std::string& filename = program->getFilename(stage);
+		if (filename.empty())
+			continue;
+		watchFile(filename, program);
+		for (auto& d : program->getDependencies(stage))
+			watchFile(d, program);
+	}
+}
+
+void ShaderWatcher::watchFile(const std::string& filename, ShaderProgram* program) {
+	auto iter = std::find_if(m_files.begin(), m_files.end(), [&](const WatchedFile& f) { return f.filename == filename; });
+	if (iter != m_files.end()) {
+		addUnique(iter->programs, program);
+		return;
+	}
+
+	WatchedFile file;
+	file.filename = filename;
+	size_t separator = filename.find_last_of("/\\");
+	file.directory = separator == std::string::npos ? "." : filename.substr(0, separator);
+	file.name = filename.substr(separator + 1);
+	file.modified = ShaderSource::getModifiedTime(filename.c_str());
+	file.programs.push_back(program);
+	m_files.push_back(file);
+
+	watchDirectory(file.directory);
+}
+
+void ShaderWatcher::watchDirectory(const std::string& directory) {
+#ifdef __linux__
+	if (m_inotify < 0)
+		return;
+	for (auto& d : m_directories)
+		if (d.second == directory)
+			return;
+
+	// editors often save by replacing the file, which a watch on the file itself wouldn't survive
+	int descriptor = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (descriptor < 0) {
+		printf("Failed to watch [%s], polling shader files instead\n", directory.c_str());
+		close(m_inotify);
+		m_inotify = -1;
+		m_directories.clear();
+		return;
+	}
+	m_directories.push_back({ descriptor, directory });
+#endif
+}
+
+void ShaderWatcher::readEvents(std::vector<ShaderProgram*>& changed) {
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+
+	for (;;) {
+		ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len) {
+			const inotify_event* event = (const inotify_event*)p;
+			if (event->len == 0)
+				continue;
+
+			auto directory = std::find_if(m_directories.begin(), m_directories.end(),
+										  [&](const std::pair<int, std::string>& d) { return d.first == event->wd; });
+			if (directory == m_directories.end())
+				continue;
+
+			for (auto& file : m_files) {
+				if (file.directory == directory->second &&
+					file.name == event->name) {
+					file.modified = ShaderSource::getModifiedTime(file.filename.c_str());
+					ShaderSource::invalidate(file.filename);
+					for (auto program : file.programs)
+						addUnique(changed, program);
+				}
+			}
+		}
+	}
+#endif
+}
+
+void ShaderWatcher::pollFiles(std::vector<ShaderProgram*>& changed) {
+	auto now = std::chrono::steady_clock::now();
+	if (std::chrono::duration<float>(now - m_lastPoll).count() < m_pollInterval)
+		return;
+	m_lastPoll = now;
+
+	for (auto& file : m_files) {
+		time_t modified = ShaderSource::getModifiedTime(file.filename.c_str());
+		if (modified == 0 ||
+			modified == file.modified)
+			continue;
+		file.modified = modified;
+		ShaderSource::invalidate(file.filename);
+		for (auto program : file.programs)
+			addUnique(changed, program);
+	}
+}
+
+void ShaderWatcher::update() {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<ShaderProgram*> changed;
+	if (m_inotify >= 0)
+		readEvents(changed);
+	else
+		pollFiles(changed);
+
+	// the reload reads the includes again, so pick up any that were added
+	for (auto program : changed) {
+		program->reload();
+		watch(program);
+	}
+
+	// programs that finish are swapped in here, between frames, so a draw never sees half a reload
+	for (auto program : m_programs) {
+		switch (program->updateReload()) {
+		case ShaderProgram::RELOAD_SUCCEEDED:
+			++m_reloadCount;
+			printf("Shader reloaded [%s]\n", getProgramFilename(*program).c_str());
+			break;
+		case ShaderProgram::RELOAD_FAILED:
+			++m_failedReloadCount;
+			printf("Shader reload failed, keeping the previous program: %s\n", program->getLastError());
+			break;
+		default:
+			break;
+		}
+	}
+
+	m_updateTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	m_peakUpdateTime = std::max(m_peakUpdateTime, m_updateTime);
+}
+
+bool ShaderWatcher::isReloading() const {
+	for (auto program : m_programs)
+		if (program->isReloading())
+			return true;
+	return false;
+}
+
+} // namespace aie
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace aie {
+
+class ShaderProgram;
+
+// watches the files shader programs were loaded from and reloads a program when one of them
+// changes. Uses inotify on Linux, and polls modification times elsewhere or if inotify fails
+class ShaderWatcher {
+public:
+
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	ShaderWatcher(const ShaderWatcher&) = delete;
+	ShaderWatcher& operator = (const ShaderWatcher&) = delete;
+
+	// watches every stage file of a program and the files they include, the program must outlive
+	// the watcher. A changed include only reloads the programs that include it
+	void watch(ShaderProgram* program);
+
+	// seconds between modification time checks when polling
+	void setPollInterval(float seconds) { m_pollInterval = seconds; }
+	float getPollInterval() const { return m_pollInterval; }
+
+	// starts reloading programs whose files have changed and swaps in any that have finished.
+	// Call once per frame, it never waits on the driver
+	void update();
+
+	bool isUsingINotify() const { return m_inotify >= 0; }
+
+	// true while any program has a reload in flight
+	bool isReloading() const;
+
+	unsigned int getReloadCount() const { return m_reloadCount; }
+	unsigned int getFailedReloadCount() const { return m_failedReloadCount; }
+
+	// time spent in update(), in milliseconds
+	float getUpdateTime() const { return m_updateTime; }
+	float getPeakUpdateTime() const { return m_peakUpdateTime; }
+
+protected:
+
+	struct WatchedFile {
+		std::string		filename;
+		std::string		directory;
+		std::string		name;
+		time_t			modified;
+
+		std::vector<ShaderProgram*>	programs;
+	};
+
+	void watchFile(const std::string& filename, ShaderProgram* program);
+
+	// marks the programs using each changed file
+	void readEvents(std::vector<ShaderProgram*>& changed);
+	void pollFiles(std::vector<ShaderProgram*>& changed);
+
+	void watchDirectory(const std::string& directory);
+
+	std::vector<WatchedFile>		m_files;
+	std::vector<ShaderProgram*>		m_programs;
+
+	// inotify instance and the directory behind each watch descriptor, -1 when polling
+	int								m_inotify;
+	std::vector<std::pair<int, std::string>>	m_directories;
+
+	float									m_pollInterval;
+	std::chrono::steady_clock::time_point	m_lastPoll;
+
+	unsigned int	m_reloadCount;
+	unsigned int	m_failedReloadCount;
+	float			m_updateTime;
+	float			m_peakUpdateTime;
+};
+
+} // namespace aie
@@ -0,0 +1,166 @@
+#include "StreamBuffer.h"
+#include "gl_core_4_4.h"
+#include "GLState.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace aie {
+
+StreamBuffer::StreamBuffer()
+	: m_handle(0),
+	m_data(nullptr),
+	m_frameSize(0),
+	m_frameCount(0),
+	m_frame(0),
+	m_offset(0),
+	m_fences(),
+	m_frameBytes(0),
+	m_lastFrameBytes(0),
+	m_peakFrameBytes(0),
+	m_overflowCount(0),
+	m_lastOverflowCount(0),
+	m_stallTime(0) {
+}
+
+StreamBuffer::~StreamBuffer() {
+	destroy();
+}
+
+bool StreamBuffer::create(size_t frameSize, unsigned int frameCount /* = 3 */) {
+
+	if (m_handle != 0) {
+		printf("Stream buffer already created!\n");
+		return false;
+	}
+
+	if (frameCount == 0 ||
+		frameCount > MAX_FRAME_COUNT) {
+		printf("Stream buffer needs 1 to %u frames!\n", MAX_FRAME_COUNT);
+		return false;
+	}
+
+	if (glBufferStorage == nullptr) {
+		printf("Stream buffer needs GL 4.4 buffer storage!\n");
+		return false;
+	}
+
+	m_frameSize = frameSize;
+	m_frameCount = frameCount;
+
+	// coherent, so writes reach the GPU without flushing and the mapping lasts until destroy()
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_handle);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, m_handle);
+	glBufferStorage(GL_ARRAY_BUFFER, frameSize * frameCount, nullptr, flags);
+	m_data = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, frameSize * frameCount, flags);
+
+	if (m_data == nullptr) {
+		printf("Failed to map stream buffer!\n");
+		destroy();
+		return false;
+	}
+
+	// the first beginFrame() starts on region 0, nothing fits before it
+	m_frame = frameCount - 1;
+	m_offset = frameSize;
+	return true;
+}
+
+void StreamBuffer::destroy() {
+	if (m_handle == 0)
+		return;
+
+	for (auto& fence : m_fences) {
+		if (fence != nullptr)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	if (m_data != nullptr) {
+		GLState::bindBuffer(GL_ARRAY_BUFFER, m_handle);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		m_data = nullptr;
+	}
+
+	GLState::removeBuffer(m_handle);
+	glDeleteBuffers(1, &m_handle);
+	m_handle = 0;
+}
+
+void StreamBuffer::beginFrame() {
+	if (m_handle == 0)
+		return;
+
+	m_lastFrameBytes = m_frameBytes;
+	m_lastOverflowCount = m_overflowCount;
+	m_frameBytes = 0;
+	m_overflowCount = 0;
+
+	m_frame = (m_frame + 1) % m_frameCount;
+	m_offset = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// the first wait flushes so the fence is sure to be reached, later ones only wait
+	GLsync& fence = m_fences[m_frame];
+	if (fence != nullptr) {
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		GLenum result;
+		while ((result = glClientWaitSync(fence, flags, 1000000000)) == GL_TIMEOUT_EXPIRED)
+			flags = 0;
+		if (result == GL_WAIT_FAILED)
+			printf("Stream buffer fence wait failed!\n");
+
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	m_stallTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void StreamBuffer::endFrame() {
+	// nothing written, nothing to wait for
+	if (m_handle == 0 ||
+		m_frameBytes == 0)
+		return;
+
+	if (m_fences[m_frame] != nullptr)
+		glDeleteSync(m_fences[m_frame]);
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void* StreamBuffer::allocate(size_t size, size_t alignment, size_t& offset) {
+	assert(alignment > 0 && "Invalid stream buffer alignment");
+	if (m_data == nullptr)
+		return nullptr;
+
+	// aligned within the whole buffer, so offsets can be used as vertex or index counts
+	size_t regionStart = m_frame * m_frameSize;
+	size_t start = (regionStart + m_offset + alignment - 1) / alignment * alignment;
+	if (start + size > regionStart + m_frameSize) {
+		++m_overflowCount;
+		return nullptr;
+	}
+
+	m_offset = start + size - regionStart;
+	m_frameBytes += size;
+	if (m_frameBytes > m_peakFrameBytes)
+		m_peakFrameBytes = m_frameBytes;
+
+	offset = start;
+	return m_data + start;
+}
+
+size_t StreamBuffer::write(const void* data, size_t size, size_t alignment) {
+	size_t offset = INVALID_OFFSET;
+	void* destination = allocate(size, alignment, offset);
+	if (destination == nullptr)
+		return INVALID_OFFSET;
+
+	memcpy(destination, data, size);
+	return offset;
+}
+
+} // namespace aie
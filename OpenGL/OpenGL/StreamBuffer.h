@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+
+struct __GLsync;
+
+namespace aie {
+
+// a ring of per frame regions in one persistently mapped buffer, for data written every frame
+// such as Gizmos and IMGUI vertices. Writes go straight in to the mapped memory, and a region
+// is only reused once a fence says the GPU has finished the frame that last read it, so
+// nothing is orphaned and no update waits on the GPU implicitly
+class StreamBuffer {
+public:
+
+	static const unsigned int MAX_FRAME_COUNT = 4;
+
+	// returned by write() when the frame's region is full
+	static const size_t INVALID_OFFSET = ~(size_t)0;
+
+	StreamBuffer();
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator = (const StreamBuffer&) = delete;
+
+	// creates and maps storage for frameCount frames in flight of frameSize bytes each. Will fail
+	// if already created, or without GL 4.4 buffer storage
+	bool create(size_t frameSize, unsigned int frameCount = 3);
+	void destroy();
+
+	// moves on to the next frame's region, waiting for the GPU to finish with it if it hasn't
+	void beginFrame();
+
+	// fences the frame's region, once every draw reading it has been issued
+	void endFrame();
+
+	// reserves size bytes of this frame's region at a multiple of alignment in the buffer,
+	// returning where to write them and setting offset. nullptr if the region is full
+	void* allocate(size_t size, size_t alignment, size_t& offset);
+
+	// copies data in to this frame's region, returning its offset or INVALID_OFFSET
+	size_t write(const void* data, size_t size, size_t alignment);
+
+	bool isCreated() const { return m_handle != 0; }
+
+	unsigned int getHandle() const { return m_handle; }
+	size_t getFrameSize() const { return m_frameSize; }
+	unsigned int getFrameCount() const { return m_frameCount; }
+
+	// bytes written during the last frame and the most in any frame
+	size_t getFrameBytes() const { return m_lastFrameBytes; }
+	size_t getPeakFrameBytes() const { return m_peakFrameBytes; }
+
+	// time in milliseconds the last beginFrame() waited on the GPU
+	float getStallTime() const { return m_stallTime; }
+
+	// allocations that didn't fit in the last frame's region
+	unsigned int getOverflowCount() const { return m_lastOverflowCount; }
+
+protected:
+
+	unsigned int	m_handle;
+	unsigned char*	m_data;
+	size_t			m_frameSize;
+	unsigned int	m_frameCount;
+
+	unsigned int	m_frame;
+	size_t			m_offset;
+	__GLsync*		m_fences[MAX_FRAME_COUNT];
+
+	size_t			m_frameBytes, m_lastFrameBytes, m_peakFrameBytes;
+	unsigned int	m_overflowCount, m_lastOverflowCount;
+	float			m_stallTime;
+};
+
+} // namespace aie
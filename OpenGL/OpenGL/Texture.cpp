@@ -1,18 +1,223 @@
 #include "gl_core_4_4.h"
 #include "Texture.h"
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "TextureResidency.h"
+#include "GLState.h"
+#include "Parallel.h"
+#include <chrono>
+#include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+// S3TC is an extension so isn't part of the core loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 namespace aie {
 
-Texture::Texture() 
+// bump to invalidate every cached mip chain after changing how they are generated
+static const unsigned int MIP_CACHE_VERSION = 1;
+
+Texture::MipFilter Texture::sm_mipFilter = Texture::MIP_FILTER_MITCHELL;
+
+// BC1 and BC3 need GL_EXT_texture_compression_s3tc, BC5 is core since 3.0
+static bool supportsS3TC() {
+	static int supported = -1;
+	if (supported < 0) {
+		supported = 0;
+		int count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (int i = 0; i < count && supported == 0; ++i) {
+			const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension != nullptr &&
+				strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0)
+				supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+static unsigned int encodingToInternalFormat(unsigned int encoding) {
+	switch (encoding) {
+	case TextureCache::BC1:	return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TextureCache::BC3:	return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TextureCache::BC5:	return GL_COMPRESSED_RG_RGTC2;
+	case TextureCache::R8:	return GL_R8;
+	case TextureCache::RG8:	return GL_RG8;
+	case TextureCache::RGB8:	return GL_RGB8;
+	case TextureCache::RGBA8:	return GL_RGBA8;
+	default:	return 0;
+	};
+}
+
+static unsigned int encodingToFormat(unsigned int encoding) {
+	switch (encoding) {
+	case TextureCache::R8:	return Texture::RED;
+	case TextureCache::BC5:
+	case TextureCache::RG8:	return Texture::RG;
+	case TextureCache::BC1:
+	case TextureCache::RGB8:	return Texture::RGB;
+	case TextureCache::BC3:
+	case TextureCache::RGBA8:	return Texture::RGBA;
+	default:	return 0;
+	};
+}
+
+static unsigned int formatToPixelFormat(unsigned int format) {
+	switch (format) {
+	case Texture::RED:	return GL_RED;
+	case Texture::RG:	return GL_RG;
+	case Texture::RGB:	return GL_RGB;
+	case Texture::RGBA:
+	default:	return GL_RGBA;
+	};
+}
+
+static bool hasTranslucentPixels(const unsigned char* rgba, size_t pixelCount) {
+	for (size_t i = 0; i < pixelCount; ++i)
+		if (rgba[i * 4 + 3] != 255)
+			return true;
+	return false;
+}
+
+// resizes one mip level into the next, split into horizontal strips across worker threads
+static void resizeLevel(const unsigned char* src, unsigned int srcWidth, unsigned int srcHeight,
+						unsigned char* dst, unsigned int dstWidth, unsigned int dstHeight,
+						unsigned int channels, bool isSRGB, unsigned int filter) {
+
+	// alpha is always linear and weights the colour channels
+	int alphaChannel = (channels == 2 || channels == 4) ? (int)channels - 1 : STBIR_ALPHA_CHANNEL_NONE;
+	stbir_colorspace space = isSRGB ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR;
+
+	const unsigned int rowsPerStrip = 32;
+	unsigned int stripCount = (dstHeight + rowsPerStrip - 1) / rowsPerStrip;
+
+	parallelFor(stripCount, [&](unsigned int strip) {
+		unsigned int firstRow = strip * rowsPerStrip;
+		unsigned int rowCount = std::min(rowsPerStrip, dstHeight - firstRow);
+
+		// each strip is the full resize shifted up by its first row, so rows
+		// either side of a strip boundary still filter across the real texels
+		stbir_resize_subpixel(src, srcWidth, srcHeight, 0,
+							  dst + (size_t)firstRow * dstWidth * channels, dstWidth, rowCount, 0,
+							  STBIR_TYPE_UINT8, channels, alphaChannel, 0,
+							  STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP,
+							  (stbir_filter)filter, (stbir_filter)filter, space, nullptr,
+							  (float)dstWidth / srcWidth, (float)dstHeight / srcHeight,
+							  0, (float)firstRow);
+	});
+}
+
+// builds the full mip chain of an image with 1 to 4 channels
+static void generateMipChain(const unsigned char* pixels, unsigned int width, unsigned int height,
+							 unsigned int channels, bool isSRGB, unsigned int filter,
+							 TextureCache::Image& image) {
+
+	static const unsigned int encodings[] = {
+		TextureCache::UNKNOWN, TextureCache::R8, TextureCache::RG8, TextureCache::RGB8, TextureCache::RGBA8
+	};
+
+	TextureCache::allocateMipChain(image, encodings[channels], width, height);
+	memcpy(image.data.data(), pixels, image.levels[0].size);
+
+	for (size_t i = 1; i < image.levels.size(); ++i) {
+		const TextureCache::Level& parent = image.levels[i - 1];
+		const TextureCache::Level& level = image.levels[i];
+		resizeLevel(image.getLevelData(i - 1), parent.width, parent.height,
+					image.data.data() + level.offset, level.width, level.height,
+					channels, isSRGB, filter);
+	}
+}
+
+// compresses a single RGBA mip level, one row of 4x4 blocks per job
+static void compressLevel(const unsigned char* rgba, unsigned int width, unsigned int height,
+						  unsigned int encoding, unsigned char* output) {
+
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	size_t blockSize = encoding == TextureCache::BC1 ? 8 : 16;
+
+	parallelFor(blocksY, [&](unsigned int by) {
+		unsigned char block[64];
+		unsigned char channel[64];
+		unsigned char scratch[16];
+
+		for (unsigned int bx = 0; bx < blocksX; ++bx) {
+
+			// gather the block, repeating edge texels to pad partial blocks
+			for (unsigned int y = 0; y < 4; ++y) {
+				unsigned int py = std::min(by * 4 + y, height - 1);
+				for (unsigned int x = 0; x < 4; ++x) {
+					unsigned int px = std::min(bx * 4 + x, width - 1);
+					memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)py * width + px) * 4, 4);
+				}
+			}
+
+			unsigned char* dest = output + ((size_t)by * blocksX + bx) * blockSize;
+
+			switch (encoding) {
+			case TextureCache::BC1:
+				stb_compress_dxt_block(dest, block, 0, STB_DXT_HIGHQUAL);
+				break;
+			case TextureCache::BC3:
+				stb_compress_dxt_block(dest, block, 1, STB_DXT_HIGHQUAL);
+				break;
+			case TextureCache::BC5:
+				// BC5 is two BC4 blocks, which share their layout with the DXT5 alpha block,
+				// so route red then green through the alpha channel and keep the first 8 bytes
+				for (unsigned int c = 0; c < 2; ++c) {
+					for (unsigned int i = 0; i < 16; ++i) {
+						memset(channel + i * 4, 0, 3);
+						channel[i * 4 + 3] = block[i * 4 + c];
+					}
+					stb_compress_dxt_block(scratch, channel, 1, STB_DXT_HIGHQUAL);
+					memcpy(dest + c * 8, scratch, 8);
+				}
+				break;
+			default:	break;
+			};
+		}
+	});
+}
+
+// block compresses every level of an RGBA8 mip chain
+static void compressMipChain(const TextureCache::Image& mips, unsigned int encoding, TextureCache::Image& image) {
+
+	TextureCache::allocateMipChain(image, encoding, mips.levels[0].width, mips.levels[0].height);
+
+	for (size_t i = 0; i < image.levels.size(); ++i) {
+		const TextureCache::Level& level = image.levels[i];
+		compressLevel(mips.getLevelData(i), level.width, level.height, encoding, image.data.data() + level.offset);
+	}
+}
+
+Texture::Texture()
 	: m_filename("none"),
 	m_width(0),
 	m_height(0),
 	m_glHandle(0),
 	m_format(0),
-	m_loadedPixels(nullptr) {
+	m_internalFormat(0),
+	m_mipLevelCount(0),
+	m_loadedPixels(nullptr),
+	m_compressed(false),
+	m_memorySize(0),
+	m_loadTime(0),
+	m_flags(0),
+	m_residency(RESIDENT),
+	m_residentLevel(0) {
 }
 
 Texture::Texture(const char * filename)
@@ -21,7 +226,15 @@ Texture::Texture(const char * filename)
 	m_height(0),
 	m_glHandle(0),
 	m_format(0),
-	m_loadedPixels(nullptr) {
+	m_internalFormat(0),
+	m_mipLevelCount(0),
+	m_loadedPixels(nullptr),
+	m_compressed(false),
+	m_memorySize(0),
+	m_loadTime(0),
+	m_flags(0),
+	m_residency(RESIDENT),
+	m_residentLevel(0) {
 
 	load(filename);
 }
@@ -30,73 +243,141 @@ Texture::Texture(unsigned int width, unsigned int height, Format format, unsigne
 	: m_filename("none"),
 	m_width(width),
 	m_height(height),
+	m_glHandle(0),
 	m_format(format),
-	m_loadedPixels(nullptr) {
+	m_internalFormat(0),
+	m_mipLevelCount(0),
+	m_loadedPixels(nullptr),
+	m_compressed(false),
+	m_memorySize(0),
+	m_loadTime(0),
+	m_flags(0),
+	m_residency(RESIDENT),
+	m_residentLevel(0) {
 
 	create(width, height, format, pixels);
 }
 
 Texture::~Texture() {
-	if (m_glHandle != 0)
+	TextureResidency::remove(this);
+	if (m_glHandle != 0) {
+		GLState::removeTexture(m_glHandle);
 		glDeleteTextures(1, &m_glHandle);
+	}
 	if (m_loadedPixels != nullptr)
 		stbi_image_free(m_loadedPixels);
 }
 
-bool Texture::load(const char* filename) {
+bool Texture::load(const char* filename, unsigned int flags /* = LOAD_DEFAULT */) {
+
+	auto startTime = std::chrono::high_resolution_clock::now();
 
 	if (m_glHandle != 0) {
+		GLState::removeTexture(m_glHandle);
 		glDeleteTextures(1, &m_glHandle);
 		m_glHandle = 0;
 		m_width = 0;
 		m_height = 0;
 		m_filename = "none";
+		m_compressed = false;
+		m_memorySize = 0;
+	}
+	if (m_loadedPixels != nullptr) {
+		stbi_image_free(m_loadedPixels);
+		m_loadedPixels = nullptr;
 	}
+	m_cachePath.clear();
+	m_residency = RESIDENT;
+	m_residentLevel = 0;
 
-	int x = 0, y = 0, comp = 0;
-	m_loadedPixels = stbi_load(filename, &x, &y, &comp, STBI_default);
+	bool isNormalMap = (flags & LOAD_NORMAL_MAP) != 0;
 
-	if (m_loadedPixels != nullptr) {
-		glGenTextures(1, &m_glHandle);
-		glBindTexture(GL_TEXTURE_2D, m_glHandle);
-		switch (comp) {
-		case STBI_grey:
-			m_format = RED;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, x, y,
-						 0, GL_RED, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_grey_alpha:
-			m_format = RG;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, x, y,
-						 0, GL_RG, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb:
-			m_format = RGB;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, x, y,
-						 0, GL_RGB, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		case STBI_rgb_alpha:
-			m_format = RGBA;
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y,
-						 0, GL_RGBA, GL_UNSIGNED_BYTE, m_loadedPixels);
-			break;
-		default:	break;
-		};
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		m_width = (unsigned int)x;
-		m_height = (unsigned int)y;
-		m_filename = filename;
-		return true;
+	// BC1 and BC3 fall back to an uncompressed mip chain if the format isn't supported
+	bool compress = (flags & LOAD_COMPRESSED) != 0 &&
+		(isNormalMap || supportsS3TC());
+
+	// colour maps are authored in sRGB so their mips are filtered in linear light
+	bool isSRGB = isNormalMap == false &&
+		(flags & LOAD_LINEAR) == 0;
+
+	unsigned int settings = (MIP_CACHE_VERSION << 16) | (isSRGB ? 0x100 : 0) | sm_mipFilter;
+
+	std::string cachePath = TextureCache::getCachePath(filename, compress);
+	TextureCache::Image image;
+
+	bool cached = TextureCache::isFresh(filename, cachePath.c_str()) &&
+		TextureCache::read(cachePath.c_str(), image) &&
+		image.settings == settings;
+
+	// a normal map must come back as BC5 and a colour map must not
+	if (cached && compress &&
+		isNormalMap != (image.encoding == TextureCache::BC5))
+		cached = false;
+
+	if (cached == false) {
+		// decode straight from the mapped file rather than through stdio's buffered reads
+		MappedFile source;
+		if (source.open(filename) == false)
+			return false;
+
+		int x = 0, y = 0, comp = 0;
+		unsigned char* pixels = stbi_load_from_memory(source.getData(), (int)source.getSize(), &x, &y, &comp,
+													  compress ? STBI_rgb_alpha : STBI_default);
+		source.close();
+		if (pixels == nullptr)
+			return false;
+
+		TextureCache::Image mips;
+		generateMipChain(pixels, (unsigned int)x, (unsigned int)y, compress ? 4 : comp, isSRGB, sm_mipFilter, mips);
+
+		if (compress) {
+			unsigned int encoding = TextureCache::BC1;
+			if (isNormalMap)
+				encoding = TextureCache::BC5;
+			else if (hasTranslucentPixels(pixels, (size_t)x * y))
+				encoding = TextureCache::BC3;
+
+			compressMipChain(mips, encoding, image);
+		}
+		else {
+			image = std::move(mips);
+		}
+		stbi_image_free(pixels);
+
+		image.settings = settings;
+		if (TextureCache::write(cachePath.c_str(), image) == false)
+			printf("Failed to write texture cache [%s]\n", cachePath.c_str());
 	}
-	return false;
+
+	m_format = encodingToFormat(image.encoding);
+	m_internalFormat = encodingToInternalFormat(image.encoding);
+	m_mipLevelCount = (unsigned int)image.levels.size();
+	m_compressed = TextureCache::isBlockCompressed(image.encoding);
+	m_width = image.levels[0].width;
+	m_height = image.levels[0].height;
+	m_filename = filename;
+	m_flags = flags;
+	m_cachePath = cachePath;
+
+	upload(image, 0);
+
+	// the base level is only kept on the CPU when asked for, as a malloc'd copy so it's freed like stbi's
+	if ((flags & LOAD_KEEP_PIXELS) != 0 &&
+		m_compressed == false) {
+		m_loadedPixels = (unsigned char*)malloc(image.levels[0].size);
+		memcpy(m_loadedPixels, image.getLevelData(0), image.levels[0].size);
+	}
+
+	TextureResidency::add(this);
+
+	m_loadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	return true;
 }
 
 void Texture::create(unsigned int width, unsigned int height, Format format, unsigned char* pixels) {
 
 	if (m_glHandle != 0) {
+		GLState::removeTexture(m_glHandle);
 		glDeleteTextures(1, &m_glHandle);
 		m_glHandle = 0;
 		m_filename = "none";
@@ -105,9 +386,14 @@ void Texture::create(unsigned int width, unsigned int height, Format format, uns
 	m_width = width;
 	m_height = height;
 	m_format = format;
+	m_mipLevelCount = 1;
+	m_compressed = false;
+	m_cachePath.clear();
+	m_residency = RESIDENT;
+	m_residentLevel = 0;
 
 	glGenTextures(1, &m_glHandle);
-	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	GLState::bindTexture(m_glHandle);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -117,25 +403,127 @@ void Texture::create(unsigned int width, unsigned int height, Format format, uns
 
 	switch (m_format) {
 	case RED:
+		m_internalFormat = GL_R8;
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
 		break;
 	case RG:
+		m_internalFormat = GL_RG8;
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG, m_width, m_height, 0, GL_RG, GL_UNSIGNED_BYTE, pixels);
 		break;
 	case RGB:
+		m_internalFormat = GL_RGB8;
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
 		break;
 	case RGBA:
 	default:
+		m_internalFormat = GL_RGBA8;
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 	};
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(0);
+
+	// format values are the channel count
+	m_memorySize = (size_t)m_width * m_height * m_format;
+	TextureResidency::add(this);
 }
 
 void Texture::bind(unsigned int slot) const {
-	glActiveTexture(GL_TEXTURE0 + slot);
-	glBindTexture(GL_TEXTURE_2D, m_glHandle);
+	GLState::bindTexture(slot, makeResident());
+}
+
+unsigned int Texture::makeResident() const {
+	TextureResidency::touch(this);
+	return m_glHandle;
+}
+
+size_t Texture::getCPUMemorySize() const {
+	return m_loadedPixels != nullptr ? (size_t)m_width * m_height * m_format : 0;
+}
+
+unsigned int Texture::getSmallMipLevel(unsigned int size) const {
+	unsigned int level = 0;
+	while (level + 1 < m_mipLevelCount &&
+		   std::max(m_width >> level, m_height >> level) > size)
+		++level;
+	return level;
+}
+
+void Texture::upload(const TextureCache::Image& image, size_t firstLevel) {
+
+	unsigned int levelCount = (unsigned int)(image.levels.size() - firstLevel);
+
+	// immutable storage for the whole chain, then each level uploaded in turn
+	glGenTextures(1, &m_glHandle);
+	GLState::bindTexture(m_glHandle);
+	glTexStorage2D(GL_TEXTURE_2D, levelCount, m_internalFormat,
+				   image.levels[firstLevel].width, image.levels[firstLevel].height);
+
+	// levels read from the cache point straight in to its mapped pages, so they're
+	// uploaded without being copied. RGB and single channel rows aren't 4 byte aligned
+	m_memorySize = 0;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = firstLevel; i < image.levels.size(); ++i) {
+		const TextureCache::Level& level = image.levels[i];
+		int target = (int)(i - firstLevel);
+		if (m_compressed)
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, target, 0, 0, level.width, level.height,
+									  m_internalFormat, (int)level.size, image.getLevelData(i));
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, target, 0, 0, level.width, level.height,
+							formatToPixelFormat(m_format), GL_UNSIGNED_BYTE, image.getLevelData(i));
+		m_memorySize += level.size;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// the CPU built chain is what gets sampled when minifying
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)levelCount - 1);
+	GLState::bindTexture(0);
+
+	m_residentLevel = (unsigned int)firstLevel;
+	m_residency = firstLevel == 0 ? RESIDENT : RESIDENT_SMALL_MIPS;
+}
+
+bool Texture::reload(unsigned int firstLevel) {
+
+	if (isEvictable() == false)
+		return false;
+
+	// the cache should still match what was loaded, anything else is a full reload
+	TextureCache::Image image;
+	if (TextureCache::read(m_cachePath.c_str(), image) == false ||
+		encodingToInternalFormat(image.encoding) != m_internalFormat ||
+		image.levels.size() != m_mipLevelCount ||
+		image.levels[0].width != m_width ||
+		image.levels[0].height != m_height) {
+		if (firstLevel != 0)
+			return false;
+		std::string filename = m_filename;
+		return load(filename.c_str(), m_flags);
+	}
+
+	if (m_glHandle != 0) {
+		GLState::removeTexture(m_glHandle);
+		glDeleteTextures(1, &m_glHandle);
+	}
+	m_glHandle = 0;
+
+	upload(image, std::min((size_t)firstLevel, image.levels.size() - 1));
+	return true;
+}
+
+void Texture::evict() {
+	if (isEvictable() == false)
+		return;
+
+	if (m_glHandle != 0) {
+		GLState::removeTexture(m_glHandle);
+		glDeleteTextures(1, &m_glHandle);
+	}
+	m_glHandle = 0;
+	m_memorySize = 0;
+	m_residency = EVICTED;
 }
 
-} // namespace aie
\ No newline at end of file
+} // namespace aie
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "TextureCache.h"
 
 namespace aie {
 
@@ -15,13 +16,43 @@ public:
 		RGBA
 	};
 
+	// flags that control how an image file is processed by load()
+	enum LoadFlags : unsigned int {
+		LOAD_DEFAULT	= 0,
+		LOAD_COMPRESSED	= 1 << 0,	// block compress every mip level (BC1 opaque, BC3 alpha) and cache it to disk
+		LOAD_NORMAL_MAP	= 1 << 1,	// tangent-space normal map, filtered linearly and stored as BC5 when compressed
+		LOAD_LINEAR		= 1 << 2,	// non-colour data (alpha, displacement), mips are filtered without sRGB conversion
+		LOAD_KEEP_PIXELS	= 1 << 3,	// keep the uncompressed base level on the CPU for getPixels(), otherwise only the GPU copy is kept
+	};
+
+	// how much of a loaded texture is in video memory, see TextureResidency
+	enum Residency : unsigned int {
+		RESIDENT = 0,
+		RESIDENT_SMALL_MIPS,	// only the mips at or below TextureResidency's small mip size
+		EVICTED,
+	};
+
+	// filters used to generate mip chains on the CPU, matching stb_image_resize's stbir_filter
+	enum MipFilter : unsigned int {
+		MIP_FILTER_BOX = 1,
+		MIP_FILTER_TRIANGLE,
+		MIP_FILTER_CUBIC_BSPLINE,
+		MIP_FILTER_CATMULL_ROM,
+		MIP_FILTER_MITCHELL,
+	};
+
 	Texture();
 	Texture(const char* filename);
 	Texture(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
 	virtual ~Texture();
 
-	// load a jpg, bmp, png or tga
-	bool load(const char* filename);
+	// load a jpg, bmp, png or tga, building its mip chain on worker threads, or the
+	// previously built chain from the texture cache
+	bool load(const char* filename, unsigned int flags = LOAD_DEFAULT);
+
+	// filter used by every following load(), cached chains built with another filter are rebuilt
+	static void setMipFilter(MipFilter filter) { sm_mipFilter = filter; }
+	static MipFilter getMipFilter() { return sm_mipFilter; }
 
 	// creates a texture that can be filled in with pixels
 	void create(unsigned int width, unsigned int height, Format format, unsigned char* pixels = nullptr);
@@ -29,25 +60,79 @@ public:
 	// returns the filename or "none" if not loaded from a file
 	const std::string& getFilename() const { return m_filename; }
 
-	// binds the texture to the specified slot
+	// binds the texture to the specified slot, reloading it first if it was evicted
 	void bind(unsigned int slot) const;
 
 	// returns the opengl texture handle
 	unsigned int getHandle() const { return m_glHandle; }
 
+	// marks the texture as used this frame and returns its handle, reloading it first if it was evicted
+	unsigned int makeResident() const;
+
 	unsigned int getWidth() const { return m_width; }
 	unsigned int getHeight() const { return m_height; }
 	unsigned int getFormat() const { return m_format; }
+
+	// the sized opengl internal format, e.g. GL_RGBA8 or a compressed format
+	unsigned int getInternalFormat() const { return m_internalFormat; }
+	unsigned int getMipLevelCount() const { return m_mipLevelCount; }
+
+	// returns nullptr unless the texture was loaded uncompressed with LOAD_KEEP_PIXELS
 	const unsigned char* getPixels() const { return m_loadedPixels; }
 
+	// true if the texture was uploaded block compressed
+	bool isCompressed() const { return m_compressed; }
+
+	// video memory used by the resident mip levels, in bytes
+	size_t getMemorySize() const { return m_memorySize; }
+
+	// memory used by pixels kept on the CPU, in bytes
+	size_t getCPUMemorySize() const;
+
+	Residency getResidency() const { return m_residency; }
+	unsigned int getResidentLevel() const { return m_residentLevel; }
+
+	// only textures loaded from a file can be evicted, as they can be read back from the texture cache
+	bool isEvictable() const { return m_cachePath.empty() == false; }
+
+	// time taken by the last call to load(), in milliseconds
+	float getLoadTime() const { return m_loadTime; }
+
 protected:
 
+	friend class TextureResidency;
+
+	// uploads the levels of an image from firstLevel down as a new texture
+	void upload(const TextureCache::Image& image, size_t firstLevel);
+
+	// re-reads the texture cache and uploads from firstLevel down, replacing the current handle
+	bool reload(unsigned int firstLevel);
+
+	// releases the video memory, the texture is reloaded when next bound
+	void evict();
+
+	// the first mip level no larger than size in either dimension
+	unsigned int getSmallMipLevel(unsigned int size) const;
+
+	static MipFilter	sm_mipFilter;
+
 	std::string		m_filename;
 	unsigned int	m_width;
 	unsigned int	m_height;
 	unsigned int	m_glHandle;
 	unsigned int	m_format;
+	unsigned int	m_internalFormat;
+	unsigned int	m_mipLevelCount;
 	unsigned char*	m_loadedPixels;
+	bool			m_compressed;
+	size_t			m_memorySize;
+	float			m_loadTime;
+
+	// what's needed to reload the texture after it was evicted
+	unsigned int	m_flags;
+	std::string		m_cachePath;
+	Residency		m_residency;
+	unsigned int	m_residentLevel;
 };
 
 } // namespace aie
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "gl_core_4_4.h"
+#include "TextureAtlas.h"
+#include "Texture.h"
+#include "GLState.h"
+#include <algorithm>
+#include <cstdio>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
+// S3TC is an extension so isn't part of the core loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace aie {
+
+// byte size of one mip level of the formats Texture creates
+static size_t getLevelSize(unsigned int internalFormat, unsigned int width, unsigned int height) {
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (internalFormat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:	return blocks * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:	return blocks * 16;
+	case GL_R8:		return (size_t)width * height;
+	case GL_RG8:	return (size_t)width * height * 2;
+	case GL_RGB8:	return (size_t)width * height * 3;
+	default:		return (size_t)width * height * 4;
+	};
+}
+
+TextureAtlas::TextureAtlas()
+	: m_glHandle(0),
+	m_width(0),
+	m_height(0),
+	m_levelCount(0),
+	m_gutter(0),
+	m_blockSize(1),
+	m_memorySize(0) {
+}
+
+TextureAtlas::~TextureAtlas() {
+	if (m_glHandle != 0) {
+		GLState::removeTexture(m_glHandle);
+		glDeleteTextures(1, &m_glHandle);
+	}
+}
+
+bool TextureAtlas::layout(const std::vector<glm::uvec2>& sizes, unsigned int maxSize, unsigned int levelCount, bool compressed) {
+
+	m_rects.clear();
+	m_regions.clear();
+
+	if (sizes.empty() || levelCount == 0)
+		return false;
+
+	// drop levels until every packed level starts on a whole block and spans whole blocks
+	unsigned int blockSize = compressed ? 4 : 1;
+	while (levelCount > 1) {
+		unsigned int alignment = blockSize << (levelCount - 1);
+		bool aligned = true;
+		for (auto& size : sizes)
+			aligned &= size.x % alignment == 0 && size.y % alignment == 0;
+		if (aligned)
+			break;
+		--levelCount;
+	}
+	unsigned int alignment = blockSize << (levelCount - 1);
+
+	// the smallest level keeps a block of gutter, enough for its filter footprint, and
+	// the gutter halves with each level up so doubles going the other way
+	unsigned int gutter = alignment;
+
+	for (auto& size : sizes) {
+		if (size.x == 0 || size.y == 0 ||
+			size.x % alignment != 0 || size.y % alignment != 0)
+			return false;
+	}
+
+	std::vector<stbrp_rect> rects(sizes.size());
+	for (size_t i = 0; i < sizes.size(); ++i) {
+		rects[i].id = (int)i;
+		rects[i].w = (stbrp_coord)(sizes[i].x + gutter * 2);
+		rects[i].h = (stbrp_coord)(sizes[i].y + gutter * 2);
+	}
+
+	std::vector<stbrp_node> nodes(maxSize);
+	stbrp_context context;
+	stbrp_init_target(&context, maxSize, maxSize, nodes.data(), (int)nodes.size());
+	stbrp_pack_rects(&context, rects.data(), (int)rects.size());
+	for (auto& r : rects) {
+		if (r.was_packed == 0)
+			return false;
+	}
+
+	// shrink the page to what was used, rect positions are sums of aligned sizes so stay aligned
+	unsigned int width = 0, height = 0;
+	for (auto& r : rects) {
+		width = std::max(width, (unsigned int)(r.x + r.w));
+		height = std::max(height, (unsigned int)(r.y + r.h));
+	}
+
+	m_width = width;
+	m_height = height;
+	m_levelCount = levelCount;
+	m_gutter = gutter;
+	m_blockSize = blockSize;
+
+	m_rects.resize(rects.size());
+	m_regions.resize(rects.size());
+	for (auto& r : rects) {
+		Rect rect = { (unsigned int)r.x + gutter, (unsigned int)r.y + gutter, sizes[r.id].x, sizes[r.id].y };
+		m_rects[r.id] = rect;
+		m_regions[r.id].offset = glm::vec2((float)rect.x / width, (float)rect.y / height);
+		m_regions[r.id].scale = glm::vec2((float)rect.width / width, (float)rect.height / height);
+	}
+
+	return true;
+}
+
+void TextureAtlas::copyLayout(const TextureAtlas& other) {
+	m_rects = other.m_rects;
+	m_regions = other.m_regions;
+	m_width = other.m_width;
+	m_height = other.m_height;
+	m_levelCount = other.m_levelCount;
+	m_gutter = other.m_gutter;
+	m_blockSize = other.m_blockSize;
+}
+
+bool TextureAtlas::build(const std::vector<const Texture*>& textures) {
+
+	if (m_glHandle != 0) {
+		printf("Atlas already built!\n");
+		return false;
+	}
+
+	if (textures.size() != m_rects.size() || textures.empty()) {
+		printf("Atlas texture count doesn't match its layout!\n");
+		return false;
+	}
+
+	unsigned int internalFormat = textures[0]->getInternalFormat();
+	for (size_t i = 0; i < textures.size(); ++i) {
+		const Texture* texture = textures[i];
+		if (texture->getHandle() == 0 ||
+			texture->getInternalFormat() != internalFormat ||
+			texture->getMipLevelCount() < m_levelCount ||
+			texture->getWidth() != m_rects[i].width ||
+			texture->getHeight() != m_rects[i].height) {
+			printf("Atlas texture [%s] doesn't match its layout!\n", texture->getFilename().c_str());
+			return false;
+		}
+	}
+
+	glGenTextures(1, &m_glHandle);
+	GLState::bindTexture(m_glHandle);
+	glTexStorage2D(GL_TEXTURE_2D, m_levelCount, internalFormat, m_width, m_height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levelCount - 1);
+	GLState::bindTexture(0);
+
+	// copies stay on the GPU, no pixels need to be kept on the CPU. Compressed textures can
+	// only be copied a block at a time, so their gutters repeat the edge block rather than the
+	// edge texel, which still only blends in texels of the same texture
+	m_memorySize = 0;
+	for (unsigned int level = 0; level < m_levelCount; ++level) {
+		unsigned int gutter = m_gutter >> level;
+		for (size_t i = 0; i < textures.size(); ++i) {
+			unsigned int source = textures[i]->getHandle();
+			unsigned int x = m_rects[i].x >> level;
+			unsigned int y = m_rects[i].y >> level;
+			unsigned int width = m_rects[i].width >> level;
+			unsigned int height = m_rects[i].height >> level;
+
+			glCopyImageSubData(source, GL_TEXTURE_2D, level, 0, 0, 0,
+							   m_glHandle, GL_TEXTURE_2D, level, x, y, 0, width, height, 1);
+
+			// the columns either side, then the rows above and below across the full padded
+			// width, so the corners repeat the corner texels
+			for (unsigned int offset = m_blockSize; offset <= gutter; offset += m_blockSize) {
+				glCopyImageSubData(source, GL_TEXTURE_2D, level, 0, 0, 0,
+								   m_glHandle, GL_TEXTURE_2D, level, x - offset, y, 0, m_blockSize, height, 1);
+				glCopyImageSubData(source, GL_TEXTURE_2D, level, width - m_blockSize, 0, 0,
+								   m_glHandle, GL_TEXTURE_2D, level, x + width + offset - m_blockSize, y, 0, m_blockSize, height, 1);
+			}
+			for (unsigned int offset = m_blockSize; offset <= gutter; offset += m_blockSize) {
+				glCopyImageSubData(m_glHandle, GL_TEXTURE_2D, level, x - gutter, y, 0,
+								   m_glHandle, GL_TEXTURE_2D, level, x - gutter, y - offset, 0, width + gutter * 2, m_blockSize, 1);
+				glCopyImageSubData(m_glHandle, GL_TEXTURE_2D, level, x - gutter, y + height - m_blockSize, 0,
+								   m_glHandle, GL_TEXTURE_2D, level, x - gutter, y + height + offset - m_blockSize, 0, width + gutter * 2, m_blockSize, 1);
+			}
+		}
+		m_memorySize += getLevelSize(internalFormat, std::max(1u, m_width >> level), std::max(1u, m_height >> level));
+	}
+
+	return true;
+}
+
+} // namespace aie
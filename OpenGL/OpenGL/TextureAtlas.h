@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <vector>
+
+namespace aie {
+
+class Texture;
+
+// packs a set of small textures that share an internal format into a single
+// texture so that they can be drawn without rebinding
+class TextureAtlas {
+public:
+
+	// where a packed texture ended up, texture coordinates are remapped with uv * scale + offset
+	struct Region {
+		glm::vec2 offset;
+		glm::vec2 scale;
+	};
+
+	TextureAtlas();
+	~TextureAtlas();
+
+	// positions rectangles of the given sizes within a page no larger than maxSize,
+	// fails if they don't all fit. levelCount is lowered until every level stays block aligned.
+	// Each rectangle is padded by a gutter wide enough that filtering its smallest level
+	// never reaches a neighbour
+	bool layout(const std::vector<glm::uvec2>& sizes, unsigned int maxSize, unsigned int levelCount, bool compressed);
+
+	// copies the textures into the page on the GPU, in the same order as the layout sizes,
+	// filling each gutter by repeating the texture's edge. Textures must share their
+	// internal format and have at least levelCount mip levels.
+	bool build(const std::vector<const Texture*>& textures);
+
+	// copies the layout of another atlas, so several atlases can share the same texture coordinates
+	void copyLayout(const TextureAtlas& other);
+
+	const Region& getRegion(size_t index) const { return m_regions[index]; }
+	size_t getRegionCount() const { return m_regions.size(); }
+
+	unsigned int getHandle() const { return m_glHandle; }
+	unsigned int getWidth() const { return m_width; }
+	unsigned int getHeight() const { return m_height; }
+	unsigned int getLevelCount() const { return m_levelCount; }
+
+	// texels of padding around each region at the top level, halving with each level
+	unsigned int getGutter() const { return m_gutter; }
+
+	// video memory used by all mip levels, in bytes
+	size_t getMemorySize() const { return m_memorySize; }
+
+protected:
+
+	// a texture's place in the page, not including its gutter
+	struct Rect {
+		unsigned int x, y, width, height;
+	};
+
+	std::vector<Rect>	m_rects;
+	std::vector<Region>	m_regions;
+
+	unsigned int	m_glHandle;
+	unsigned int	m_width;
+	unsigned int	m_height;
+	unsigned int	m_levelCount;
+	unsigned int	m_gutter;
+	unsigned int	m_blockSize;
+	size_t			m_memorySize;
+};
+
+} // namespace aie
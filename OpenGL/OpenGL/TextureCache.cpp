@@ -0,0 +1,260 @@
+#include "TextureCache.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace aie {
+
+// DDS header layout, see "Programming Guide for DDS" on MSDN
+struct DDSPixelFormat {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rBitMask;
+	uint32_t gBitMask;
+	uint32_t bBitMask;
+	uint32_t aBitMask;
+};
+
+struct DDSHeader {
+	uint32_t		size;
+	uint32_t		flags;
+	uint32_t		height;
+	uint32_t		width;
+	uint32_t		pitchOrLinearSize;
+	uint32_t		depth;
+	uint32_t		mipMapCount;
+	uint32_t		reserved1[11];
+	DDSPixelFormat	pixelFormat;
+	uint32_t		caps;
+	uint32_t		caps2;
+	uint32_t		caps3;
+	uint32_t		caps4;
+	uint32_t		reserved2;
+};
+
+static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+
+static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+static const uint32_t DDSD_CAPS = 0x1;
+static const uint32_t DDSD_HEIGHT = 0x2;
+static const uint32_t DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PITCH = 0x8;
+static const uint32_t DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSD_LINEARSIZE = 0x80000;
+
+static const uint32_t DDPF_ALPHAPIXELS = 0x1;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDPF_LUMINANCE = 0x20000;
+
+// stored in the header's reserved space so a cache made with other settings is rejected
+static const uint32_t SETTINGS_MARKER = 0x53454941; // "AIES"
+
+static const uint32_t DDSCAPS_COMPLEX = 0x8;
+static const uint32_t DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+static uint32_t makeFourCC(char a, char b, char c, char d) {
+	return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+}
+
+static uint32_t encodingToFourCC(unsigned int encoding) {
+	switch (encoding) {
+	case TextureCache::BC1:	return makeFourCC('D', 'X', 'T', '1');
+	case TextureCache::BC3:	return makeFourCC('D', 'X', 'T', '5');
+	case TextureCache::BC5:	return makeFourCC('A', 'T', 'I', '2');
+	default:	return 0;
+	};
+}
+
+static unsigned int fourCCToEncoding(uint32_t fourCC) {
+	if (fourCC == makeFourCC('D', 'X', 'T', '1'))
+		return TextureCache::BC1;
+	if (fourCC == makeFourCC('D', 'X', 'T', '5'))
+		return TextureCache::BC3;
+	if (fourCC == makeFourCC('A', 'T', 'I', '2'))
+		return TextureCache::BC5;
+	return TextureCache::UNKNOWN;
+}
+
+static unsigned int getChannelCount(unsigned int encoding) {
+	switch (encoding) {
+	case TextureCache::R8:	return 1;
+	case TextureCache::RG8:	return 2;
+	case TextureCache::RGB8:	return 3;
+	case TextureCache::RGBA8:	return 4;
+	default:	return 0;
+	};
+}
+
+std::string TextureCache::getCachePath(const char* filename, bool compressed) {
+	return std::string(filename) + (compressed ? ".dds" : ".mips.dds");
+}
+
+bool TextureCache::isFresh(const char* filename, const char* cachePath) {
+	struct stat source, cache;
+	if (stat(cachePath, &cache) != 0)
+		return false;
+	// a cache without its source is still usable
+	if (stat(filename, &source) != 0)
+		return true;
+	return cache.st_mtime >= source.st_mtime;
+}
+
+size_t TextureCache::getLevelSize(unsigned int encoding, unsigned int width, unsigned int height) {
+	size_t blocksX = (width + 3) / 4;
+	size_t blocksY = (height + 3) / 4;
+	if (blocksX == 0) blocksX = 1;
+	if (blocksY == 0) blocksY = 1;
+
+	switch (encoding) {
+	case BC1:	return blocksX * blocksY * 8;
+	case BC3:
+	case BC5:	return blocksX * blocksY * 16;
+	default:	return (size_t)width * height * getChannelCount(encoding);
+	};
+}
+
+size_t TextureCache::layoutMipChain(std::vector<Level>& levels, unsigned int encoding, unsigned int width, unsigned int height) {
+
+	levels.clear();
+
+	size_t totalSize = 0;
+	while (true) {
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.offset = totalSize;
+		level.size = getLevelSize(encoding, width, height);
+		totalSize += level.size;
+		levels.push_back(level);
+		if (width == 1 && height == 1)
+			break;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return totalSize;
+}
+
+void TextureCache::allocateMipChain(Image& image, unsigned int encoding, unsigned int width, unsigned int height) {
+
+	image.encoding = encoding;
+	image.file.reset();
+	image.mappedData = nullptr;
+	image.data.resize(layoutMipChain(image.levels, encoding, width, height));
+}
+
+bool TextureCache::read(const char* cachePath, Image& image) {
+
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (file->open(cachePath) == false ||
+		file->getSize() < sizeof(uint32_t) + sizeof(DDSHeader))
+		return false;
+
+	uint32_t magic = 0;
+	DDSHeader header = {};
+	memcpy(&magic, file->getData(), sizeof(magic));
+	memcpy(&header, file->getData() + sizeof(magic), sizeof(header));
+	if (magic != DDS_MAGIC ||
+		header.size != sizeof(DDSHeader) ||
+		header.width == 0 ||
+		header.height == 0)
+		return false;
+
+	if (header.pixelFormat.flags & DDPF_FOURCC) {
+		image.encoding = fourCCToEncoding(header.pixelFormat.fourCC);
+	}
+	else {
+		switch (header.pixelFormat.rgbBitCount) {
+		case 8:		image.encoding = R8;	break;
+		case 16:	image.encoding = RG8;	break;
+		case 24:	image.encoding = RGB8;	break;
+		case 32:	image.encoding = RGBA8;	break;
+		default:	image.encoding = UNKNOWN;	break;
+		};
+	}
+	image.settings = header.reserved1[0] == SETTINGS_MARKER ? header.reserved1[1] : 0;
+
+	if (image.encoding == UNKNOWN)
+		return false;
+
+	// only full chains are ever written
+	size_t dataOffset = sizeof(magic) + sizeof(header);
+	size_t dataSize = layoutMipChain(image.levels, image.encoding, header.width, header.height);
+	if ((header.flags & DDSD_MIPMAPCOUNT) == 0 ||
+		header.mipMapCount != image.levels.size() ||
+		file->getSize() < dataOffset + dataSize)
+		return false;
+
+	// the levels are used straight from the mapped pages, no copy is made
+	image.data.clear();
+	image.mappedData = file->getData() + dataOffset;
+	image.file = file;
+
+	return true;
+}
+
+bool TextureCache::write(const char* cachePath, const Image& image) {
+
+	if (image.levels.empty() ||
+		image.encoding == UNKNOWN)
+		return false;
+
+	FILE* file = nullptr;
+	fopen_s(&file, cachePath, "wb");
+	if (file == nullptr)
+		return false;
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.width = image.levels[0].width;
+	header.height = image.levels[0].height;
+	header.pitchOrLinearSize = (uint32_t)image.levels[0].size;
+	header.mipMapCount = (uint32_t)image.levels.size();
+	header.reserved1[0] = SETTINGS_MARKER;
+	header.reserved1[1] = image.settings;
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+
+	if (isBlockCompressed(image.encoding)) {
+		header.pixelFormat.flags = DDPF_FOURCC;
+		header.pixelFormat.fourCC = encodingToFourCC(image.encoding);
+	}
+	else {
+		// bytes are stored in R, G, B, A order
+		unsigned int channels = getChannelCount(image.encoding);
+		header.flags = (header.flags & ~DDSD_LINEARSIZE) | DDSD_PITCH;
+		header.pitchOrLinearSize = image.levels[0].width * channels;
+		header.pixelFormat.flags = channels >= 3 ? DDPF_RGB : DDPF_LUMINANCE;
+		if (channels == 2 || channels == 4)
+			header.pixelFormat.flags |= DDPF_ALPHAPIXELS;
+		header.pixelFormat.rgbBitCount = channels * 8;
+		header.pixelFormat.rBitMask = 0x000000ff;
+		header.pixelFormat.gBitMask = channels >= 3 ? 0x0000ff00 : 0;
+		header.pixelFormat.bBitMask = channels >= 3 ? 0x00ff0000 : 0;
+		header.pixelFormat.aBitMask = channels == 4 ? 0xff000000 : (channels == 2 ? 0x0000ff00 : 0);
+	}
+	header.caps = DDSCAPS_TEXTURE;
+	if (image.levels.size() > 1)
+		header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	uint32_t magic = DDS_MAGIC;
+	bool success = fwrite(&magic, sizeof(magic), 1, file) == 1 &&
+		fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(image.getData(), 1, image.getDataSize(), file) == image.getDataSize();
+	fclose(file);
+
+	// never leave a truncated cache file behind
+	if (success == false)
+		remove(cachePath);
+
+	return success;
+}
+
+} // namespace aie
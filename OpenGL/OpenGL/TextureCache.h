@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+namespace aie {
+
+// reads and writes processed texture data (full mip chains, optionally block compressed)
+// to disk so it only has to be generated once, using a minimal DDS container stored next
+// to the source image
+class TextureCache {
+public:
+
+	// the pixel encodings that can be stored in the cache
+	enum Encoding : unsigned int {
+		UNKNOWN = 0,
+		BC1,	// opaque colour, 8 bytes per 4x4 block
+		BC3,	// colour with alpha, 16 bytes per 4x4 block
+		BC5,	// two channel (normal maps), 16 bytes per 4x4 block
+		R8,
+		RG8,
+		RGB8,
+		RGBA8,
+	};
+
+	struct Level {
+		unsigned int	width;
+		unsigned int	height;
+		size_t			offset;	// byte offset of this level within Image::data
+		size_t			size;	// byte size of this level
+	};
+
+	// a full mip chain of a single encoded image, levels stored back to back either
+	// in data or, for an image read from the cache, in place within the mapped cache file
+	struct Image {
+		Image() : encoding(UNKNOWN), settings(0), mappedData(nullptr) {}
+
+		unsigned int				encoding;
+		unsigned int				settings;	// caller defined key of how the data was generated
+		std::vector<Level>			levels;
+		std::vector<unsigned char>	data;
+
+		std::shared_ptr<MappedFile>	file;
+		const unsigned char*		mappedData;
+
+		const unsigned char* getData() const { return mappedData != nullptr ? mappedData : data.data(); }
+		size_t getDataSize() const { return levels.empty() ? 0 : levels.back().offset + levels.back().size; }
+
+		const unsigned char* getLevelData(size_t level) const { return getData() + levels[level].offset; }
+	};
+
+	// returns the cache file used for the given source image
+	static std::string	getCachePath(const char* filename, bool compressed);
+
+	// true if a cache file exists and is newer than its source image
+	static bool			isFresh(const char* filename, const char* cachePath);
+
+	// maps the cache file rather than reading it, the image's levels point in to the mapping
+	static bool			read(const char* cachePath, Image& image);
+	static bool			write(const char* cachePath, const Image& image);
+
+	// byte size of a single mip level in the given encoding
+	static size_t		getLevelSize(unsigned int encoding, unsigned int width, unsigned int height);
+
+	static bool			isBlockCompressed(unsigned int encoding) { return encoding >= BC1 && encoding <= BC5; }
+
+	// fills in the level table and sizes the data for a full mip chain down to 1x1
+	static void			allocateMipChain(Image& image, unsigned int encoding, unsigned int width, unsigned int height);
+
+	// fills in the level table of a full mip chain, returning the total byte size
+	static size_t		layoutMipChain(std::vector<Level>& levels, unsigned int encoding, unsigned int width, unsigned int height);
+};
+
+} // namespace aie
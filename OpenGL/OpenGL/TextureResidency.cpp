@@ -0,0 +1,122 @@
+#include "TextureResidency.h"
+#include "Texture.h"
+#include <algorithm>
+#include <vector>
+
+namespace aie {
+
+std::unordered_map<const Texture*, TextureResidency::Record> TextureResidency::sm_textures;
+
+size_t TextureResidency::sm_budget = 0;
+unsigned int TextureResidency::sm_evictionDelay = 120;
+unsigned int TextureResidency::sm_smallMipSize = 64;
+unsigned int TextureResidency::sm_frame = 0;
+size_t TextureResidency::sm_peakGPUMemory = 0;
+size_t TextureResidency::sm_peakCPUMemory = 0;
+
+void TextureResidency::add(Texture* texture) {
+	auto iter = sm_textures.find(texture);
+	if (iter == sm_textures.end())
+		sm_textures[texture] = { texture, sm_frame };
+	else
+		iter->second.lastUsedFrame = sm_frame;
+	updatePeaks();
+}
+
+void TextureResidency::remove(const Texture* texture) {
+	sm_textures.erase(texture);
+}
+
+void TextureResidency::touch(const Texture* texture) {
+	auto iter = sm_textures.find(texture);
+	if (iter == sm_textures.end())
+		return;
+
+	Record& record = iter->second;
+	record.lastUsedFrame = sm_frame;
+
+	if (record.texture->getResidency() != Texture::RESIDENT) {
+		record.texture->reload(0);
+		updatePeaks();
+	}
+}
+
+size_t TextureResidency::getGPUMemory() {
+	size_t total = 0;
+	for (auto& r : sm_textures)
+		total += r.second.texture->getMemorySize();
+	return total;
+}
+
+size_t TextureResidency::getCPUMemory() {
+	size_t total = 0;
+	for (auto& r : sm_textures)
+		total += r.second.texture->getCPUMemorySize();
+	return total;
+}
+
+size_t TextureResidency::getEvictedCount() {
+	size_t count = 0;
+	for (auto& r : sm_textures)
+		if (r.second.texture->getResidency() != Texture::RESIDENT)
+			++count;
+	return count;
+}
+
+void TextureResidency::updatePeaks() {
+	sm_peakGPUMemory = std::max(sm_peakGPUMemory, getGPUMemory());
+	sm_peakCPUMemory = std::max(sm_peakCPUMemory, getCPUMemory());
+}
+
+void TextureResidency::endFrame() {
+
+	updatePeaks();
+	++sm_frame;
+
+	if (sm_budget == 0)
+		return;
+
+	size_t usage = getGPUMemory();
+	if (usage <= sm_budget)
+		return;
+
+	// file backed textures that have gone unused long enough, least recently used first
+	std::vector<Record*> candidates;
+	for (auto& r : sm_textures) {
+		Record& record = r.second;
+		if (record.texture->isEvictable() &&
+			record.texture->getResidency() != Texture::EVICTED &&
+			sm_frame - record.lastUsedFrame >= sm_evictionDelay)
+			candidates.push_back(&record);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Record* a, const Record* b) {
+		return a->lastUsedFrame < b->lastUsedFrame;
+	});
+
+	// drop to the small mips first so a texture that is needed again comes back blurry rather than black
+	for (auto record : candidates) {
+		if (usage <= sm_budget)
+			return;
+		Texture* texture = record->texture;
+		if (texture->getResidency() != Texture::RESIDENT)
+			continue;
+
+		unsigned int level = texture->getSmallMipLevel(sm_smallMipSize);
+		if (level == 0)
+			continue;
+
+		size_t before = texture->getMemorySize();
+		if (texture->reload(level))
+			usage = usage - before + texture->getMemorySize();
+	}
+
+	for (auto record : candidates) {
+		if (usage <= sm_budget)
+			return;
+		usage -= record->texture->getMemorySize();
+		record->texture->evict();
+	}
+}
+
+} // namespace aie
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace aie {
+
+class Texture;
+
+// tracks the CPU and video memory of every texture and, once a budget is set, evicts
+// textures that haven't been bound for a number of frames, least recently used first.
+// Evicted textures are reloaded from the texture cache the next time they are bound.
+class TextureResidency {
+public:
+
+	// video memory budget in bytes, 0 disables eviction
+	static void		setBudget(size_t bytes) { sm_budget = bytes; }
+	static size_t	getBudget() { return sm_budget; }
+
+	// frames a texture must go unbound before it can be evicted
+	static void			setEvictionDelay(unsigned int frames) { sm_evictionDelay = frames; }
+	static unsigned int	getEvictionDelay() { return sm_evictionDelay; }
+
+	// textures are first reduced to the mips no larger than this, then evicted entirely
+	static void			setSmallMipSize(unsigned int size) { sm_smallMipSize = size; }
+	static unsigned int	getSmallMipSize() { return sm_smallMipSize; }
+
+	// advances the frame counter and evicts textures until usage is back under budget
+	static void		endFrame();
+
+	// marks a texture as used this frame, reloading it if it had been evicted
+	static void		touch(const Texture* texture);
+
+	// current and peak memory of all textures, in bytes
+	static size_t	getGPUMemory();
+	static size_t	getCPUMemory();
+	static size_t	getPeakGPUMemory() { return sm_peakGPUMemory; }
+	static size_t	getPeakCPUMemory() { return sm_peakCPUMemory; }
+
+	static size_t	getTextureCount() { return sm_textures.size(); }
+
+	// textures currently holding less than their full mip chain
+	static size_t	getEvictedCount();
+
+	static unsigned int	getFrame() { return sm_frame; }
+
+private:
+
+	friend class Texture;
+
+	// called by Texture as its handle is created and destroyed
+	static void		add(Texture* texture);
+	static void		remove(const Texture* texture);
+
+	static void		updatePeaks();
+
+	struct Record {
+		Texture*		texture;
+		unsigned int	lastUsedFrame;
+	};
+
+	static std::unordered_map<const Texture*, Record>	sm_textures;
+
+	static size_t		sm_budget;
+	static unsigned int	sm_evictionDelay;
+	static unsigned int	sm_smallMipSize;
+	static unsigned int	sm_frame;
+	static size_t		sm_peakGPUMemory;
+	static size_t		sm_peakCPUMemory;
+};
+
+} // namespace aie
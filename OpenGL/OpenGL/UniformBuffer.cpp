@@ -0,0 +1,54 @@
+#include "UniformBuffer.h"
+#include "gl_core_4_4.h"
+#include "GLState.h"
+#include <cassert>
+#include <cstdio>
+
+namespace aie {
+
+UniformBuffer::UniformBuffer()
+	: m_handle(0),
+	m_bindingPoint(0),
+	m_size(0) {
+}
+
+UniformBuffer::~UniformBuffer() {
+	if (m_handle != 0) {
+		GLState::removeBuffer(m_handle);
+		glDeleteBuffers(1, &m_handle);
+	}
+}
+
+bool UniformBuffer::create(unsigned int bindingPoint, size_t size) {
+
+	if (m_handle != 0) {
+		printf("Uniform buffer already created!\n");
+		return false;
+	}
+
+	m_bindingPoint = bindingPoint;
+	m_size = size;
+
+	glGenBuffers(1, &m_handle);
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, m_handle);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_handle);
+	return true;
+}
+
+void UniformBuffer::update(const void* data, size_t size) {
+	assert(m_handle > 0 && "Invalid uniform buffer");
+	assert(size <= m_size && "Uniform buffer overflow");
+
+	// left bound, so updating the same buffer again next frame doesn't rebind it
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, m_handle);
+	glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+}
+
+void UniformBuffer::bind() const {
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, m_bindingPoint, m_handle);
+}
+
+} // namespace aie
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+namespace aie {
+
+// a uniform buffer object bound to a fixed binding point, shared by every
+// program whose uniform block is bound to the same point
+class UniformBuffer {
+public:
+
+	UniformBuffer();
+	~UniformBuffer();
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator = (const UniformBuffer&) = delete;
+
+	// creates the buffer and binds it to the binding point, will fail if already created
+	bool create(unsigned int bindingPoint, size_t size);
+
+	// replaces the whole contents, orphaning the old storage so the GPU never stalls on it
+	void update(const void* data, size_t size);
+
+	template <typename T>
+	void update(const T& data) { update(&data, sizeof(T)); }
+
+	// rebinds to the binding point, only needed if something else was bound there
+	void bind() const;
+
+	unsigned int getHandle() const { return m_handle; }
+	unsigned int getBindingPoint() const { return m_bindingPoint; }
+	size_t getSize() const { return m_size; }
+
+protected:
+
+	unsigned int	m_handle;
+	unsigned int	m_bindingPoint;
+	size_t			m_size;
+};
+
+} // namespace aie
@@ -0,0 +1,17 @@
+// per frame data shared by every program, see FrameData.h
+layout(std140) uniform FrameData {
+	mat4	View;
+	mat4	Projection;
+	mat4	ProjectionView;
+	vec3	CameraPosition;
+	float	Time;
+};
+
+// lights shared by every program, see FrameData.h
+layout(std140) uniform LightData {
+	vec3	Ia;					// ambient light colour
+	int		m_lightCount;
+	vec3	m_pointLightPos[4];
+	vec3	m_lightColors[4];
+	float	m_lightPower[4];
+};
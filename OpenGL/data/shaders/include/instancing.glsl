@@ -0,0 +1,17 @@
+// the transforms a vertex stage draws with, from the per object uniforms or, in the INSTANCED
+// variants, from per instance attributes (see InstanceBuffer.h). Include after the uniforms
+
+#ifdef INSTANCED
+layout( location = 4 ) in mat4 InstanceModelMatrix;		// locations 4 to 7
+layout( location = 8 ) in mat3 InstanceNormalMatrix;	// locations 8 to 10
+
+#include "frame_data.glsl"
+
+mat4 getModelMatrix() { return InstanceModelMatrix; }
+mat3 getNormalMatrix() { return InstanceNormalMatrix; }
+mat4 getProjectionViewModel() { return ProjectionView * InstanceModelMatrix; }
+#else
+mat4 getModelMatrix() { return ModelMatrix; }
+mat3 getNormalMatrix() { return NormalMatrix; }
+mat4 getProjectionViewModel() { return ProjectionViewModel; }
+#endif
@@ -0,0 +1,13 @@
+// Phong lighting terms for one light. L points at the light and V at the camera, all normalised
+
+float getDiffuse(vec3 L, vec3 N)
+{
+	return max(0, dot(N, L));
+}
+
+float getSpecular(vec3 L, vec3 N, vec3 V, float specularPower)
+{
+	vec3 R = reflect( -L, N );
+
+	return pow( max( 0, dot( R, V ) ), specularPower );
+}
@@ -0,0 +1,63 @@
+// physically based lighting terms for one light. L points at the light and E at the camera,
+// all normalised
+
+// ---------------- Oren-Nayar ------------------
+float getDiffuse(vec3 L, vec3 N, vec3 E, float Roughness)
+{
+	float NdL = max( 0.0f, dot( N, L ) );
+	float NdE = max( 0.0f, dot( N, E ) );
+	float R2 = Roughness * Roughness;
+
+	// Oren-Nayar Diffuse Term
+	float A = 1.0f - 0.5f * R2 / (R2 + 0.33f);
+	float B = 0.45f * R2 / (R2 + 0.09f);
+
+	// CX = Max(0, cos(l,e))
+	vec3 lightProjected = normalize( L - N * NdL );
+	vec3 viewProjected = normalize( E - N * NdE);
+	float CX = max( 0.0f, dot( lightProjected, viewProjected ) );
+
+	// DX = sin(alpha) * tan(beta)
+	float alpha = sin( max( acos( NdE ), acos( NdL ) ) );
+	float beta = tan( min( acos( NdE ), acos( NdL ) ) );
+	float DX = alpha * beta;
+
+	// Calculate Oren-Nayar, replaces the Phong L
+	float OrenNayar = NdL * (A + B * CX * DX);
+
+	return OrenNayar;
+}
+
+// --------------- Cook-Torrance -------------------
+float getSpecular(vec3 L, vec3 N, vec3 E, float Roughness, float ReflectionCoefficient)
+{
+	float NdL = max( 0.0f, dot( N, L ) );
+	float NdE = max( 0.0f, dot( N, E ) );
+	float R2 = Roughness * Roughness;
+
+	// Vector average H of the light vector L and view vector E
+	vec3 H = normalize(( L + E ) / 2 ); 
+
+	float NdH = max( 0.0f, dot( N, H ) );
+	float NdH2 = NdH * NdH;
+	float e = 2.71828182845904523536028747135f;
+	float pi = 3.1415926535897932384626433832f;
+
+	// Beckman's Distribution Function D
+	float exponent = -(1 - NdH2) / (NdH2 * R2);
+	float D = pow( e, exponent ) / (R2 * NdH2 * NdH2);
+
+	// Fresnel Term F
+	float rf = ReflectionCoefficient;
+	float F = rf + (1-rf) * pow(1-NdE , 5);
+	//float F = ReflectionCoefficient + (1  ReflectionCoefficient) * pow( 1 - NdE, 5 );
+
+	// Geometric Attenuation Factor G
+	float X = 2.0f * NdH / dot( E, H );
+	float G = min(1, min(X * NdL, X * NdE));
+
+	// Calculate Cook-Torrance
+	float CookTorrance = max( (D*G*F) / (NdE * pi), 0.0f );
+
+	return CookTorrance;
+}
@@ -1,5 +1,7 @@
 // a normal map fragment shader
 #version 410
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_shading_language_420pack : require
 
 in vec2 vTexCoord;
 in vec3 vNormal;
@@ -9,39 +11,21 @@ in vec4 vPosition;
 
 out vec4 FragColour;
 
-uniform sampler2D diffuseTexture;
-uniform sampler2D specularTexture;
-uniform sampler2D normalTexture;
+layout(binding = 0) uniform sampler2D diffuseTexture;
+layout(binding = 3) uniform sampler2D specularTexture;
+layout(binding = 5) uniform sampler2D normalTexture;
 
-uniform vec3 Ka;					// material ambient
-uniform vec3 Kd;					// material diffuse
-uniform vec3 Ks;					// material specular
-uniform float specularPower;
+layout(location = 3) uniform vec3 Ka;					// material ambient
+layout(location = 4) uniform vec3 Kd;					// material diffuse
+layout(location = 5) uniform vec3 Ks;					// material specular
+layout(location = 6) uniform float specularPower;
 
-uniform vec3 Ia;					// light ambient
-uniform vec3 Id;					// light diffuse
-uniform vec3 Is;					// light specular
+layout(location = 7) uniform vec3 Id;					// light diffuse
+layout(location = 8) uniform vec3 Is;					// light specular
 
-uniform vec3 CameraPosition;
+#include "include/frame_data.glsl"
 
-uniform vec3	m_pointLightPos[4];
-uniform vec3	m_lightColors[4];
-uniform float	m_lightPower[4];
-uniform int		m_lightCount;
-
-float getDiffuse(vec3 L, vec3 N)
-{
-	return max(0, dot(N, L));
-}
-
-float getSpecular(vec3 L, vec3 N)
-{
-	// calculate view vector and reflection vector
-	vec3 V = normalize(CameraPosition - vPosition.xyz);
-	vec3 R = reflect( -L, N );
-
-	return pow( max( 0, dot( R, V ) ), specularPower );
-}
+#include "include/phong_lighting.glsl"
 
 void main() 
 {
@@ -54,13 +38,31 @@ void main()
 
 	mat3 TBN = mat3(T, B, N);
 
+	vec3 V = normalize(CameraPosition - vPosition.xyz);
+
+#ifdef HAS_DIFFUSE_TEX
 	vec3 texDiffuse = texture( diffuseTexture, vTexCoord ).rgb;
+#else
+	vec3 texDiffuse = vec3(1);
+#endif
 	vec3 texSpecular = texture( specularTexture, vTexCoord ).rgb;
-	vec3 texNormal = texture( normalTexture, vTexCoord ).rgb;
 
-	N = TBN * (texNormal * 2 - 1);
+#ifdef HAS_NORMAL_MAP
+	// normal maps are stored as BC5 (XY only) so rebuild Z from the unit length
+	vec2 texNormalXY = texture( normalTexture, vTexCoord ).rg * 2 - 1;
+	vec3 texNormal = vec3(texNormalXY, sqrt(max(0, 1 - dot(texNormalXY, texNormalXY))));
+
+	N = TBN * texNormal;
+#endif
+
+	// LIGHT_COUNT bakes the light count in so the loop unrolls, otherwise the uniform count is used
+#ifdef LIGHT_COUNT
+	const int lightCount = LIGHT_COUNT;
+#else
+	int lightCount = m_lightCount;
+#endif
 
-	for (int i = 0; i < m_lightCount; i++)
+	for (int i = 0; i < lightCount; i++)
 	{
 		vec3 L = m_pointLightPos[i] - vPosition.xyz;
 
@@ -73,7 +75,7 @@ void main()
 		diffuse += getDiffuse(L, N) * m_lightColors[i] * m_lightPower[i] * attenuation;
 
 		// attenuate specular by a fixed amount, instead of distance-squared
-		specular += getSpecular(L, N) * m_lightColors[i] * m_lightPower[i] * 0.1f;
+		specular += getSpecular(L, N, V, specularPower) * m_lightColors[i] * m_lightPower[i] * 0.1f;
 	}
 
 	// calculate each light property
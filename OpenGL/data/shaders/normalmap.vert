@@ -1,5 +1,6 @@
 // a normal map vertex shader
 #version 410
+#extension GL_ARB_explicit_uniform_location : require
 
 layout( location = 0 ) in vec4 Position;
 layout( location = 1 ) in vec4 Normal;
@@ -12,20 +13,27 @@ out vec3 vTangent;
 out vec3 vBiTangent;
 out vec4 vPosition;
 
-uniform mat4 ProjectionViewModel;
+// redeclared so the stage can be linked as a separable program
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+layout(location = 0) uniform mat4 ProjectionViewModel;
 
 // we need the model matrix seperate
-uniform mat4 ModelMatrix;
+layout(location = 1) uniform mat4 ModelMatrix;
 
 // we need this matrix to transform the normal
-uniform mat3 NormalMatrix;
+layout(location = 2) uniform mat3 NormalMatrix;
+
+#include "include/instancing.glsl"
 
 void main() 
 {
 	vTexCoord = TexCoord;
-	vPosition = ModelMatrix * Position;
-	vNormal = NormalMatrix * Normal.xyz;
-	vTangent = NormalMatrix * Tangent.xyz;
+	vPosition = getModelMatrix() * Position;
+	vNormal = getNormalMatrix() * Normal.xyz;
+	vTangent = getNormalMatrix() * Tangent.xyz;
 	vBiTangent = cross(vNormal, vTangent) * Tangent.w;
-	gl_Position = ProjectionViewModel * Position;
+	gl_Position = getProjectionViewModel() * Position;
 }
\ No newline at end of file
@@ -1,94 +1,31 @@
 // classic physic-based fragment shader
 #version 410
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_shading_language_420pack : require
 
 in vec2 vTexCoord;
 in vec4 vPosition;
 in vec3 vNormal;
 
-uniform vec3 Ka;				// ambient material colour
-uniform vec3 Kd;				// diffuse material colour
-uniform vec3 Ks;				// specular material colour
+layout(location = 3) uniform vec3 Ka;				// ambient material colour
+layout(location = 4) uniform vec3 Kd;				// diffuse material colour
+layout(location = 5) uniform vec3 Ks;				// specular material colour
 
-uniform float specularPower;	// material specular power
+layout(location = 6) uniform float specularPower;	// material specular power
 
-uniform vec3 Ia;				// ambient light colour
+layout(location = 7) uniform vec3 Id;				// diffuse light colour
+layout(location = 8) uniform vec3 Is;				// specular light colour
 
-uniform vec3 Id;				// diffuse light colour
-uniform vec3 Is;				// specular light colour
+#include "include/frame_data.glsl"
 
-uniform vec3 CameraPosition;
-uniform float Roughness;
-uniform float ReflectionCoefficient;
+layout(location = 9) uniform float Roughness;
+layout(location = 10) uniform float ReflectionCoefficient;
 
-uniform vec3	m_pointLightPos[4];
-uniform vec3	m_lightColors[4];
-uniform float	m_lightPower[4];
-uniform int		m_lightCount;
-
-uniform sampler2D diffuseTex;
+layout(binding = 0) uniform sampler2D diffuseTex;
 
 out vec4 FragColour;
 
-// ---------------- Oren-Nayar ------------------
-float getDiffuse(vec3 L, vec3 N, vec3 E)
-{
-	float NdL = max( 0.0f, dot( N, L ) );
-	float NdE = max( 0.0f, dot( N, E ) );
-	float R2 = Roughness * Roughness;
-
-	// Oren-Nayar Diffuse Term
-	float A = 1.0f - 0.5f * R2 / (R2 + 0.33f);
-	float B = 0.45f * R2 / (R2 + 0.09f);
-
-	// CX = Max(0, cos(l,e))
-	vec3 lightProjected = normalize( L - N * NdL );
-	vec3 viewProjected = normalize( E - N * NdE);
-	float CX = max( 0.0f, dot( lightProjected, viewProjected ) );
-
-	// DX = sin(alpha) * tan(beta)
-	float alpha = sin( max( acos( NdE ), acos( NdL ) ) );
-	float beta = tan( min( acos( NdE ), acos( NdL ) ) );
-	float DX = alpha * beta;
-
-	// Calculate Oren-Nayar, replaces the Phong L
-	float OrenNayar = NdL * (A + B * CX * DX);
-
-	return OrenNayar;
-}
-
-// --------------- Cook-Torrance -------------------
-float getSpecular(vec3 L, vec3 N, vec3 E)
-{
-	float NdL = max( 0.0f, dot( N, L ) );
-	float NdE = max( 0.0f, dot( N, E ) );
-	float R2 = Roughness * Roughness;
-
-	// Vector average H of the light vector L and view vector E
-	vec3 H = normalize(( L + E ) / 2 ); 
-
-	float NdH = max( 0.0f, dot( N, H ) );
-	float NdH2 = NdH * NdH;
-	float e = 2.71828182845904523536028747135f;
-	float pi = 3.1415926535897932384626433832f;
-
-	// Beckman's Distribution Function D
-	float exponent = -(1 - NdH2) / (NdH2 * R2);
-	float D = pow( e, exponent ) / (R2 * NdH2 * NdH2);
-
-	// Fresnel Term F
-	float rf = ReflectionCoefficient;
-	float F = rf + (1-rf) * pow(1-NdE , 5);
-	//float F = ReflectionCoefficient + (1  ReflectionCoefficient) * pow( 1 - NdE, 5 );
-
-	// Geometric Attenuation Factor G
-	float X = 2.0f * NdH / dot( E, H );
-	float G = min(1, min(X * NdL, X * NdE));
-
-	// Calculate Cook-Torrance
-	float CookTorrance = max( (D*G*F) / (NdE * pi), 0.0f );
-
-	return CookTorrance;
-}
+#include "include/physic_lighting.glsl"
 
 void main() 
 {
@@ -100,9 +37,20 @@ void main()
 	vec3 N = normalize(vNormal);
 	vec3 E = normalize(CameraPosition - vPosition.xyz);
 
+#ifdef HAS_DIFFUSE_TEX
 	vec3 texDiffuse = texture( diffuseTex, vTexCoord ).rgb;
-
-	for (int i = 0; i < m_lightCount; i++)
+#else
+	vec3 texDiffuse = vec3(1);
+#endif
+
+	// LIGHT_COUNT bakes the light count in so the loop unrolls, otherwise the uniform count is used
+#ifdef LIGHT_COUNT
+	const int lightCount = LIGHT_COUNT;
+#else
+	int lightCount = m_lightCount;
+#endif
+
+	for (int i = 0; i < lightCount; i++)
 	{
 		vec3 L = m_pointLightPos[i] - vPosition.xyz;
 
@@ -112,10 +60,10 @@ void main()
 		// normalise for dot products inside the functions
 		L = normalize(L);
 
-		diffuse += getDiffuse(L, N, E) * m_lightColors[i] * m_lightPower[i] * attenuation;
+		diffuse += getDiffuse(L, N, E, Roughness) * m_lightColors[i] * m_lightPower[i] * attenuation;
 		// attenuate specular by a fixed amount, instead of distance-squared
 
-		specular += getSpecular(L, N, E) * m_lightColors[i] * m_lightPower[i] * 0.1f;
+		specular += getSpecular(L, N, E, Roughness, ReflectionCoefficient) * m_lightColors[i] * m_lightPower[i] * 0.1f;
 	}
 
 	// --------------- Final Colour Output --------------------
@@ -1,7 +1,8 @@
 // a simple flat colour shader
 #version 410
+#extension GL_ARB_explicit_uniform_location : require
 
-uniform vec3 Kd;
+layout(location = 1) uniform vec3 Kd;
 
 out vec4 FragColour;
 
@@ -1,9 +1,10 @@
 // a simple shader
 #version 410
+#extension GL_ARB_explicit_uniform_location : require
 
 layout( location = 0 ) in vec4 Position;
 
-uniform mat4 ProjectionViewModel;
+layout(location = 0) uniform mat4 ProjectionViewModel;
 
 void main() 
 {
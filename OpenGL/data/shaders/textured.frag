@@ -1,9 +1,10 @@
 /// a simple textured shader
 #version 410
+#extension GL_ARB_shading_language_420pack : require
 
 in vec2 vTexCoord;
 
-uniform sampler2D diffuseTexture;
+layout(binding = 0) uniform sampler2D diffuseTexture;
 
 out vec4 FragColour;
 
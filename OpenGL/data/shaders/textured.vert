@@ -1,12 +1,13 @@
 // a simple textured shader
 #version 410
+#extension GL_ARB_explicit_uniform_location : require
 
 layout( location = 0 ) in vec4 Position;
 layout( location = 2 ) in vec2 TexCoord;
 
 out vec2 vTexCoord;
 
-uniform mat4 ProjectionViewModel;
+layout(location = 0) uniform mat4 ProjectionViewModel;
 
 void main() 
 {
@@ -19,6 +19,7 @@
 #endif
 
 #include "Input.h"
+#include "StreamBuffer.h"
 
 namespace aie {
 
@@ -32,6 +33,25 @@ static int          g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
 static unsigned int g_VboHandle = 0, g_VaoHandle = 0, g_ElementsHandle = 0;
+static StreamBuffer* g_StreamBuffer = NULL;
+static unsigned int g_StreamVaoHandle = 0;
+
+// Same layout as g_VaoHandle, reading vertices and indices from the stream buffer
+static void ImGui_CreateStreamVertexArray() {
+    glGenVertexArrays(1, &g_StreamVaoHandle);
+    glBindVertexArray(g_StreamVaoHandle);
+    glBindBuffer(GL_ARRAY_BUFFER, g_StreamBuffer->getHandle());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_StreamBuffer->getHandle());
+    glEnableVertexAttribArray(g_AttribLocationPosition);
+    glEnableVertexAttribArray(g_AttribLocationUV);
+    glEnableVertexAttribArray(g_AttribLocationColor);
+
+#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
+    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, pos));
+    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, uv));
+    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, col));
+#undef OFFSETOF
+}
 
 // This is the main rendering function that you have to implement and provide to ImGui (via setting up 'RenderDrawListsFn' in the ImGuiIO structure)
 // If text or lines are blurry when integrating ImGui in your engine:
@@ -81,17 +101,38 @@ void ImGui_RenderDrawLists(ImDrawData* draw_data) {
     glUseProgram(g_ShaderHandle);
     glUniform1i(g_AttribLocationTex, 0);
     glUniformMatrix4fv(g_AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
-    glBindVertexArray(g_VaoHandle);
+
+    if (g_StreamBuffer && !g_StreamVaoHandle)
+        ImGui_CreateStreamVertexArray();
 
     for (int n = 0; n < draw_data->CmdListsCount; n++) {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
         const ImDrawIdx* idx_buffer_offset = 0;
+        GLint base_vertex = 0;
+
+        // Vertices are aligned to whole vertices in the stream buffer, so their offset gives the base vertex
+        size_t vtx_size = cmd_list->VtxBuffer.size() * sizeof(ImDrawVert);
+        size_t idx_size = cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx);
+        size_t vtx_offset = StreamBuffer::INVALID_OFFSET, idx_offset = StreamBuffer::INVALID_OFFSET;
+        if (g_StreamBuffer) {
+            vtx_offset = g_StreamBuffer->write(&cmd_list->VtxBuffer.front(), vtx_size, sizeof(ImDrawVert));
+            if (vtx_offset != StreamBuffer::INVALID_OFFSET)
+                idx_offset = g_StreamBuffer->write(&cmd_list->IdxBuffer.front(), idx_size, sizeof(ImDrawIdx));
+        }
 
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.size() * sizeof(ImDrawVert), (GLvoid*)&cmd_list->VtxBuffer.front(), GL_STREAM_DRAW);
+        if (idx_offset != StreamBuffer::INVALID_OFFSET) {
+            glBindVertexArray(g_StreamVaoHandle);
+            idx_buffer_offset = (const ImDrawIdx*)(intptr_t)idx_offset;
+            base_vertex = (GLint)(vtx_offset / sizeof(ImDrawVert));
+        } else {
+            glBindVertexArray(g_VaoHandle);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx), (GLvoid*)&cmd_list->IdxBuffer.front(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vtx_size, (GLvoid*)&cmd_list->VtxBuffer.front(), GL_STREAM_DRAW);
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)idx_size, (GLvoid*)&cmd_list->IdxBuffer.front(), GL_STREAM_DRAW);
+        }
 
         for (const ImDrawCmd* pcmd = cmd_list->CmdBuffer.begin(); pcmd != cmd_list->CmdBuffer.end(); pcmd++) {
             if (pcmd->UserCallback) {
@@ -99,7 +140,7 @@ void ImGui_RenderDrawLists(ImDrawData* draw_data) {
             } else {
                 glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
                 glScissor((int)pcmd->ClipRect.x, (int)(fb_height - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y));
-                glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset);
+                glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_buffer_offset, base_vertex);
             }
             idx_buffer_offset += pcmd->ElemCount;
         }
@@ -257,7 +298,17 @@ bool ImGui_CreateDeviceObjects() {
     return true;
 }
 
+void ImGui_SetStreamBuffer(StreamBuffer* buffer) {
+    g_StreamBuffer = buffer && buffer->isCreated() ? buffer : NULL;
+
+    // Recreated on the next render, pointing at the new buffer
+    if (g_StreamVaoHandle) glDeleteVertexArrays(1, &g_StreamVaoHandle);
+    g_StreamVaoHandle = 0;
+}
+
 void ImGui_InvalidateDeviceObjects() {
+    if (g_StreamVaoHandle) glDeleteVertexArrays(1, &g_StreamVaoHandle);
+    g_StreamVaoHandle = 0;
     if (g_VaoHandle) glDeleteVertexArrays(1, &g_VaoHandle);
     if (g_VboHandle) glDeleteBuffers(1, &g_VboHandle);
     if (g_ElementsHandle) glDeleteBuffers(1, &g_ElementsHandle);
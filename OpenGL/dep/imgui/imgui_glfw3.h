@@ -10,6 +10,8 @@ struct GLFWwindow;
 
 namespace aie {
 
+class StreamBuffer;
+
 IMGUI_API bool        ImGui_Init(GLFWwindow* window, bool install_callbacks);
 IMGUI_API void        ImGui_Shutdown();
 IMGUI_API void        ImGui_NewFrame();
@@ -18,6 +20,10 @@ IMGUI_API void        ImGui_NewFrame();
 IMGUI_API void        ImGui_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_CreateDeviceObjects();
 
+// Draw lists are written in to the stream buffer instead of re-specifying the binding's own buffers,
+// which are still used for lists that don't fit. NULL stops streaming.
+IMGUI_API void        ImGui_SetStreamBuffer(StreamBuffer* buffer);
+
 // GLFW callbacks (installed by default if you enable 'install_callbacks' during initialization)
 // Provided here if you want to chain callbacks.
 // You can also handle inputs yourself and use those as a reference.
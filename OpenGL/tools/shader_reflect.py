@@ -0,0 +1,305 @@
+"""Assigns explicit uniform locations and sampler bindings to the shaders in a directory and
+generates a C++ header with those locations as constants, plus typed setters for each uniform.
+
+Each program is the set of stage files sharing a base name, phong.vert and phong.frag become
+shaders::Phong. The shader files are rewritten with layout(location/binding) qualifiers, so the
+header and the sources can't disagree as long as this runs before the build. Files are only
+written when their contents change, so the build and hot reload only see real edits.
+
+Files pulled in with #include aren't rewritten, so they may declare uniform blocks but not
+plain uniforms, which would be left without a location.
+
+usage: shader_reflect.py <shader directory> <output header>
+"""
+
+import os
+import re
+import sys
+
+STAGE_EXTENSIONS = ['.vert', '.tesc', '.tese', '.geom', '.frag']
+
+# samplers OBJMesh binds to fixed texture units by name, others take the lowest free unit
+SAMPLER_UNITS = {
+    'diffuseTexture': 0,
+    'alphaTexture': 1,
+    'ambientTexture': 2,
+    'specularTexture': 3,
+    'specularHighlightTexture': 4,
+    'normalTexture': 5,
+    'displacementTexture': 6,
+}
+
+# GLSL types with a ShaderProgram::bindUniform overload
+CPP_TYPES = {
+    'int': 'int',
+    'bool': 'int',
+    'float': 'float',
+    'vec2': 'glm::vec2',
+    'vec3': 'glm::vec3',
+    'vec4': 'glm::vec4',
+    'mat2': 'glm::mat2',
+    'mat3': 'glm::mat3',
+    'mat4': 'glm::mat4',
+}
+
+# by-value for scalars, by reference for everything else
+SCALAR_TYPES = {'int', 'float'}
+
+EXTENSIONS = {
+    'location': '#extension GL_ARB_explicit_uniform_location : require',
+    'binding': '#extension GL_ARB_shading_language_420pack : require',
+}
+
+INCLUDE_PATTERN = re.compile(r'^[ \t]*#[ \t]*include\s*"(?P<name>[^"]+)"', re.MULTILINE)
+
+UNIFORM_PATTERN = re.compile(
+    r'^(?P<indent>[ \t]*)(?:layout\s*\([^)]*\)\s*)?uniform\s+(?P<type>\w+)\s+(?P<name>\w+)'
+    r'\s*(?:\[\s*(?P<count>\d+)\s*\])?\s*;(?P<rest>.*)$')
+
+
+class Uniform:
+    def __init__(self, glsl_type, name, count):
+        self.glsl_type = glsl_type
+        self.name = name
+        self.count = count
+        self.qualifier = None
+        self.value = None
+
+    def is_sampler(self):
+        return 'sampler' in self.glsl_type
+
+
+def read_stage(path):
+    # latin-1 round trips any byte, so comments in other encodings survive the rewrite
+    with open(path, 'rb') as f:
+        return f.read().decode('latin-1')
+
+
+def write_if_changed(path, text):
+    data = text.encode('latin-1')
+    if os.path.exists(path):
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return False
+    with open(path, 'wb') as f:
+        f.write(data)
+    return True
+
+
+def find_programs(directory):
+    programs = {}
+    for filename in sorted(os.listdir(directory)):
+        base, extension = os.path.splitext(filename)
+        if extension in STAGE_EXTENSIONS:
+            programs.setdefault(base, []).append(filename)
+    for stages in programs.values():
+        stages.sort(key=lambda f: STAGE_EXTENSIONS.index(os.path.splitext(f)[1]))
+    return programs
+
+
+def check_includes(path, text, seen):
+    # includes resolve relative to the including file, the same as ShaderSource
+    for match in INCLUDE_PATTERN.finditer(text):
+        include = os.path.normpath(os.path.join(os.path.dirname(path), match.group('name')))
+        if include in seen:
+            continue
+        seen.add(include)
+        if not os.path.exists(include):
+            raise SystemExit('%s includes %s, which does not exist' % (path, match.group('name')))
+        included = read_stage(include)
+        for line in included.splitlines():
+            uniform = UNIFORM_PATTERN.match(line)
+            if uniform is not None:
+                raise SystemExit('%s declares uniform %s, declare it in the stage files instead'
+                                 % (include, uniform.group('name')))
+        check_includes(include, included, seen)
+
+
+def parse_uniforms(sources):
+    uniforms = []
+    by_name = {}
+    for text in sources:
+        for line in text.splitlines():
+            match = UNIFORM_PATTERN.match(line)
+            if match is None:
+                continue
+            name = match.group('name')
+            count = int(match.group('count') or 1)
+            existing = by_name.get(name)
+            if existing is not None:
+                if existing.glsl_type != match.group('type') or existing.count != count:
+                    raise SystemExit('uniform %s is declared differently between stages' % name)
+                continue
+            uniform = Uniform(match.group('type'), name, count)
+            by_name[name] = uniform
+            uniforms.append(uniform)
+    return uniforms
+
+
+def assign(uniforms):
+    # arrays take a location per element, every other uniform takes one regardless of size
+    location = 0
+    units = set(SAMPLER_UNITS[u.name] for u in uniforms if u.is_sampler() and u.name in SAMPLER_UNITS)
+    for uniform in uniforms:
+        if uniform.is_sampler():
+            uniform.qualifier = 'binding'
+            if uniform.name in SAMPLER_UNITS:
+                uniform.value = SAMPLER_UNITS[uniform.name]
+            else:
+                unit = 0
+                while unit in units:
+                    unit += 1
+                units.add(unit)
+                uniform.value = unit
+        else:
+            uniform.qualifier = 'location'
+            uniform.value = location
+            location += uniform.count
+
+
+def rewrite_stage(text, uniforms):
+    by_name = dict((u.name, u) for u in uniforms)
+    newline = '\r\n' if '\r\n' in text else '\n'
+    lines = text.split(newline)
+    needed = set()
+
+    for i, line in enumerate(lines):
+        match = UNIFORM_PATTERN.match(line)
+        if match is None:
+            continue
+        uniform = by_name[match.group('name')]
+        needed.add(uniform.qualifier)
+        count = '[%d]' % uniform.count if match.group('count') else ''
+        lines[i] = '%slayout(%s = %d) uniform %s %s%s;%s' % (
+            match.group('indent'), uniform.qualifier, uniform.value,
+            uniform.glsl_type, uniform.name, count, match.group('rest'))
+
+    # #version 410 needs the extensions for both qualifiers, they go straight after #version
+    version = next((i for i, l in enumerate(lines) if l.lstrip().startswith('#version')), None)
+    if version is None:
+        raise SystemExit('stage has no #version line')
+    insert = version + 1
+    for qualifier in ['location', 'binding']:
+        directive = EXTENSIONS[qualifier]
+        present = directive in lines
+        if qualifier in needed and not present:
+            lines.insert(insert, directive)
+        elif qualifier not in needed and present:
+            lines.remove(directive)
+        if qualifier in needed:
+            insert = lines.index(directive) + 1
+
+    return newline.join(lines)
+
+
+def struct_name(base):
+    return ''.join(part[:1].upper() + part[1:] for part in re.split(r'[-_ ]+', base) if part)
+
+
+def generate_struct(base, stages, uniforms):
+    out = []
+    out.append('// %s' % ' + '.join(stages))
+    out.append('struct %s {' % struct_name(base))
+
+    locations = [u for u in uniforms if u.qualifier == 'location']
+    bindings = [u for u in uniforms if u.qualifier == 'binding']
+
+    out.append('')
+    out.append('\tstruct Location {')
+    for u in locations:
+        out.append('\t\tstatic constexpr int %s = %d;' % (u.name, u.value))
+    out.append('\t};')
+
+    if bindings:
+        out.append('')
+        out.append('\t// texture unit each sampler reads from')
+        out.append('\tstruct Binding {')
+        for u in bindings:
+            out.append('\t\tstatic constexpr unsigned int %s = %d;' % (u.name, u.value))
+        out.append('\t};')
+
+    setters = [u for u in locations if u.glsl_type in CPP_TYPES]
+    if setters:
+        out.append('')
+    for u in setters:
+        cpp_type = CPP_TYPES[u.glsl_type]
+        if u.count > 1:
+            # bindUniform takes scalar arrays as non-const
+            parameter = '%s*' % cpp_type if cpp_type in SCALAR_TYPES else 'const %s*' % cpp_type
+            out.append('\tstatic void set%s%s(ShaderProgram& program, int count, %s value) { program.bindUniform(Location::%s, count, value); }'
+                       % (u.name[:1].upper(), u.name[1:], parameter, u.name))
+        else:
+            parameter = cpp_type if cpp_type in SCALAR_TYPES else 'const %s&' % cpp_type
+            out.append('\tstatic void set%s%s(ShaderProgram& program, %s value) { program.bindUniform(Location::%s, value); }'
+                       % (u.name[:1].upper(), u.name[1:], parameter, u.name))
+
+    # uniforms the compiler removed report -1, anything else must match or the header is stale
+    out.append('')
+    out.append('\t// checks the locations against a linked program, reporting any that differ')
+    out.append('\tstatic bool validate(ShaderProgram& program) {')
+    out.append('\t\tbool valid = true;')
+    for u in locations:
+        out.append('\t\tvalid &= validateLocation(program, "%s", Location::%s);' % (u.name, u.name))
+    out.append('\t\treturn valid;')
+    out.append('\t}')
+    out.append('};')
+    return out
+
+
+def generate_header(programs):
+    out = []
+    out.append('// Generated by tools/shader_reflect.py from data/shaders, do not edit.')
+    out.append('// Locations are injected in to the shaders as layout qualifiers by the same build step.')
+    out.append('#pragma once')
+    out.append('')
+    out.append('#include "Shader.h"')
+    out.append('#include <cstdio>')
+    out.append('')
+    out.append('namespace aie {')
+    out.append('namespace shaders {')
+    out.append('')
+    out.append('inline bool validateLocation(ShaderProgram& program, const char* name, int location) {')
+    out.append('\tint actual = program.getUniform(name);')
+    out.append('\tif (actual < 0 || actual == location)')
+    out.append('\t\treturn true;')
+    out.append('\tprintf("Uniform [%s] is at location %d, bindings expect %d. Rerun shader_reflect.py\\n", name, actual, location);')
+    out.append('\treturn false;')
+    out.append('}')
+    for base, (stages, uniforms) in programs:
+        out.append('')
+        out.extend(generate_struct(base, stages, uniforms))
+    out.append('')
+    out.append('} // namespace shaders')
+    out.append('} // namespace aie')
+    out.append('')
+    return '\n'.join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        return 1
+
+    directory, header = sys.argv[1], sys.argv[2]
+    reflected = []
+    for base, stages in sorted(find_programs(directory).items()):
+        paths = [os.path.join(directory, s) for s in stages]
+        sources = [read_stage(p) for p in paths]
+        for path, text in zip(paths, sources):
+            check_includes(path, text, set())
+        uniforms = parse_uniforms(sources)
+        assign(uniforms)
+
+        for path, text in zip(paths, sources):
+            if write_if_changed(path, rewrite_stage(text, uniforms)):
+                print('shader_reflect: updated %s' % path)
+
+        reflected.append((base, (stages, uniforms)))
+
+    if write_if_changed(header, generate_header(reflected)):
+        print('shader_reflect: updated %s' % header)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())